@@ -56,7 +56,7 @@ int g_mtk_reply_parse_get_3g_capability(GRil *gril,
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril, "{%d}", slot_3g);
+	g_ril_start_print_buf(gril, "{%d}", slot_3g);
 	g_ril_print_response(gril, message);
 
 	/* Do it zero-based */
@@ -87,7 +87,7 @@ int g_mtk_reply_parse_query_modem_type(GRil *gril,
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril, "{%d}", type);
+	g_ril_start_print_buf(gril, "{%d}", type);
 	g_ril_print_response(gril, message);
 
 	return type;
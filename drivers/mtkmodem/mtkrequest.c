@@ -32,6 +32,7 @@
 #include <ofono/modem.h>
 #include <ofono/gprs-context.h>
 
+#include "grilschema.h"
 #include "mtkrequest.h"
 #include "simutil.h"
 #include "util.h"
@@ -41,33 +42,21 @@ void g_mtk_request_dual_sim_mode_switch(GRil *gril,
 					int mode,
 					struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, mode);
-
-	g_ril_append_print_buf(gril, "(%d)", mode);
+	g_ril_schema_encode(gril, &ril_schema_int1, &mode, rilp);
 }
 
 void g_mtk_request_set_gprs_connect_type(GRil *gril,
 						int always,
 						struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, always);
-
-	g_ril_append_print_buf(gril, "(%d)", always);
+	g_ril_schema_encode(gril, &ril_schema_int1, &always, rilp);
 };
 
 void g_mtk_request_set_gprs_transfer_type(GRil *gril,
 						int callprefer,
 						struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, callprefer);
-
-	g_ril_append_print_buf(gril, "(%d)", callprefer);
+	g_ril_schema_encode(gril, &ril_schema_int1, &callprefer, rilp);
 }
 
 void g_mtk_request_set_call_indication(GRil *gril, int mode, int call_id,
@@ -80,7 +69,7 @@ void g_mtk_request_set_call_indication(GRil *gril, int mode, int call_id,
 	parcel_w_int32(rilp, call_id);
 	parcel_w_int32(rilp, seq_number);
 
-	g_ril_append_print_buf(gril, "(%d,%d,%d)", mode, call_id, seq_number);
+	g_ril_start_print_buf(gril, "(%d,%d,%d)", mode, call_id, seq_number);
 }
 
 void g_mtk_request_set_fd_mode(GRil *gril, int mode, int param1,
@@ -108,18 +97,18 @@ void g_mtk_request_set_fd_mode(GRil *gril, int mode, int param1,
 	parcel_w_int32(rilp, num_args);
 	parcel_w_int32(rilp, mode);
 
-	g_ril_append_print_buf(gril, "(%d,%d", num_args, mode);
+	g_ril_start_print_buf(gril, "(%d,%d", num_args, mode);
 
 	if (mode == MTK_FD_MODE_SCREEN_STATUS) {
 		parcel_w_int32(rilp, param1);
-		g_ril_append_print_buf(gril, "%s,%d)", print_buf, param1);
+		g_ril_append_print_buf(gril, ",%d)", param1);
 	} else if (mode == MTK_FD_MODE_SET_TIMER) {
 		parcel_w_int32(rilp, param1);
 		parcel_w_int32(rilp, param2);
-		g_ril_append_print_buf(gril, "%s,%d,%d)", print_buf,
+		g_ril_append_print_buf(gril, ",%d,%d)",
 					param1, param2);
 	} else {
-		g_ril_append_print_buf(gril, "%s)", print_buf);
+		g_ril_append_print_buf(gril, ")");
 	}
 }
 
@@ -127,37 +116,21 @@ void g_mtk_request_set_3g_capability(GRil *gril, struct parcel *rilp)
 {
 	int mode = g_ril_get_slot(gril) + 1;
 
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, mode);
-
-	g_ril_append_print_buf(gril, "(%d)", mode);
+	g_ril_schema_encode(gril, &ril_schema_int1, &mode, rilp);
 }
 
 void g_mtk_request_store_modem_type(GRil *gril, int mode, struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, mode);
-
-	g_ril_append_print_buf(gril, "(%d)", mode);
+	g_ril_schema_encode(gril, &ril_schema_int1, &mode, rilp);
 }
 
 void g_mtk_request_set_trm(GRil *gril, int trm, struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, trm);
-
-	g_ril_append_print_buf(gril, "(%d)", trm);
+	g_ril_schema_encode(gril, &ril_schema_int1, &trm, rilp);
 }
 
 void g_mtk_request_resume_registration(GRil *gril, int session_id,
 					struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, session_id);
-
-	g_ril_append_print_buf(gril, "(%d)", session_id);
+	g_ril_schema_encode(gril, &ril_schema_int1, &session_id, rilp);
 }
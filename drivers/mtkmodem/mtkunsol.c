@@ -71,7 +71,7 @@ struct unsol_call_indication *g_mtk_unsol_parse_incoming_call_indication(
 	if (numstr > 5)
 		fw_address = parcel_r_string(&rilp);
 
-	g_ril_append_print_buf(gril, "{%s,%s,%s,%s,%s,%s}",
+	g_ril_start_print_buf(gril, "{%s,%s,%s,%s,%s,%s}",
 				PRINTABLE_STR(call_id),
 				PRINTABLE_STR(phone),
 				PRINTABLE_STR(address_type),
@@ -163,7 +163,7 @@ int g_mtk_unsol_parse_registration_suspended(GRil *gril,
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril, "{%d}", session_id);
+	g_ril_start_print_buf(gril, "{%d}", session_id);
 	g_ril_print_unsol(gril, message);
 
 	return session_id;
@@ -191,14 +191,14 @@ struct parcel_str_array *g_mtk_unsol_parse_plmn_changed(GRil *gril,
 		goto out;
 	}
 
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	for (i = 0; i < str_arr->num_str; ++i) {
 		if (i + 1 == str_arr->num_str)
-			g_ril_append_print_buf(gril, "%s%s}", print_buf,
+			g_ril_append_print_buf(gril, "%s}",
 						str_arr->str[i]);
 		else
-			g_ril_append_print_buf(gril, "%s%s, ", print_buf,
+			g_ril_append_print_buf(gril, "%s, ",
 						str_arr->str[i]);
 	}
 
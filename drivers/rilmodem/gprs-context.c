@@ -58,6 +58,21 @@ enum state {
 	STATE_ACTIVE,
 };
 
+/* What we last told the core about our data call */
+struct call_snapshot {
+	char *ifname;
+	char *ip_addr;
+	char *gateway;
+	char **dns_addrs;
+};
+
+enum call_diff {
+	CALL_DIFF_IFNAME =	0x1,
+	CALL_DIFF_ADDRESS =	0x2,
+	CALL_DIFF_GATEWAY =	0x4,
+	CALL_DIFF_DNS =		0x8,
+};
+
 struct gprs_context_data {
 	GRil *ril;
 	struct ofono_modem *modem;
@@ -65,13 +80,13 @@ struct gprs_context_data {
 	gint active_ctx_cid;
 	gint active_rild_cid;
 	enum state state;
-	guint call_list_id;
 	char *apn;
 	enum ofono_gprs_context_type type;
 	int deact_retries;
 	guint retry_ev_id;
 	struct cb_data *retry_cbd;
 	guint reset_ev_id;
+	struct call_snapshot snapshot;
 };
 
 static void ril_gprs_context_deactivate_primary(struct ofono_gprs_context *gc,
@@ -81,10 +96,92 @@ static void ril_gprs_context_deactivate_primary(struct ofono_gprs_context *gc,
 static void ril_deactivate_data_call_cb(struct ril_msg *message,
 					gpointer user_data);
 
+static gboolean strv_equal(char **a, char **b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+
+	for (; *a && *b; a++, b++)
+		if (strcmp(*a, *b) != 0)
+			return FALSE;
+
+	return *a == *b;
+}
+
+static void snapshot_clear(struct call_snapshot *snap)
+{
+	g_free(snap->ifname);
+	g_free(snap->ip_addr);
+	g_free(snap->gateway);
+	g_strfreev(snap->dns_addrs);
+	memset(snap, 0, sizeof(*snap));
+}
+
+/*
+ * Brings the snapshot up to date and returns what changed.  Settings the
+ * call does not carry are kept, a list whose entry could not be parsed
+ * must not wipe what the core was told.
+ */
+static unsigned int snapshot_update(struct call_snapshot *snap,
+					const struct ril_data_call *call)
+{
+	const char *gateway = call->gateways ? call->gateways[0] : NULL;
+	unsigned int diff = 0;
+
+	if (call->ifname && g_strcmp0(snap->ifname, call->ifname) != 0) {
+		g_free(snap->ifname);
+		snap->ifname = g_strdup(call->ifname);
+		diff |= CALL_DIFF_IFNAME;
+	}
+
+	if (call->ip_addr && g_strcmp0(snap->ip_addr, call->ip_addr) != 0) {
+		g_free(snap->ip_addr);
+		snap->ip_addr = g_strdup(call->ip_addr);
+		diff |= CALL_DIFF_ADDRESS;
+	}
+
+	if (gateway && g_strcmp0(snap->gateway, gateway) != 0) {
+		g_free(snap->gateway);
+		snap->gateway = g_strdup(gateway);
+		diff |= CALL_DIFF_GATEWAY;
+	}
+
+	if (call->dns_addrs && !strv_equal(snap->dns_addrs, call->dns_addrs)) {
+		g_strfreev(snap->dns_addrs);
+		snap->dns_addrs = g_strdupv(call->dns_addrs);
+		diff |= CALL_DIFF_DNS;
+	}
+
+	return diff;
+}
+
+static void set_context_settings(struct ofono_gprs_context *gc,
+					const struct call_snapshot *snap,
+					unsigned int diff)
+{
+	if (diff & CALL_DIFF_IFNAME)
+		ofono_gprs_context_set_interface(gc, snap->ifname);
+
+	if (diff & CALL_DIFF_ADDRESS) {
+		ofono_gprs_context_set_ipv4_netmask(gc,
+					ril_util_get_netmask(snap->ip_addr));
+		ofono_gprs_context_set_ipv4_address(gc, snap->ip_addr, TRUE);
+	}
+
+	if (diff & CALL_DIFF_GATEWAY)
+		ofono_gprs_context_set_ipv4_gateway(gc, snap->gateway);
+
+	if (diff & CALL_DIFF_DNS)
+		ofono_gprs_context_set_ipv4_dns_servers(gc,
+					(const char **) snap->dns_addrs);
+}
+
 static void set_context_disconnected(struct gprs_context_data *gcd)
 {
 	DBG("");
 
+	snapshot_clear(&gcd->snapshot);
+
 	gcd->active_ctx_cid = -1;
 	gcd->active_rild_cid = -1;
 	gcd->state = STATE_IDLE;
@@ -97,51 +194,55 @@ static void disconnect_context(struct ofono_gprs_context *gc)
 	ril_gprs_context_deactivate_primary(gc, 0, NULL, NULL);
 }
 
-static void ril_gprs_context_call_list_changed(struct ril_msg *message,
-						gpointer user_data)
+static struct ofono_gprs *context_get_gprs(struct ofono_gprs_context *gc)
 {
-	struct ofono_gprs_context *gc = user_data;
-	struct gprs_context_data *gcd = ofono_gprs_context_get_data(gc);
-	struct ril_data_call *call = NULL;
-	struct ril_data_call_list *call_list;
-	gboolean active_cid_found = FALSE;
-	gboolean disconnect = FALSE;
-	GSList *iterator = NULL;
+	struct ofono_modem *modem = ofono_gprs_context_get_modem(gc);
+	struct ofono_atom *gprs_atom =
+		__ofono_modem_find_atom(modem, OFONO_ATOM_TYPE_GPRS);
 
-	call_list = g_ril_unsol_parse_data_call_list(gcd->ril, message);
-	if (call_list == NULL)
-		return;
+	if (gprs_atom == NULL)
+		return NULL;
 
-	DBG("*gc: %p num calls: %d", gc, g_slist_length(call_list->calls));
+	return __ofono_atom_get_data(gprs_atom);
+}
 
-	for (iterator = call_list->calls; iterator; iterator = iterator->next) {
-		call = (struct ril_data_call *) iterator->data;
+static void unwatch_call(struct ofono_gprs_context *gc)
+{
+	struct gprs_context_data *gcd = ofono_gprs_context_get_data(gc);
+	struct ofono_gprs *gprs = context_get_gprs(gc);
 
-		if (call->cid == gcd->active_rild_cid) {
-			active_cid_found = TRUE;
-			DBG("found call - cid: %d", call->cid);
+	if (gprs != NULL && gcd->active_rild_cid >= 0)
+		ril_gprs_unwatch_data_call(gprs, gcd->active_rild_cid);
+}
 
-			if (call->active == 0) {
-				DBG("call !active; notify disconnect: %d",
-					call->cid);
-				disconnect = TRUE;
-			}
+void ril_gprs_context_call_changed(struct ofono_gprs_context *gc,
+					const struct ril_data_call *call)
+{
+	struct gprs_context_data *gcd = ofono_gprs_context_get_data(gc);
+	unsigned int diff;
 
-			break;
-		}
-	}
+	if (gcd->state == STATE_IDLE)
+		return;
 
-	if ((disconnect == TRUE || active_cid_found == FALSE)
-		&& gcd->state != STATE_IDLE) {
-		ofono_info("Clearing active context; disconnect: %d"
-			" active_cid_found: %d active_ctx_cid: %d",
-			disconnect, active_cid_found, gcd->active_ctx_cid);
+	if (call == NULL || call->active == 0) {
+		ofono_info("Clearing active context; found: %d"
+				" active_ctx_cid: %d", call != NULL,
+				gcd->active_ctx_cid);
 
+		unwatch_call(gc);
 		ofono_gprs_context_deactivated(gc, gcd->active_ctx_cid);
 		set_context_disconnected(gcd);
+		return;
 	}
 
-	g_ril_unsol_free_data_call_list(call_list);
+	diff = snapshot_update(&gcd->snapshot, call);
+	if (diff == 0 || gcd->state != STATE_ACTIVE)
+		return;
+
+	DBG("cid %d settings changed: 0x%x", gcd->active_rild_cid, diff);
+
+	set_context_settings(gc, &gcd->snapshot, diff);
+	ofono_gprs_context_settings_changed(gc, gcd->active_ctx_cid);
 }
 
 static void ril_setup_data_call_cb(struct ril_msg *message, gpointer user_data)
@@ -152,6 +253,7 @@ static void ril_setup_data_call_cb(struct ril_msg *message, gpointer user_data)
 	struct gprs_context_data *gcd = ofono_gprs_context_get_data(gc);
 	struct ril_data_call *call = NULL;
 	struct ril_data_call_list *call_list = NULL;
+	struct ofono_gprs *gprs;
 
 	DBG("*gc: %p", gc);
 
@@ -205,23 +307,16 @@ static void ril_setup_data_call_cb(struct ril_msg *message, gpointer user_data)
 	gcd->active_rild_cid = call->cid;
 	gcd->state = STATE_ACTIVE;
 
-	ofono_gprs_context_set_interface(gc, call->ifname);
-	ofono_gprs_context_set_ipv4_netmask(gc,
-					ril_util_get_netmask(call->ip_addr));
-
-	ofono_gprs_context_set_ipv4_address(gc, call->ip_addr, TRUE);
-	ofono_gprs_context_set_ipv4_gateway(gc, call->gateways[0]);
-
-	ofono_gprs_context_set_ipv4_dns_servers(gc,
-					(const char **) call->dns_addrs);
+	snapshot_clear(&gcd->snapshot);
+	set_context_settings(gc, &gcd->snapshot,
+				snapshot_update(&gcd->snapshot, call));
 
 	g_ril_unsol_free_data_call_list(call_list);
 
-	/* activate listener for data call changed events.... */
-	gcd->call_list_id =
-		g_ril_register(gcd->ril,
-				RIL_UNSOL_DATA_CALL_LIST_CHANGED,
-				ril_gprs_context_call_list_changed, gc);
+	/* The gprs atom dispatches data call list changes by cid */
+	gprs = context_get_gprs(gc);
+	if (gprs != NULL)
+		ril_gprs_watch_data_call(gprs, gcd->active_rild_cid, gc);
 
 	CALLBACK_WITH_SUCCESS(cb, cbd->data);
 	return;
@@ -472,11 +567,7 @@ static void ril_gprs_context_deactivate_primary(struct ofono_gprs_context *gc,
 	cbd = cb_data_new(cb, data, gc);
 
 	gcd->state = STATE_DISABLING;
-	if (g_ril_unregister(gcd->ril, gcd->call_list_id) == FALSE) {
-		ofono_warn("%s: couldn't remove call_list listener"
-				" for apn: %s.",
-				__func__, gcd->apn);
-	}
+	unwatch_call(gc);
 
 	request.cid = gcd->active_rild_cid;
 	request.reason = RIL_DEACTIVATE_DATA_CALL_NO_REASON;
@@ -530,7 +621,6 @@ static int ril_gprs_context_probe(struct ofono_gprs_context *gc,
 	gcd->modem = ril_data->modem;
 	gcd->vendor = vendor;
 	set_context_disconnected(gcd);
-	gcd->call_list_id = -1;
 	gcd->type = ril_data->type;
 
 	ofono_gprs_context_set_data(gc, gcd);
@@ -549,6 +639,8 @@ static void ril_gprs_context_remove(struct ofono_gprs_context *gc)
 		struct parcel rilp;
 		struct ofono_error error;
 
+		unwatch_call(gc);
+
 		request.cid = gcd->active_rild_cid;
 		request.reason = RIL_DEACTIVATE_DATA_CALL_NO_REASON;
 		g_ril_request_deactivate_data_call(gcd->ril, &request,
@@ -568,6 +660,8 @@ static void ril_gprs_context_remove(struct ofono_gprs_context *gc)
 
 	ofono_gprs_context_set_data(gc, NULL);
 
+	snapshot_clear(&gcd->snapshot);
+	g_free(gcd->apn);
 	g_ril_unref(gcd->ril);
 	g_free(gcd);
 }
@@ -180,7 +180,7 @@ static void send_allow_data(struct cb_data *cbd, GRil *ril, int attached)
 	parcel_w_int32(&rilp, 1);
 	parcel_w_int32(&rilp, attached);
 
-	g_ril_append_print_buf(ril, "(%d)", attached);
+	g_ril_start_print_buf(ril, "(%d)", attached);
 
 	if (g_ril_send(ril, RIL_REQUEST_ALLOW_DATA, &rilp,
 					gprs_allow_data_cb, cbd, NULL) == 0) {
@@ -264,6 +264,7 @@ static void ril_data_reg_cb(struct ril_msg *message, gpointer user_data)
 	struct reply_data_reg_state *reply;
 	gboolean attached = FALSE;
 	gboolean notify_status = FALSE;
+	unsigned int max_cids;
 	int old_status;
 
 	old_status = gd->rild_status;
@@ -351,12 +352,12 @@ static void ril_data_reg_cb(struct ril_msg *message, gpointer user_data)
 				gd->state_changed_unsol,
 				ril_gprs_state_change, gprs);
 
-		if (reply->max_cids == 0)
-			gd->max_cids = RIL_MAX_NUM_ACTIVE_DATA_CALLS;
-		else if (reply->max_cids < RIL_MAX_NUM_ACTIVE_DATA_CALLS)
-			gd->max_cids = reply->max_cids;
+		max_cids = g_ril_get_max_data_calls(gd->ril);
+
+		if (reply->max_cids == 0 || reply->max_cids > max_cids)
+			gd->max_cids = max_cids;
 		else
-			gd->max_cids = RIL_MAX_NUM_ACTIVE_DATA_CALLS;
+			gd->max_cids = reply->max_cids;
 
 		DBG("Setting max cids to %d", gd->max_cids);
 		ofono_gprs_set_cid_range(gprs, 1, gd->max_cids);
@@ -495,6 +496,101 @@ end:
 		ril_gprs_registration_status(gprs, NULL, NULL);
 }
 
+struct data_call_watch {
+	struct ofono_gprs_context *gc;
+	unsigned int serial;
+};
+
+void ril_gprs_watch_data_call(struct ofono_gprs *gprs, int cid,
+				struct ofono_gprs_context *gc)
+{
+	struct ril_gprs_data *gd = ofono_gprs_get_data(gprs);
+	struct data_call_watch *watch = g_new0(struct data_call_watch, 1);
+
+	watch->gc = gc;
+	g_hash_table_replace(gd->data_calls, GINT_TO_POINTER(cid), watch);
+
+	/* The next list must reach the new context even if it is a repeat */
+	g_byte_array_set_size(gd->last_call_list, 0);
+}
+
+void ril_gprs_unwatch_data_call(struct ofono_gprs *gprs, int cid)
+{
+	struct ril_gprs_data *gd = ofono_gprs_get_data(gprs);
+
+	g_hash_table_remove(gd->data_calls, GINT_TO_POINTER(cid));
+}
+
+/*
+ * One parse per list for all contexts: each call is handed to the
+ * context that owns its cid, and contexts whose call is missing are told
+ * so once the whole list has been seen.
+ */
+static void ril_gprs_call_list_changed(struct ril_msg *message,
+					gpointer user_data)
+{
+	struct ofono_gprs *gprs = user_data;
+	struct ril_gprs_data *gd = ofono_gprs_get_data(gprs);
+	struct ril_data_call_list *call_list;
+	struct data_call_watch *watch;
+	struct ril_data_call *call;
+	GHashTableIter iter;
+	gpointer key, value;
+	GSList *gone = NULL;
+	GSList *l;
+
+	if (g_hash_table_size(gd->data_calls) == 0)
+		return;
+
+	/* Modems resend the whole list whenever any call changes */
+	if (gd->last_call_list->len == message->buf_len &&
+			memcmp(gd->last_call_list->data, message->buf,
+				message->buf_len) == 0)
+		return;
+
+	call_list = g_ril_unsol_parse_data_call_list(gd->ril, message);
+	if (call_list == NULL)
+		return;
+
+	g_byte_array_set_size(gd->last_call_list, 0);
+	g_byte_array_append(gd->last_call_list,
+				(const guint8 *) message->buf, message->buf_len);
+
+	gd->call_list_serial++;
+
+	for (l = call_list->calls; l; l = l->next) {
+		call = l->data;
+
+		watch = g_hash_table_lookup(gd->data_calls,
+						GINT_TO_POINTER(call->cid));
+		if (watch == NULL)
+			continue;
+
+		watch->serial = gd->call_list_serial;
+
+		ril_gprs_context_call_changed(watch->gc, call);
+	}
+
+	/*
+	 * Contexts may have unwatched themselves while being notified, so
+	 * look for the calls missing from the list in what is left.
+	 */
+	g_hash_table_iter_init(&iter, gd->data_calls);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		watch = value;
+
+		if (watch->serial != gd->call_list_serial)
+			gone = g_slist_prepend(gone, watch->gc);
+	}
+
+	for (l = gone; l; l = l->next)
+		ril_gprs_context_call_changed(l->data, NULL);
+
+	g_slist_free(gone);
+	g_ril_unsol_free_data_call_list(call_list);
+}
+
 static void get_active_data_calls(struct ofono_gprs *gprs)
 {
 	struct ril_gprs_data *gd = ofono_gprs_get_data(gprs);
@@ -516,9 +612,16 @@ void ril_gprs_start(struct ril_gprs_driver_data *driver_data,
 	/* AOSP RILD tracks data network state together with voice */
 	gd->state_changed_unsol =
 		RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED;
+	gd->data_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+						NULL, g_free);
+	gd->last_call_list = g_byte_array_new();
 
 	ofono_gprs_set_data(gprs, gd);
 
+	gd->call_list_id = g_ril_register(gd->ril,
+					RIL_UNSOL_DATA_CALL_LIST_CHANGED,
+					ril_gprs_call_list_changed, gprs);
+
 	get_active_data_calls(gprs);
 }
 
@@ -547,6 +650,8 @@ void ril_gprs_remove(struct ofono_gprs *gprs)
 
 	ofono_gprs_set_data(gprs, NULL);
 
+	g_hash_table_destroy(gd->data_calls);
+	g_byte_array_free(gd->last_call_list, TRUE);
 	g_ril_unref(gd->ril);
 	g_free(gd);
 }
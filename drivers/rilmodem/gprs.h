@@ -31,8 +31,22 @@ struct ril_gprs_data {
 	int state_changed_unsol;
 	int pending_deact_req;
 	guint status_retry_cb_id;
+	GHashTable *data_calls;		/* rild cid -> struct data_call_watch */
+	unsigned int call_list_serial;
+	GByteArray *last_call_list;
+	guint call_list_id;
 };
 
+struct ril_data_call;
+
+void ril_gprs_watch_data_call(struct ofono_gprs *gprs, int cid,
+				struct ofono_gprs_context *gc);
+void ril_gprs_unwatch_data_call(struct ofono_gprs *gprs, int cid);
+
+/* Implemented by gprs-context, call is NULL when it left the list */
+void ril_gprs_context_call_changed(struct ofono_gprs_context *gc,
+					const struct ril_data_call *call);
+
 int ril_gprs_probe(struct ofono_gprs *gprs, unsigned int vendor, void *data);
 void ril_gprs_remove(struct ofono_gprs *gprs);
 void ril_gprs_start(struct ril_gprs_driver_data *driver_data,
@@ -53,6 +53,10 @@
 
 #define UNUSED	0xFF
 
+/* Record reads kept in flight while exporting, see "PhonebookReadWindow" */
+#define PB_READ_WINDOW_DEFAULT	8
+#define PB_READ_WINDOW_MAX	32
+
 #define EXT1_CP_SUBADDRESS	1
 #define EXT1_ADDITIONAL_DATA	2
 
@@ -97,15 +101,18 @@ struct record_to_read {
 	int adn_idx;
 	gboolean anr_ext;	/* Is it an EXT1 record for ANR? */
 	gboolean set_by_iap;	/* Type 2 file? */
+	struct pb_data *pbd;	/* Set while the read is in flight */
 };
 
+/* Indexed by EF_ADN record number - 1 */
 struct phonebook_entry {
-	int entry;
 	char *name;
 	char *number;
 	char *email;
 	char *anr;
 	char *sne;
+	gboolean valid;		/* EF_ADN record is not empty */
+	unsigned int reads;	/* Reads not completed, EF_ADN included */
 };
 
 unsigned char sim_path[] = { 0x3F, 0x00, 0x7F, 0x10 };
@@ -125,9 +132,12 @@ static const char digit_to_utf8[] = "0123456789*#,?r\0";
 struct pb_ref_rec {
 	GSList *pb_files;	/* File ids to read (pb_file_info nodes) */
 	GSList *pb_next;	/* Next file info to read */
-	GSList *pending_records;	/* List of record_to_read */
-	GSList *next_record;	/* Next record_to_read to process */
-	GTree *phonebook;	/* Container of phonebook_entry structures */
+	GQueue pending_records;	/* record_to_read not sent yet */
+	GSList *sent_records;	/* record_to_read in flight */
+	struct phonebook_entry *entries;
+	int num_entries;
+	int next_adn;		/* Next EF_ADN record to read */
+	int next_export;	/* First entry not exported yet */
 };
 
 struct pb_data {
@@ -137,18 +147,37 @@ struct pb_data {
 	struct ofono_sim_context *sim_context;
 	const unsigned char *df_path;
 	size_t df_size;
+	GRil *ril;		/* SIM_IO reads bypassing simfs */
+	unsigned int window;
+	unsigned int in_flight;
+	gboolean read_failed;
+	struct cb_data *export_cbd;
 };
 
 static void read_info_cb(int ok, unsigned char file_status,
 				int total_length, int record_length,
 				void *userdata);
 
-static gint comp_int(gconstpointer a, gconstpointer b)
+static struct phonebook_entry *lookup_entry(struct pb_ref_rec *ref,
+						int adn_idx)
+{
+	struct phonebook_entry *entry;
+
+	if (adn_idx < 1 || adn_idx > ref->num_entries)
+		return NULL;
+
+	entry = &ref->entries[adn_idx - 1];
+
+	return entry->valid ? entry : NULL;
+}
+
+/* The entry is not exported before all records queued for it are read */
+static void queue_record(struct pb_ref_rec *ref, struct record_to_read *rec)
 {
-	int a_val = GPOINTER_TO_INT(a);
-	int b_val = GPOINTER_TO_INT(b);
+	if (rec->adn_idx >= 1 && rec->adn_idx <= ref->num_entries)
+		ref->entries[rec->adn_idx - 1].reads++;
 
-	return a_val - b_val;
+	g_queue_push_tail(&ref->pending_records, rec);
 }
 
 static const struct pb_file_info *
@@ -167,15 +196,24 @@ ext1_info(const GSList *pb_files)
 static struct phonebook_entry *handle_adn(size_t len, const unsigned char *msg,
 					struct pb_ref_rec *ref, int adn_idx)
 {
-	unsigned name_length = len - 14;
-	unsigned number_start = name_length;
+	unsigned name_length;
+	unsigned number_start;
 	unsigned number_length;
 	unsigned extension_record = UNUSED;
 	unsigned i, prefix;
 	char *number = NULL;
-	char *name = sim_string_to_utf8(msg, name_length);
+	char *name;
 	struct phonebook_entry *new_entry;
 
+	if (len < 14 || adn_idx < 1 || adn_idx > ref->num_entries) {
+		ofono_error("%s: bad EF_ADN record %d", __func__, adn_idx);
+		return NULL;
+	}
+
+	name_length = len - 14;
+	number_start = name_length;
+	name = sim_string_to_utf8(msg, name_length);
+
 	/* Length contains also TON & NPI */
 	number_length = msg[number_start];
 
@@ -214,20 +252,14 @@ static struct phonebook_entry *handle_adn(size_t len, const unsigned char *msg,
 	if ((name == NULL || *name == '\0') && number == NULL)
 		goto end;
 
-	new_entry = g_try_malloc0(sizeof(*new_entry));
-	if (new_entry == NULL) {
-		ofono_error("%s: out of memory", __func__);
-		goto end;
-	}
-
+	new_entry = &ref->entries[adn_idx - 1];
 	new_entry->name = name;
 	new_entry->number = number;
+	new_entry->valid = TRUE;
 
 	DBG("Creating PB entry %d with", adn_idx);
 	DBG("name %s and number %s", new_entry->name, new_entry->number);
 
-	g_tree_insert(ref->phonebook, GINT_TO_POINTER(adn_idx), new_entry);
-
 	if (extension_record != UNUSED) {
 		struct record_to_read *ext_rec =
 			g_try_malloc0(sizeof(*ext_rec));
@@ -240,8 +272,9 @@ static struct phonebook_entry *handle_adn(size_t len, const unsigned char *msg,
 			ext_rec->record = extension_record;
 			ext_rec->adn_idx = adn_idx;
 
-			ref->pending_records =
-				g_slist_prepend(ref->pending_records, ext_rec);
+			queue_record(ref, ext_rec);
+		} else {
+			g_free(ext_rec);
 		}
 	}
 
@@ -287,9 +320,7 @@ static void handle_iap(size_t len, const unsigned char *msg,
 				new_rec->anr_ext = FALSE;
 				new_rec->set_by_iap = TRUE;
 
-				ref->pending_records =
-					g_slist_prepend(ref->pending_records,
-							new_rec);
+				queue_record(ref, new_rec);
 			}
 			++i;
 		}
@@ -311,8 +342,7 @@ static void handle_sne(size_t len, const unsigned char *msg,
 	if (sne && *sne != '\0') {
 		struct phonebook_entry *entry;
 
-		entry = g_tree_lookup(ref->phonebook,
-				GINT_TO_POINTER(rec_data->adn_idx));
+		entry = lookup_entry(ref, rec_data->adn_idx);
 		if (entry) {
 			/* If one already exists, delete it */
 			if (entry->sne)
@@ -375,8 +405,7 @@ static void handle_anr(size_t len,
 		anr[2 * i + 1 + prefix] = digit_to_utf8[msg[3 + i] >> 4];
 	}
 
-	entry = g_tree_lookup(ref->phonebook,
-				GINT_TO_POINTER(rec_data->adn_idx));
+	entry = lookup_entry(ref, rec_data->adn_idx);
 	if (entry == NULL) {
 		g_free(anr);
 		return;
@@ -410,8 +439,9 @@ static void handle_anr(size_t len,
 			ext_rec->adn_idx = rec_data->adn_idx;
 			ext_rec->anr_ext = TRUE;
 
-			ref->pending_records =
-				g_slist_prepend(ref->pending_records, ext_rec);
+			queue_record(ref, ext_rec);
+		} else {
+			g_free(ext_rec);
 		}
 	}
 }
@@ -433,8 +463,7 @@ static void handle_email(size_t len, const unsigned char *msg,
 		return;
 	}
 
-	entry = g_tree_lookup(ref->phonebook,
-				GINT_TO_POINTER(rec_data->adn_idx));
+	entry = lookup_entry(ref, rec_data->adn_idx);
 	if (entry == NULL) {
 		g_free(email);
 		return;
@@ -480,8 +509,9 @@ static void handle_ext1(size_t len, const unsigned char *msg,
 			ext_rec->adn_idx = rec_data->adn_idx;
 			ext_rec->anr_ext = rec_data->anr_ext;
 
-			ref->pending_records =
-				g_slist_prepend(ref->pending_records, ext_rec);
+			queue_record(ref, ext_rec);
+		} else {
+			g_free(ext_rec);
 		}
 	}
 
@@ -504,8 +534,7 @@ static void handle_ext1(size_t len, const unsigned char *msg,
 	DBG("number length %d", number_length);
 
 	DBG("Looking for ADN entry %d", rec_data->adn_idx);
-	entry = g_tree_lookup(ref->phonebook,
-				GINT_TO_POINTER(rec_data->adn_idx));
+	entry = lookup_entry(ref, rec_data->adn_idx);
 	if (entry == NULL) {
 		g_free(ext_number);
 		return;
@@ -543,12 +572,42 @@ static const char *file_tag_to_string(enum file_type_tag tag)
 	}
 }
 
+static void queue_type1_records(struct pb_ref_rec *ref, int adn_idx)
+{
+	GSList *l;
+
+	for (l = ref->pb_files; l; l = l->next) {
+		const struct pb_file_info *f_info = l->data;
+		struct record_to_read *ext_rec;
+
+		if (f_info->pbr_type != TYPE_1_TAG ||
+				f_info->file_type == TYPE_ADN)
+			continue;
+
+		ext_rec = g_try_malloc0(sizeof(*ext_rec));
+		if (ext_rec == NULL)
+			break;
+
+		ext_rec->file_id = f_info->file_id;
+		ext_rec->type_tag = f_info->file_type;
+		ext_rec->record_length = f_info->record_length;
+		ext_rec->record = adn_idx;
+		ext_rec->adn_idx = adn_idx;
+
+		queue_record(ref, ext_rec);
+	}
+}
+
 static void decode_read_response(const struct record_to_read *rec_data,
 					const unsigned char *msg, size_t len,
 					struct pb_ref_rec *ref)
 {
 	DBG("Decoding %s type record", file_tag_to_string(rec_data->type_tag));
 	switch (rec_data->type_tag) {
+	case TYPE_ADN:
+		if (handle_adn(len, msg, ref, rec_data->adn_idx) != NULL)
+			queue_type1_records(ref, rec_data->adn_idx);
+		break;
 	case TYPE_IAP:
 		handle_iap(len, msg, ref, rec_data);
 		break;
@@ -570,11 +629,9 @@ static void decode_read_response(const struct record_to_read *rec_data,
 	}
 }
 
-static gboolean export_entry(gpointer key, gpointer value, gpointer data)
+static void export_entry(struct ofono_phonebook *pb,
+				const struct phonebook_entry *entry)
 {
-	struct ofono_phonebook *pb = data;
-	struct phonebook_entry *entry = value;
-
 	ofono_phonebook_entry(pb, -1,
 				entry->number, -1,
 				entry->name, -1,
@@ -583,15 +640,55 @@ static gboolean export_entry(gpointer key, gpointer value, gpointer data)
 				entry->sne,
 				entry->email,
 				NULL, NULL);
+}
 
+static void clear_entry(struct phonebook_entry *entry)
+{
 	g_free(entry->name);
 	g_free(entry->number);
 	g_free(entry->email);
 	g_free(entry->anr);
 	g_free(entry->sne);
-	g_free(entry);
 
-	return FALSE;
+	memset(entry, 0, sizeof(*entry));
+}
+
+static void free_ref(gpointer data)
+{
+	struct pb_ref_rec *ref = data;
+	int i;
+
+	for (i = 0; i < ref->num_entries; i++)
+		clear_entry(&ref->entries[i]);
+
+	g_free(ref->entries);
+	g_queue_foreach(&ref->pending_records, (GFunc) g_free, NULL);
+	g_queue_clear(&ref->pending_records);
+	g_slist_free_full(ref->sent_records, g_free);
+	g_slist_free_full(ref->pb_files, g_free);
+	g_free(ref);
+}
+
+/*
+ * Entries are handed to the core in EF_ADN order as soon as they and all
+ * the ones before them are complete, instead of keeping the whole
+ * phonebook around until the last record has been read.
+ */
+static void export_ready_entries(struct ofono_phonebook *pb,
+					struct pb_ref_rec *ref)
+{
+	while (ref->next_export < ref->next_adn - 1) {
+		struct phonebook_entry *entry = &ref->entries[ref->next_export];
+
+		if (entry->reads > 0)
+			break;
+
+		if (entry->valid)
+			export_entry(pb, entry);
+
+		clear_entry(entry);
+		ref->next_export++;
+	}
 }
 
 static void export_and_return(gboolean ok, struct cb_data *cbd)
@@ -599,21 +696,13 @@ static void export_and_return(gboolean ok, struct cb_data *cbd)
 	struct ofono_phonebook *pb = cbd->user;
 	ofono_phonebook_cb_t cb = cbd->cb;
 	struct pb_data *pbd = ofono_phonebook_get_data(pb);
-	GSList *l;
 
 	DBG("phonebook fully read");
 
-	for (l = pbd->pb_refs; l != NULL; l = l->next) {
-		struct pb_ref_rec *ref = l->data;
-
-		g_tree_foreach(ref->phonebook, export_entry, pb);
-		g_tree_destroy(ref->phonebook);
-		g_slist_free_full(ref->pending_records, g_free);
-		g_slist_free_full(ref->pb_files, g_free);
-	}
-
-	g_slist_free_full(pbd->pb_refs, g_free);
+	g_slist_free_full(pbd->pb_refs, free_ref);
 	pbd->pb_refs = NULL;
+	pbd->pb_ref_next = NULL;
+	pbd->export_cbd = NULL;
 
 	if (ok)
 		CALLBACK_WITH_SUCCESS(cb, cbd->data);
@@ -623,139 +712,142 @@ static void export_and_return(gboolean ok, struct cb_data *cbd)
 	g_free(cbd);
 }
 
-static void read_record_cb(int ok, int total_length, int record,
-			const unsigned char *data,
-			int record_length, void *userdata)
+static void read_next_ref(struct cb_data *cbd)
 {
-	struct cb_data *cbd = userdata;
 	struct ofono_phonebook *pb = cbd->user;
 	struct pb_data *pbd = ofono_phonebook_get_data(pb);
-	struct pb_ref_rec *ref = pbd->pb_ref_next->data;
-	struct record_to_read *rec;
+	struct pb_ref_rec *ref;
+	struct pb_file_info *file_info;
 
-	if (!ok) {
-		ofono_error("%s: error %d", __func__, ok);
-		export_and_return(FALSE, cbd);
+	/* Read files from next EF_PBR record, if any */
+	pbd->pb_ref_next = pbd->pb_ref_next->next;
+	if (pbd->pb_ref_next == NULL) {
+		export_and_return(TRUE, cbd);
 		return;
 	}
 
-	DBG("ok %d; total_length %d; record %d; record_length %d",
-		ok, total_length, record, record_length);
+	DBG("Next EFpbr record");
 
-	rec = ref->next_record->data;
+	ref = pbd->pb_ref_next->data;
 
-	/* This call might add elements to pending_records */
-	decode_read_response(rec, data, record_length, ref);
+	if (!ref->pb_files) {
+		export_and_return(TRUE, cbd);
+		return;
+	}
 
-	ref->pending_records = g_slist_remove(ref->pending_records, rec);
-	g_free(rec);
+	ref->pb_next = ref->pb_files;
+	file_info = ref->pb_files->data;
 
-	if (ref->pending_records) {
-		struct record_to_read *rec;
+	ofono_sim_read_info(pbd->sim_context, file_info->file_id,
+				OFONO_SIM_FILE_STRUCTURE_FIXED,
+				pbd->df_path, pbd->df_size,
+				read_info_cb, cbd);
+}
 
-		ref->next_record = ref->pending_records;
-		rec = ref->next_record->data;
+static void record_read_cb(const struct ofono_error *error,
+				const unsigned char *sdata, int length,
+				void *data);
 
-		ofono_sim_read_record(pbd->sim_context, rec->file_id,
-					OFONO_SIM_FILE_STRUCTURE_FIXED,
-					rec->record,
-					rec->record_length,
-					pbd->df_path, pbd->df_size,
-					read_record_cb, cbd);
-	} else {
-		/* Read files from next EF_PBR record, if any */
+/*
+ * Keeps up to pbd->window SIM_IO requests in flight.  Records that
+ * complete entries already started go first, so that they can be
+ * exported early, then the next EF_ADN record is read.
+ */
+static void read_pending_records(struct cb_data *cbd)
+{
+	struct ofono_phonebook *pb = cbd->user;
+	struct pb_data *pbd = ofono_phonebook_get_data(pb);
+	struct pb_ref_rec *ref = pbd->pb_ref_next->data;
+	const struct pb_file_info *adn_info = ref->pb_files->data;
+	struct record_to_read *rec;
 
-		pbd->pb_ref_next = pbd->pb_ref_next->next;
-		if (pbd->pb_ref_next == NULL) {
-			export_and_return(TRUE, cbd);
-		} else {
-			struct pb_ref_rec *ref;
+	while (!pbd->read_failed && pbd->in_flight < pbd->window) {
+		rec = g_queue_pop_head(&ref->pending_records);
 
-			DBG("Next EFpbr record");
+		if (rec == NULL) {
+			if (ref->next_adn > ref->num_entries)
+				break;
 
-			ref = pbd->pb_ref_next->data;
+			rec = g_try_malloc0(sizeof(*rec));
+			if (rec == NULL) {
+				ofono_error("%s: OOM", __func__);
+				pbd->read_failed = TRUE;
+				break;
+			}
 
-			if (!ref->pb_files) {
-				export_and_return(TRUE, cbd);
-			} else {
-				struct pb_file_info *file_info;
+			rec->file_id = adn_info->file_id;
+			rec->type_tag = TYPE_ADN;
+			rec->record_length = adn_info->record_length;
+			rec->record = ref->next_adn++;
+			rec->adn_idx = rec->record;
+			ref->entries[rec->adn_idx - 1].reads++;
+		}
 
-				ref->pb_next = ref->pb_files;
-				file_info = ref->pb_files->data;
+		rec->pbd = pbd;
 
-				ofono_sim_read_info(pbd->sim_context,
-						file_info->file_id,
-						OFONO_SIM_FILE_STRUCTURE_FIXED,
+		if (!ril_sim_read_record_direct(pbd->sim, pbd->ril,
+						rec->file_id, rec->record,
+						rec->record_length,
 						pbd->df_path, pbd->df_size,
-						read_info_cb, cbd);
-			}
+						record_read_cb, rec)) {
+			ofono_error("%s: can't read record %d of %x",
+					__func__, rec->record, rec->file_id);
+			g_free(rec);
+			pbd->read_failed = TRUE;
+			break;
 		}
+
+		ref->sent_records = g_slist_prepend(ref->sent_records, rec);
+		pbd->in_flight++;
+	}
+
+	if (pbd->in_flight > 0)
+		return;
+
+	if (pbd->read_failed) {
+		pbd->read_failed = FALSE;
+		export_and_return(FALSE, cbd);
+		return;
 	}
+
+	export_ready_entries(pb, ref);
+	read_next_ref(cbd);
 }
 
-static void pb_adn_cb(int ok, int total_length, int record,
-			const unsigned char *data,
-			int record_length, void *userdata)
+static void record_read_cb(const struct ofono_error *error,
+				const unsigned char *sdata, int length,
+				void *data)
 {
-	struct cb_data *cbd = userdata;
+	struct record_to_read *rec = data;
+	struct pb_data *pbd = rec->pbd;
+	struct cb_data *cbd = pbd->export_cbd;
 	struct ofono_phonebook *pb = cbd->user;
-	struct pb_data *pbd = ofono_phonebook_get_data(pb);
 	struct pb_ref_rec *ref = pbd->pb_ref_next->data;
-	GSList *l;
 
-	if (!ok) {
-		ofono_error("%s: error %d", __func__, ok);
-		export_and_return(FALSE, cbd);
-		return;
-	}
+	ref->sent_records = g_slist_remove(ref->sent_records, rec);
+	pbd->in_flight--;
 
-	DBG("ok %d; total_length %d; record %d; record_length %d",
-		ok, total_length, record, record_length);
-
-	if (handle_adn(record_length, data, ref, record) != NULL) {
-		/* Add type 1 records */
-		for (l = ref->pb_files; l; l = l->next) {
-			const struct pb_file_info *f_info = l->data;
-			struct record_to_read *ext_rec;
-
-			if (f_info->pbr_type == TYPE_1_TAG &&
-					f_info->file_type != TYPE_ADN) {
-				ext_rec = g_try_malloc0(sizeof(*ext_rec));
-				if (ext_rec == NULL)
-					break;
-
-				ext_rec->file_id = f_info->file_id;
-				ext_rec->type_tag = f_info->file_type;
-				ext_rec->record_length = f_info->record_length;
-				ext_rec->record = record;
-				ext_rec->adn_idx = record;
-
-				ref->pending_records =
-					g_slist_prepend(ref->pending_records,
-							ext_rec);
-			}
-		}
+	if (error->type != OFONO_ERROR_TYPE_NO_ERROR) {
+		ofono_error("%s: error reading record %d of %x", __func__,
+				rec->record, rec->file_id);
+		pbd->read_failed = TRUE;
+	} else if (!pbd->read_failed) {
+		DBG("file %x record %d length %d", rec->file_id, rec->record,
+			length);
+
+		/* This call might queue more records */
+		decode_read_response(rec, sdata, length, ref);
 	}
 
-	if (record*record_length >= total_length) {
-		DBG("All ADN records read: reading additional files");
+	if (rec->adn_idx >= 1 && rec->adn_idx <= ref->num_entries)
+		ref->entries[rec->adn_idx - 1].reads--;
 
-		if (ref->pending_records) {
-			struct record_to_read *rec;
+	g_free(rec);
 
-			ref->next_record = ref->pending_records;
-			rec = ref->next_record->data;
+	if (!pbd->read_failed)
+		export_ready_entries(pb, ref);
 
-			ofono_sim_read_record(pbd->sim_context, rec->file_id,
-						OFONO_SIM_FILE_STRUCTURE_FIXED,
-						rec->record,
-						rec->record_length,
-						pbd->df_path, pbd->df_size,
-						read_record_cb, cbd);
-		} else {
-			export_and_return(TRUE, cbd);
-		}
-	}
+	read_pending_records(cbd);
 }
 
 static void read_info_cb(int ok, unsigned char file_status,
@@ -790,13 +882,33 @@ static void read_info_cb(int ok, unsigned char file_status,
 			return;
 		}
 
-		/* Read full contents of the master file */
+		/* The master file comes first, its records index the table */
 		file_info = ref->pb_files->data;
 
-		ofono_sim_read_path(pbd->sim_context, file_info->file_id,
-					OFONO_SIM_FILE_STRUCTURE_FIXED,
-					pbd->df_path, pbd->df_size,
-					pb_adn_cb, cbd);
+		if (file_info->file_type != TYPE_ADN ||
+				file_info->record_length <= 0) {
+			ofono_warn("%s: no EF_ADN on SIM", __func__);
+			export_and_return(FALSE, cbd);
+			return;
+		}
+
+		ref->num_entries = file_info->file_length /
+						file_info->record_length;
+		ref->entries = g_try_new0(struct phonebook_entry,
+						ref->num_entries);
+		if (ref->num_entries > 0 && ref->entries == NULL) {
+			ofono_error("%s: OOM", __func__);
+			export_and_return(FALSE, cbd);
+			return;
+		}
+
+		ref->next_adn = 1;
+		ref->next_export = 0;
+
+		DBG("%d EF_ADN records, window %u", ref->num_entries,
+			pbd->window);
+
+		read_pending_records(cbd);
 	} else {
 		file_info = ref->pb_next->data;
 
@@ -825,8 +937,6 @@ static void start_sim_app_read(struct cb_data *cbd)
 		return;
 	}
 
-	ref_rec->phonebook = g_tree_new(comp_int);
-
 	/* Only EF_ADN and EF_EXT1 read for SIM */
 
 	f_info = g_try_malloc0(sizeof(*f_info));
@@ -893,8 +1003,6 @@ static void pb_reference_data_cb(int ok, int total_length, int record,
 		return;
 	}
 
-	ref_rec->phonebook = g_tree_new(comp_int);
-
 	while (ptr < sdata + record_length && finished == FALSE) {
 		int typelen, file_id, i;
 		enum constructed_tag pbr_type = *ptr;
@@ -987,6 +1095,7 @@ static void ril_export_entries(struct ofono_phonebook *pb,
 	}
 
 	cbd = cb_data_new(cb, data, pb);
+	pbd->export_cbd = cbd;
 
 	/* Assume USIM, change in case EF_PBR is not present */
 	pbd->df_path = usim_path;
@@ -1021,6 +1130,19 @@ static int ril_phonebook_probe(struct ofono_phonebook *pb,
 	if (pd->sim_context == NULL)
 		return -ENOENT;
 
+	pd->ril = ril_sim_clone_ril(pd->sim);
+	if (pd->ril == NULL) {
+		ofono_sim_context_free(pd->sim_context);
+		g_free(pd);
+		return -ENOENT;
+	}
+
+	pd->window = ofono_modem_get_integer(modem, "PhonebookReadWindow");
+	if (pd->window == 0)
+		pd->window = PB_READ_WINDOW_DEFAULT;
+	else if (pd->window > PB_READ_WINDOW_MAX)
+		pd->window = PB_READ_WINDOW_MAX;
+
 	ofono_phonebook_set_data(pb, pd);
 
 	g_idle_add(ril_delayed_register, pb);
@@ -1035,6 +1157,11 @@ static void ril_phonebook_remove(struct ofono_phonebook *pb)
 	ofono_phonebook_set_data(pb, NULL);
 	ofono_sim_context_free(pbd->sim_context);
 
+	/* Cancels the reads in flight, their records are freed below */
+	g_ril_unref(pbd->ril);
+
+	g_slist_free_full(pbd->pb_refs, free_ref);
+	g_free(pbd->export_cbd);
 	g_free(pbd);
 }
 
@@ -178,7 +178,7 @@ static gboolean send_set_radio_cap(struct radio_data *rd,
 	parcel_w_string(&rilp, logical_modem);
 	parcel_w_int32(&rilp, status);
 
-	g_ril_append_print_buf(rd->ril, "(%d,%d,%d,0x%X,%s,%d)", version,
+	g_ril_start_print_buf(rd->ril, "(%d,%d,%d,0x%X,%s,%d)", version,
 			session, phase, ril_rats, logical_modem, status);
 
 	if (g_ril_send(rd->ril, RIL_REQUEST_SET_RADIO_CAPABILITY,
@@ -0,0 +1,442 @@
+/*
+ *
+ *  oFono - Open Source Telephony - RIL Modem Support
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <glib.h>
+#include <gdbus.h>
+#include <ofono.h>
+
+#define OFONO_API_SUBJECT_TO_CHANGE
+#include <ofono/plugin.h>
+#include <ofono/log.h>
+#include <ofono/modem.h>
+#include <ofono/dbus.h>
+
+#include "rildebug.h"
+
+#define RIL_DEBUG_INTERFACE "org.ofono.RilDebug"
+
+struct ril_debug_data {
+	struct ofono_modem *modem;
+	GRil *ril;
+	GHashTable *startup;	/* atom name -> struct startup_time */
+	GHashTable *data_switch;	/* step name -> gint64 */
+};
+
+struct startup_time {
+	gint64 created;
+	gint64 registered;
+};
+
+static void append_histogram(DBusMessageIter *dict, const char *key,
+				const guint *hist)
+{
+	DBusMessageIter entry, value, array;
+	int i;
+
+	dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY,
+						NULL, &entry);
+
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+						DBUS_TYPE_ARRAY_AS_STRING
+						DBUS_TYPE_UINT32_AS_STRING,
+						&value);
+
+	dbus_message_iter_open_container(&value, DBUS_TYPE_ARRAY,
+						DBUS_TYPE_UINT32_AS_STRING,
+						&array);
+
+	for (i = 0; i < G_RIL_LATENCY_BUCKETS; i++) {
+		dbus_uint32_t count = hist[i];
+
+		dbus_message_iter_append_basic(&array, DBUS_TYPE_UINT32,
+						&count);
+	}
+
+	dbus_message_iter_close_container(&value, &array);
+	dbus_message_iter_close_container(&entry, &value);
+	dbus_message_iter_close_container(dict, &entry);
+}
+
+struct latency_ctx {
+	GRil *ril;
+	DBusMessageIter *iter;
+};
+
+static void append_latency(int req, const struct ril_latency_stats *stats,
+				gpointer user_data)
+{
+	struct latency_ctx *ctx = user_data;
+	DBusMessageIter entry, dict;
+	const char *name = g_ril_request_id_to_string(ctx->ril, req);
+	dbus_uint32_t count = stats->count;
+	dbus_uint64_t queue_time = stats->queue_time;
+	dbus_uint64_t modem_time = stats->modem_time;
+	dbus_uint64_t modem_time_max = stats->modem_time_max;
+
+	dbus_message_iter_open_container(ctx->iter, DBUS_TYPE_DICT_ENTRY,
+						NULL, &entry);
+
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+	ofono_dbus_dict_append(&dict, "Count", DBUS_TYPE_UINT32, &count);
+	ofono_dbus_dict_append(&dict, "QueueTime", DBUS_TYPE_UINT64,
+				&queue_time);
+	ofono_dbus_dict_append(&dict, "ModemTime", DBUS_TYPE_UINT64,
+				&modem_time);
+	ofono_dbus_dict_append(&dict, "ModemTimeMax", DBUS_TYPE_UINT64,
+				&modem_time_max);
+	append_histogram(&dict, "QueueHistogram", stats->queue_hist);
+	append_histogram(&dict, "ModemHistogram", stats->modem_hist);
+
+	dbus_message_iter_close_container(&entry, &dict);
+	dbus_message_iter_close_container(ctx->iter, &entry);
+}
+
+static DBusMessage *get_latency_stats(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	struct ril_debug_data *rdd = data;
+	struct latency_ctx ctx;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	ctx.ril = rdd->ril;
+	ctx.iter = &dict;
+	g_ril_latency_foreach(rdd->ril, append_latency, &ctx);
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
+static void append_startup_time(gpointer key, gpointer value,
+					gpointer user_data)
+{
+	const char *name = key;
+	struct startup_time *st = value;
+	DBusMessageIter *iter = user_data;
+	DBusMessageIter entry, dict;
+	dbus_uint64_t created = st->created;
+	dbus_uint64_t registered = st->registered;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY,
+						NULL, &entry);
+
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+	ofono_dbus_dict_append(&dict, "Created", DBUS_TYPE_UINT64, &created);
+	ofono_dbus_dict_append(&dict, "Registered", DBUS_TYPE_UINT64,
+				&registered);
+
+	dbus_message_iter_close_container(&entry, &dict);
+	dbus_message_iter_close_container(iter, &entry);
+}
+
+static DBusMessage *get_startup_times(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	struct ril_debug_data *rdd = data;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	g_hash_table_foreach(rdd->startup, append_startup_time, &dict);
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
+static void append_switch_step(gpointer key, gpointer value,
+					gpointer user_data)
+{
+	const char *name = key;
+	dbus_uint64_t elapsed = *(gint64 *) value;
+	DBusMessageIter *dict = user_data;
+
+	ofono_dbus_dict_append(dict, name, DBUS_TYPE_UINT64, &elapsed);
+}
+
+static DBusMessage *get_data_switch_times(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	struct ril_debug_data *rdd = data;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+	g_hash_table_foreach(rdd->data_switch, append_switch_step, &dict);
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
+static DBusMessage *get_properties(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	struct ril_debug_data *rdd = data;
+	struct ril_io_stats stats;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter dict;
+	dbus_uint64_t value;
+
+	if (!g_ril_get_io_stats(rdd->ril, &stats))
+		return __ofono_error_failed(msg);
+
+	reply = dbus_message_new_method_return(msg);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OFONO_PROPERTIES_ARRAY_SIGNATURE,
+					&dict);
+
+	value = stats.requests;
+	ofono_dbus_dict_append(&dict, "Requests", DBUS_TYPE_UINT64, &value);
+
+	value = stats.responses;
+	ofono_dbus_dict_append(&dict, "Responses", DBUS_TYPE_UINT64, &value);
+
+	value = stats.unsolicited;
+	ofono_dbus_dict_append(&dict, "Unsolicited", DBUS_TYPE_UINT64,
+				&value);
+
+	value = stats.coalesced;
+	ofono_dbus_dict_append(&dict, "Coalesced", DBUS_TYPE_UINT64, &value);
+
+	value = stats.timeouts;
+	ofono_dbus_dict_append(&dict, "Timeouts", DBUS_TYPE_UINT64, &value);
+
+	value = stats.bytes_written;
+	ofono_dbus_dict_append(&dict, "BytesWritten", DBUS_TYPE_UINT64,
+				&value);
+
+	value = stats.bytes_read;
+	ofono_dbus_dict_append(&dict, "BytesRead", DBUS_TYPE_UINT64, &value);
+
+	value = stats.reconnects;
+	ofono_dbus_dict_append(&dict, "Reconnects", DBUS_TYPE_UINT64, &value);
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
+static DBusMessage *reset_stats(DBusConnection *conn,
+					DBusMessage *msg, void *data)
+{
+	struct ril_debug_data *rdd = data;
+
+	g_ril_reset_stats(rdd->ril);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static const GDBusMethodTable ril_debug_methods[] = {
+	{ GDBUS_METHOD("GetProperties",
+			NULL, GDBUS_ARGS({ "properties", "a{sv}" }),
+			get_properties) },
+	{ GDBUS_METHOD("GetLatencyStats",
+			NULL, GDBUS_ARGS({ "stats", "a{sa{sv}}" }),
+			get_latency_stats) },
+	{ GDBUS_METHOD("GetStartupTimes",
+			NULL, GDBUS_ARGS({ "times", "a{sa{sv}}" }),
+			get_startup_times) },
+	{ GDBUS_METHOD("GetDataSwitchTimes",
+			NULL, GDBUS_ARGS({ "times", "a{sv}" }),
+			get_data_switch_times) },
+	{ GDBUS_METHOD("Reset", NULL, NULL, reset_stats) },
+	{ }
+};
+
+static void register_interface(struct ril_debug_data *rdd)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+
+	if (!g_dbus_register_interface(conn, ofono_modem_get_path(rdd->modem),
+					RIL_DEBUG_INTERFACE,
+					ril_debug_methods, NULL,
+					NULL, rdd, NULL)) {
+		ofono_error("Could not create %s interface",
+				RIL_DEBUG_INTERFACE);
+		return;
+	}
+
+	ofono_modem_add_interface(rdd->modem, RIL_DEBUG_INTERFACE);
+}
+
+static void unregister_interface(struct ril_debug_data *rdd)
+{
+	DBusConnection *conn = ofono_dbus_get_connection();
+
+	ofono_modem_remove_interface(rdd->modem, RIL_DEBUG_INTERFACE);
+
+	g_dbus_unregister_interface(conn,
+					ofono_modem_get_path(rdd->modem),
+					RIL_DEBUG_INTERFACE);
+}
+
+struct ril_debug_data *ril_debug_create(struct ofono_modem *modem, GRil *ril)
+{
+	struct ril_debug_data *rdd = g_try_malloc0(sizeof(*rdd));
+
+	DBG("");
+
+	if (rdd == NULL) {
+		ofono_error("%s: Cannot allocate ril_debug_data", __func__);
+		return NULL;
+	}
+
+	rdd->modem = modem;
+	rdd->ril = g_ril_clone(ril);
+	rdd->startup = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, g_free);
+	rdd->data_switch = g_hash_table_new_full(g_str_hash, g_str_equal,
+							g_free, g_free);
+
+	register_interface(rdd);
+
+	return rdd;
+}
+
+void ril_debug_remove(struct ril_debug_data *rdd)
+{
+	DBG("");
+
+	if (rdd == NULL)
+		return;
+
+	unregister_interface(rdd);
+
+	g_hash_table_destroy(rdd->startup);
+	g_hash_table_destroy(rdd->data_switch);
+	g_ril_unref(rdd->ril);
+	g_free(rdd);
+}
+
+void ril_debug_set_ril(struct ril_debug_data *rdd, GRil *ril)
+{
+	GRil *old;
+
+	if (rdd == NULL)
+		return;
+
+	old = rdd->ril;
+	rdd->ril = g_ril_clone(ril);
+	g_ril_unref(old);
+}
+
+void ril_debug_atom_started(struct ril_debug_data *rdd, const char *atom,
+				gint64 created, gint64 registered)
+{
+	struct startup_time *st;
+
+	if (rdd == NULL)
+		return;
+
+	st = g_new0(struct startup_time, 1);
+	st->created = created;
+	st->registered = registered;
+
+	g_hash_table_replace(rdd->startup, g_strdup(atom), st);
+}
+
+void ril_debug_data_switch_reset(struct ril_debug_data *rdd)
+{
+	if (rdd == NULL)
+		return;
+
+	g_hash_table_remove_all(rdd->data_switch);
+}
+
+void ril_debug_data_switch_step(struct ril_debug_data *rdd, const char *step,
+				gint64 elapsed)
+{
+	if (rdd == NULL)
+		return;
+
+	g_hash_table_replace(rdd->data_switch, g_strdup(step),
+				g_memdup(&elapsed, sizeof(elapsed)));
+}
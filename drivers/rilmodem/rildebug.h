@@ -0,0 +1,52 @@
+/*
+ *
+ *  oFono - Open Source Telephony - RIL Modem Support
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef RILDEBUG_H
+#define RILDEBUG_H
+
+#include <ofono/types.h>
+
+#include "gril.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ril_debug_data;
+
+struct ril_debug_data *ril_debug_create(struct ofono_modem *modem, GRil *ril);
+void ril_debug_remove(struct ril_debug_data *rdd);
+
+/* Points the counters at the GRil that replaced the one it was created with */
+void ril_debug_set_ril(struct ril_debug_data *rdd, GRil *ril);
+
+/* Times are in microseconds since the modem was enabled */
+void ril_debug_atom_started(struct ril_debug_data *rdd, const char *atom,
+				gint64 created, gint64 registered);
+
+/* Times are in microseconds since the data switch started */
+void ril_debug_data_switch_reset(struct ril_debug_data *rdd);
+void ril_debug_data_switch_step(struct ril_debug_data *rdd, const char *step,
+				gint64 elapsed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RILDEBUG_H */
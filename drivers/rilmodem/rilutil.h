@@ -94,6 +94,21 @@ struct ril_radio_settings_driver_data {
 	struct ofono_modem *modem;
 };
 
+/*
+ * Reads a record of the active SIM application without going through the
+ * core SIM file system, which serializes all accesses.  The request is
+ * sent on ril, a GRil from ril_sim_clone_ril(), so several can be in
+ * flight and they are all cancelled when it is unref'ed.  Returns FALSE
+ * if it could not be sent, in which case cb is not called.  Only valid
+ * for rilmodem SIM atoms.
+ */
+GRil *ril_sim_clone_ril(struct ofono_sim *sim);
+gboolean ril_sim_read_record_direct(struct ofono_sim *sim, GRil *ril,
+					int fileid, int record, int length,
+					const unsigned char *path,
+					unsigned int path_len,
+					ofono_sim_read_cb_t cb, void *data);
+
 void decode_ril_error(struct ofono_error *error, const char *final);
 gchar *ril_util_get_netmask(const char *address);
 
@@ -97,6 +97,48 @@ struct sim_data {
 	struct ofono_modem *modem;
 	ofono_sim_state_event_cb_t ril_state_watch;
 	ofono_bool_t unlock_pending;
+	GSList *ef_sizes;		/* struct ef_size, most recent first */
+	GSList *read_ahead;		/* struct read_ahead */
+};
+
+/*
+ * The core reads EFs one record, or one 256 byte block, at a time and only
+ * asks for the next one when the previous has arrived.  To avoid paying a
+ * full round trip to rild for each of them we keep reading ahead of the
+ * core up to READ_AHEAD_WINDOW records or blocks, within the size that
+ * GET RESPONSE reported for the file, and answer from that buffer.
+ */
+#define READ_AHEAD_WINDOW	4
+#define READ_BINARY_MAX		256	/* Le of a short READ BINARY */
+#define EF_SIZES_MAX		16
+
+struct ef_size {
+	int fileid;
+	unsigned char path[6];
+	unsigned int path_len;
+	int length;
+	int record_length;
+};
+
+struct read_ahead {
+	int refcount;
+	struct sim_data *sd;
+	gboolean buffered;	/* Still in sd->read_ahead */
+	gboolean binary;
+	int fileid;
+	unsigned char path[6];
+	unsigned int path_len;
+	int index;		/* Record number, or offset for READ BINARY */
+	int length;
+	unsigned char *data;	/* NULL while in flight */
+	int data_len;
+	ofono_sim_read_cb_t cb;	/* Set once the core asks for it */
+	void *cb_data;
+};
+
+struct info_req {
+	struct sim_data *sd;
+	struct ef_size size;
 };
 
 struct change_state_cbd {
@@ -110,11 +152,121 @@ struct change_state_cbd {
 
 static void send_get_sim_status(struct ofono_sim *sim);
 
+static gboolean path_equal(const unsigned char *path, unsigned int path_len,
+				const unsigned char *other,
+				unsigned int other_len)
+{
+	if (path_len != other_len)
+		return FALSE;
+
+	return path_len == 0 || memcmp(path, other, path_len) == 0;
+}
+
+static const struct ef_size *find_ef_size(struct sim_data *sd, int fileid,
+						const unsigned char *path,
+						unsigned int path_len)
+{
+	GSList *l;
+
+	for (l = sd->ef_sizes; l; l = l->next) {
+		const struct ef_size *size = l->data;
+
+		if (size->fileid == fileid &&
+				path_equal(size->path, size->path_len,
+						path, path_len))
+			return size;
+	}
+
+	return NULL;
+}
+
+static void remember_ef_size(struct sim_data *sd, const struct ef_size *size)
+{
+	struct ef_size *old = (struct ef_size *) find_ef_size(sd, size->fileid,
+							size->path,
+							size->path_len);
+	GSList *last;
+
+	if (size->fileid < 0)
+		return;
+
+	if (old != NULL) {
+		sd->ef_sizes = g_slist_remove(sd->ef_sizes, old);
+		g_free(old);
+	}
+
+	sd->ef_sizes = g_slist_prepend(sd->ef_sizes,
+					g_memdup(size, sizeof(*size)));
+
+	if (g_slist_length(sd->ef_sizes) <= EF_SIZES_MAX)
+		return;
+
+	last = g_slist_last(sd->ef_sizes);
+	g_free(last->data);
+	sd->ef_sizes = g_slist_delete_link(sd->ef_sizes, last);
+}
+
+static void read_ahead_unref(gpointer data)
+{
+	struct read_ahead *ra = data;
+
+	if (--ra->refcount > 0)
+		return;
+
+	g_free(ra->data);
+	g_free(ra);
+}
+
+static void read_ahead_drop(struct read_ahead *ra)
+{
+	struct sim_data *sd = ra->sd;
+
+	if (!ra->buffered)
+		return;
+
+	ra->buffered = FALSE;
+	sd->read_ahead = g_slist_remove(sd->read_ahead, ra);
+	read_ahead_unref(ra);
+}
+
+/* Drops what was read ahead for fileid, or for all files if it is -1 */
+static void read_ahead_flush(struct sim_data *sd, int fileid)
+{
+	GSList *l = sd->read_ahead;
+
+	while (l) {
+		struct read_ahead *ra = l->data;
+
+		l = l->next;
+
+		if (fileid == -1 || ra->fileid == fileid)
+			read_ahead_drop(ra);
+	}
+}
+
+/* Forgets both buffered data and file sizes */
+static void read_ahead_reset(struct sim_data *sd)
+{
+	read_ahead_flush(sd, -1);
+
+	g_slist_free_full(sd->ef_sizes, g_free);
+	sd->ef_sizes = NULL;
+}
+
+static void info_cbd_free(gpointer data)
+{
+	struct cb_data *cbd = data;
+
+	g_free(cbd->user);
+	g_free(cbd);
+}
+
 static void ril_file_info_cb(struct ril_msg *message, gpointer user_data)
 {
 	struct cb_data *cbd = user_data;
 	ofono_sim_file_info_cb_t cb = cbd->cb;
-	struct sim_data *sd = cbd->user;
+	struct info_req *info = cbd->user;
+	struct sim_data *sd = info->sd;
 	struct ofono_error error;
 	gboolean ok = FALSE;
 	int sw1, sw2;
@@ -199,6 +351,10 @@ static void ril_file_info_cb(struct ril_msg *message, gpointer user_data)
 		goto error;
 	}
 
+	info->size.length = flen;
+	info->size.record_length = rlen;
+	remember_ef_size(sd, &info->size);
+
 	cb(&error, flen, str, rlen, access, file_status, cbd->data);
 
 	g_ril_reply_free_sim_io(reply);
@@ -217,13 +373,26 @@ static void ril_sim_read_info(struct ofono_sim *sim, int fileid,
 				ofono_sim_file_info_cb_t cb, void *data)
 {
 	struct sim_data *sd = ofono_sim_get_data(sim);
-	struct cb_data *cbd = cb_data_new(cb, data, sd);
+	struct info_req *info = g_new0(struct info_req, 1);
+	struct cb_data *cbd = cb_data_new(cb, data, info);
 	struct parcel rilp;
 	struct req_sim_read_info req;
 	guint ret = 0;
 
 	DBG("file %04x", fileid);
 
+	info->sd = sd;
+	info->size.fileid = fileid;
+
+	if (path_len <= sizeof(info->size.path)) {
+		info->size.path_len = path_len;
+		if (path_len > 0)
+			memcpy(info->size.path, path, path_len);
+	} else {
+		/* Not tracked, read_ahead_window() will not find it */
+		info->size.fileid = -1;
+	}
+
 	req.app_type = sd->app_type;
 	req.aid_str = sd->aid_str;
 	req.fileid = fileid;
@@ -238,58 +407,63 @@ static void ril_sim_read_info(struct ofono_sim *sim, int fileid,
 	}
 
 	g_ril_append_print_buf(sd->ril,
-				"%s0,0,15,(null),pin2=(null),aid=%s)",
-				print_buf,
+				"0,0,15,(null),pin2=(null),aid=%s)",
 				sd->aid_str);
 
 	ret = g_ril_send(sd->ril, RIL_REQUEST_SIM_IO, &rilp,
-				ril_file_info_cb, cbd, g_free);
+				ril_file_info_cb, cbd, info_cbd_free);
 
 error:
 	if (ret == 0) {
-		g_free(cbd);
+		info_cbd_free(cbd);
 		CALLBACK_WITH_FAILURE(cb, -1, -1, -1, NULL,
 				EF_STATUS_INVALIDATED, data);
 	}
 }
 
-static void ril_file_io_cb(struct ril_msg *message, gpointer user_data)
+static struct reply_sim_io *parse_read_reply(GRil *ril,
+						struct ril_msg *message)
 {
-	struct cb_data *cbd = user_data;
-	ofono_sim_read_cb_t cb = cbd->cb;
-	struct sim_data *sd = cbd->user;
-	struct ofono_error error;
 	struct reply_sim_io *reply;
 
-	if (message->error == RIL_E_SUCCESS) {
-		decode_ril_error(&error, "OK");
-	} else {
+	if (message->error != RIL_E_SUCCESS) {
 		ofono_error("RILD reply failure: %s",
 				ril_error_to_string(message->error));
-		goto error;
+		return NULL;
 	}
 
-	reply = g_ril_reply_parse_sim_io(sd->ril, message);
+	reply = g_ril_reply_parse_sim_io(ril, message);
 	if (reply == NULL) {
 		ofono_error("Can't parse SIM IO response from RILD");
-		goto error;
+		return NULL;
 	}
 
 	if (reply->hex_len == 0) {
 		ofono_error("Null SIM IO response from RILD");
 		g_ril_reply_free_sim_io(reply);
-		goto error;
+		return NULL;
 	}
 
-	cb(&error, reply->hex_response, reply->hex_len, cbd->data);
+	return reply;
+}
 
-	g_ril_reply_free_sim_io(reply);
+static void ril_file_io_cb(struct ril_msg *message, gpointer user_data)
+{
+	struct cb_data *cbd = user_data;
+	ofono_sim_read_cb_t cb = cbd->cb;
+	GRil *ril = cbd->user;
+	struct reply_sim_io *reply;
 
-	return;
+	reply = parse_read_reply(ril, message);
+	if (reply == NULL) {
+		CALLBACK_WITH_FAILURE(cb, NULL, 0, cbd->data);
+		return;
+	}
 
-error:
-	decode_ril_error(&error, "FAIL");
-	cb(&error, NULL, 0, cbd->data);
+	CALLBACK_WITH_SUCCESS(cb, reply->hex_response, reply->hex_len,
+				cbd->data);
+
+	g_ril_reply_free_sim_io(reply);
 }
 
 static void ril_file_write_cb(struct ril_msg *message, gpointer user_data)
@@ -339,6 +513,261 @@ error:
 	CALLBACK_WITH_FAILURE(cb, cbd->data);
 }
 
+static gboolean build_read(struct sim_data *sd, GRil *ril, gboolean binary,
+				int fileid, int index, int length,
+				const unsigned char *path,
+				unsigned int path_len,
+				struct parcel *rilp)
+{
+	if (binary) {
+		struct req_sim_read_binary req;
+
+		req.app_type = sd->app_type;
+		req.aid_str = sd->aid_str;
+		req.fileid = fileid;
+		req.path = path;
+		req.path_len = path_len;
+		req.start = index;
+		req.length = length;
+
+		if (!g_ril_request_sim_read_binary(ril, &req, rilp)) {
+			ofono_error("Couldn't build SIM read binary request");
+			return FALSE;
+		}
+
+		g_ril_append_print_buf(ril,
+				"%d,%d,%d,(null),pin2=(null),aid=%s)",
+				(index >> 8),
+				(index & 0xff),
+				length,
+				sd->aid_str);
+	} else {
+		struct req_sim_read_record req;
+
+		req.app_type = sd->app_type;
+		req.aid_str = sd->aid_str;
+		req.fileid = fileid;
+		req.path = path;
+		req.path_len = path_len;
+		req.record = index;
+		req.length = length;
+
+		if (!g_ril_request_sim_read_record(ril, &req, rilp)) {
+			ofono_error("Couldn't build SIM read record request");
+			return FALSE;
+		}
+
+		g_ril_append_print_buf(ril,
+				"%d,%d,%d,(null),pin2=(null),aid=%s)",
+				index,
+				4,
+				length,
+				sd->aid_str);
+	}
+
+	return TRUE;
+}
+
+static void read_ahead_cb(struct ril_msg *message, gpointer user_data)
+{
+	struct read_ahead *ra = user_data;
+	ofono_sim_read_cb_t cb = ra->cb;
+	struct reply_sim_io *reply;
+
+	reply = parse_read_reply(ra->sd->ril, message);
+
+	if (cb == NULL) {
+		/* Nobody asked yet, keep it for when the core does */
+		if (reply == NULL) {
+			read_ahead_drop(ra);
+			return;
+		}
+
+		if (ra->buffered) {
+			ra->data = g_memdup(reply->hex_response,
+						reply->hex_len);
+			ra->data_len = reply->hex_len;
+		}
+
+		g_ril_reply_free_sim_io(reply);
+		return;
+	}
+
+	ra->cb = NULL;
+	read_ahead_drop(ra);
+
+	if (reply == NULL) {
+		CALLBACK_WITH_FAILURE(cb, NULL, 0, ra->cb_data);
+		return;
+	}
+
+	CALLBACK_WITH_SUCCESS(cb, reply->hex_response, reply->hex_len,
+				ra->cb_data);
+
+	g_ril_reply_free_sim_io(reply);
+}
+
+static struct read_ahead *read_ahead_find(struct sim_data *sd,
+						gboolean binary, int fileid,
+						int index, int length,
+						const unsigned char *path,
+						unsigned int path_len)
+{
+	GSList *l;
+
+	for (l = sd->read_ahead; l; l = l->next) {
+		struct read_ahead *ra = l->data;
+
+		if (ra->binary == binary && ra->fileid == fileid &&
+				ra->index == index && ra->length == length &&
+				path_equal(ra->path, ra->path_len,
+						path, path_len))
+			return ra;
+	}
+
+	return NULL;
+}
+
+static struct read_ahead *read_ahead_send(struct sim_data *sd,
+						gboolean binary, int fileid,
+						int index, int length,
+						const unsigned char *path,
+						unsigned int path_len)
+{
+	struct read_ahead *ra;
+	struct parcel rilp;
+
+	if (path_len > sizeof(ra->path))
+		return NULL;
+
+	if (!build_read(sd, sd->ril, binary, fileid, index, length,
+				path, path_len, &rilp))
+		return NULL;
+
+	ra = g_new0(struct read_ahead, 1);
+	ra->refcount = 2;	/* The buffer and the request */
+	ra->sd = sd;
+	ra->buffered = TRUE;
+	ra->binary = binary;
+	ra->fileid = fileid;
+	ra->path_len = path_len;
+	if (path_len > 0)
+		memcpy(ra->path, path, path_len);
+	ra->index = index;
+	ra->length = length;
+
+	if (g_ril_send(sd->ril, RIL_REQUEST_SIM_IO, &rilp, read_ahead_cb,
+				ra, read_ahead_unref) == 0) {
+		g_free(ra);
+		return NULL;
+	}
+
+	sd->read_ahead = g_slist_append(sd->read_ahead, ra);
+
+	return ra;
+}
+
+/* Keeps the records or blocks following index in flight or buffered */
+static void read_ahead_window(struct sim_data *sd, gboolean binary,
+				int fileid, int index, int length,
+				const unsigned char *path,
+				unsigned int path_len)
+{
+	const struct ef_size *size;
+	int i;
+
+	size = find_ef_size(sd, fileid, path, path_len);
+	if (size == NULL)
+		return;
+
+	for (i = 1; i <= READ_AHEAD_WINDOW; i++) {
+		int next, next_len;
+
+		if (binary) {
+			/* Only the block by block pattern of the core */
+			if (index % READ_BINARY_MAX != 0)
+				return;
+
+			next = index + i * READ_BINARY_MAX;
+			if (next >= size->length)
+				return;
+
+			next_len = MIN(size->length - next, READ_BINARY_MAX);
+		} else {
+			if (size->record_length != length)
+				return;
+
+			next = index + i;
+			if (next > size->length / size->record_length)
+				return;
+
+			next_len = length;
+		}
+
+		if (read_ahead_find(sd, binary, fileid, next, next_len,
+					path, path_len) != NULL)
+			continue;
+
+		if (read_ahead_send(sd, binary, fileid, next, next_len,
+					path, path_len) == NULL)
+			return;
+	}
+}
+
+static void read_with_read_ahead(struct sim_data *sd, gboolean binary,
+					int fileid, int index, int length,
+					const unsigned char *path,
+					unsigned int path_len,
+					ofono_sim_read_cb_t cb, void *data)
+{
+	struct read_ahead *ra;
+	GSList *l;
+
+	DBG("file %04x %s %d", fileid, binary ? "offset" : "record", index);
+
+	/* The core reads a file at a time, forget about the previous one */
+	for (l = sd->read_ahead; l; ) {
+		ra = l->data;
+		l = l->next;
+
+		if (ra->fileid != fileid ||
+				!path_equal(ra->path, ra->path_len,
+						path, path_len))
+			read_ahead_drop(ra);
+	}
+
+	ra = read_ahead_find(sd, binary, fileid, index, length,
+				path, path_len);
+
+	if (ra != NULL && ra->data != NULL) {
+		DBG("read ahead hit");
+
+		ra->refcount++;
+		read_ahead_drop(ra);
+
+		CALLBACK_WITH_SUCCESS(cb, ra->data, ra->data_len, data);
+
+		read_ahead_unref(ra);
+	} else if (ra != NULL && ra->cb == NULL) {
+		DBG("read ahead in flight");
+
+		ra->cb = cb;
+		ra->cb_data = data;
+	} else {
+		ra = read_ahead_send(sd, binary, fileid, index, length,
+					path, path_len);
+		if (ra == NULL) {
+			CALLBACK_WITH_FAILURE(cb, NULL, 0, data);
+			return;
+		}
+
+		ra->cb = cb;
+		ra->cb_data = data;
+	}
+
+	read_ahead_window(sd, binary, fileid, index, length, path, path_len);
+}
+
 static void ril_sim_read_binary(struct ofono_sim *sim, int fileid,
 				int start, int length,
 				const unsigned char *path,
@@ -346,43 +775,35 @@ static void ril_sim_read_binary(struct ofono_sim *sim, int fileid,
 				ofono_sim_read_cb_t cb, void *data)
 {
 	struct sim_data *sd = ofono_sim_get_data(sim);
-	struct cb_data *cbd = cb_data_new(cb, data, sd);
+
+	read_with_read_ahead(sd, TRUE, fileid, start, length,
+				path, path_len, cb, data);
+}
+
+static guint send_read_record(struct sim_data *sd, GRil *ril, int fileid,
+				int record, int length,
+				const unsigned char *path,
+				unsigned int path_len,
+				ofono_sim_read_cb_t cb, void *data)
+{
+	struct cb_data *cbd;
 	struct parcel rilp;
-	struct req_sim_read_binary req;
-	gint ret = 0;
+	guint ret;
 
 	DBG("file %04x", fileid);
 
-	req.app_type = sd->app_type;
-	req.aid_str = sd->aid_str;
-	req.fileid = fileid;
-	req.path = path;
-	req.path_len = path_len;
-	req.start = start;
-	req.length = length;
-
-	if (!g_ril_request_sim_read_binary(sd->ril,
-						&req,
-						&rilp)) {
-		ofono_error("Couldn't build SIM read binary request");
-		goto error;
-	}
+	if (!build_read(sd, ril, FALSE, fileid, record, length,
+				path, path_len, &rilp))
+		return 0;
 
-	g_ril_append_print_buf(sd->ril,
-				"%s%d,%d,%d,(null),pin2=(null),aid=%s)",
-				print_buf,
-				(start >> 8),
-				(start & 0xff),
-				length,
-				sd->aid_str);
+	cbd = cb_data_new(cb, data, ril);
 
-	ret = g_ril_send(sd->ril, RIL_REQUEST_SIM_IO, &rilp,
+	ret = g_ril_send(ril, RIL_REQUEST_SIM_IO, &rilp,
 				ril_file_io_cb, cbd, g_free);
-error:
-	if (ret == 0) {
+	if (ret == 0)
 		g_free(cbd);
-		CALLBACK_WITH_FAILURE(cb, NULL, 0, data);
-	}
+
+	return ret;
 }
 
 static void ril_sim_read_record(struct ofono_sim *sim, int fileid,
@@ -392,44 +813,34 @@ static void ril_sim_read_record(struct ofono_sim *sim, int fileid,
 				ofono_sim_read_cb_t cb, void *data)
 {
 	struct sim_data *sd = ofono_sim_get_data(sim);
-	struct cb_data *cbd = cb_data_new(cb, data, sd);
-	struct parcel rilp;
-	struct req_sim_read_record req;
-	guint ret = 0;
 
-	DBG("file %04x", fileid);
+	read_with_read_ahead(sd, FALSE, fileid, record, length,
+				path, path_len, cb, data);
+}
 
-	req.app_type = sd->app_type;
-	req.aid_str = sd->aid_str;
-	req.fileid = fileid;
-	req.path = path;
-	req.path_len = path_len;
-	req.record = record;
-	req.length = length;
+GRil *ril_sim_clone_ril(struct ofono_sim *sim)
+{
+	struct sim_data *sd = ofono_sim_get_data(sim);
 
-	if (!g_ril_request_sim_read_record(sd->ril,
-						&req,
-						&rilp)) {
-		ofono_error("Couldn't build SIM read record request");
-		goto error;
-	}
+	if (sd == NULL)
+		return NULL;
 
-	g_ril_append_print_buf(sd->ril,
-				"%s%d,%d,%d,(null),pin2=(null),aid=%s)",
-				print_buf,
-				record,
-				4,
-				length,
-				sd->aid_str);
+	return g_ril_clone(sd->ril);
+}
 
-	ret = g_ril_send(sd->ril, RIL_REQUEST_SIM_IO, &rilp,
-				ril_file_io_cb, cbd, g_free);
+gboolean ril_sim_read_record_direct(struct ofono_sim *sim, GRil *ril,
+					int fileid, int record, int length,
+					const unsigned char *path,
+					unsigned int path_len,
+					ofono_sim_read_cb_t cb, void *data)
+{
+	struct sim_data *sd = ofono_sim_get_data(sim);
 
-error:
-	if (ret == 0) {
-		g_free(cbd);
-		CALLBACK_WITH_FAILURE(cb, NULL, 0, data);
-	}
+	if (sd == NULL)
+		return FALSE;
+
+	return send_read_record(sd, ril, fileid, record, length,
+				path, path_len, cb, data) != 0;
 }
 
 static void ril_sim_update_binary(struct ofono_sim *sim, int fileid,
@@ -447,6 +858,8 @@ static void ril_sim_update_binary(struct ofono_sim *sim, int fileid,
 
 	DBG("file 0x%04x", fileid);
 
+	read_ahead_flush(sd, fileid);
+
 	req.app_type = sd->app_type;
 	req.aid_str = sd->aid_str;
 	req.fileid = fileid;
@@ -487,6 +900,8 @@ static void update_record(struct ofono_sim *sim, int fileid,
 
 	DBG("file 0x%04x", fileid);
 
+	read_ahead_flush(sd, fileid);
+
 	req.app_type = sd->app_type;
 	req.aid_str = sd->aid_str;
 	req.fileid = fileid;
@@ -587,6 +1002,9 @@ static void configure_active_app(struct sim_data *sd,
 					struct reply_sim_app *app,
 					guint index)
 {
+	if (g_strcmp0(sd->aid_str, app->aid_str) != 0)
+		read_ahead_reset(sd);
+
 	g_free(sd->aid_str);
 	g_free(sd->app_str);
 	sd->app_type = app->app_type;
@@ -849,6 +1267,9 @@ static void ril_sim_status_changed(struct ril_msg *message, gpointer user_data)
 
 	g_ril_print_unsol_no_args(sd->ril, message);
 
+	/* Files might have changed under us, or the card itself */
+	read_ahead_reset(sd);
+
 	send_get_sim_status(sim);
 }
 
@@ -1266,6 +1687,8 @@ static void ril_sim_remove(struct ofono_sim *sim)
 
 	ofono_sim_set_data(sim, NULL);
 
+	read_ahead_reset(sd);
+
 	g_ril_unref(sd->ril);
 	g_free(sd->aid_str);
 	g_free(sd->app_str);
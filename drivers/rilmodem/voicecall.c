@@ -49,9 +49,19 @@
 #include "rilmodem.h"
 #include "voicecall.h"
 
-/* Amount of ms we wait between CLCC calls */
+/* Amount of ms we wait between CLCC calls in fixed polling mode */
 #define POLL_CLCC_INTERVAL 300
 
+/*
+ * Otherwise call state follows CALL_STATE_CHANGED, and we only poll while
+ * a dialed call has not shown up yet, backing off between these bounds.
+ */
+#define CLCC_BACKOFF_MIN_MS 50
+#define CLCC_BACKOFF_MAX_MS 1600
+
+/* How long a dialed call may take to show up before the dial fails */
+#define DIAL_TIMEOUT_S 20
+
 #define FLAG_NEED_CLIP 1
 
 #define MAX_DTMF_BUFFER 32
@@ -91,6 +101,49 @@ struct hold_before_dial_req {
 
 static void send_one_dtmf(struct ril_voicecall_data *vd);
 static void clear_dtmf_queue(struct ril_voicecall_data *vd);
+static void clcc_poll_cb(struct ril_msg *message, gpointer user_data);
+
+/*
+ * Requests the call list, unless a request is already in flight: then it
+ * is repeated once when the reply arrives, so that a burst of indications
+ * costs at most two GET_CURRENT_CALLS.
+ */
+static void clcc_request(struct ofono_voicecall *vc)
+{
+	struct ril_voicecall_data *vd = ofono_voicecall_get_data(vc);
+
+	if (vd->clcc_pending) {
+		vd->clcc_dirty = TRUE;
+		return;
+	}
+
+	if (vd->clcc_source) {
+		g_source_remove(vd->clcc_source);
+		vd->clcc_source = 0;
+	}
+
+	if (g_ril_send(vd->ril, RIL_REQUEST_GET_CURRENT_CALLS, NULL,
+				clcc_poll_cb, vc, NULL) > 0)
+		vd->clcc_pending = TRUE;
+}
+
+static void clcc_schedule(struct ofono_voicecall *vc)
+{
+	struct ril_voicecall_data *vd = ofono_voicecall_get_data(vc);
+	unsigned int interval;
+
+	if (vd->clcc_source || vd->clcc_pending)
+		return;
+
+	if (vd->clcc_fixed_poll) {
+		interval = POLL_CLCC_INTERVAL;
+	} else {
+		interval = vd->clcc_backoff;
+		vd->clcc_backoff = MIN(interval * 2, CLCC_BACKOFF_MAX_MS);
+	}
+
+	vd->clcc_source = g_timeout_add(interval, ril_poll_clcc, vc);
+}
 
 static void lastcause_cb(struct ril_msg *message, gpointer user_data)
 {
@@ -106,6 +159,38 @@ static void lastcause_cb(struct ril_msg *message, gpointer user_data)
 	ofono_voicecall_disconnected(vc, reqdata->id, reason, NULL);
 }
 
+static void dial_fail_cause_cb(struct ril_msg *message, gpointer user_data)
+{
+	struct cb_data *cbd = user_data;
+	struct ofono_voicecall *vc = cbd->user;
+	struct ril_voicecall_data *vd = ofono_voicecall_get_data(vc);
+	ofono_voicecall_cb_t cb = cbd->cb;
+
+	ofono_error("Dialed call never showed up, reason %d",
+			g_ril_reply_parse_call_fail_cause(vd->ril, message));
+
+	CALLBACK_WITH_FAILURE(cb, cbd->data);
+}
+
+/* Fails the pending dial, which also stops the polling for it */
+static void dial_timeout(struct ofono_voicecall *vc)
+{
+	struct ril_voicecall_data *vd = ofono_voicecall_get_data(vc);
+	ofono_voicecall_cb_t cb = vd->cb;
+	void *data = vd->data;
+	struct cb_data *cbd = cb_data_new(cb, data, vc);
+
+	vd->cb = NULL;
+	vd->data = NULL;
+
+	if (g_ril_send(vd->ril, RIL_REQUEST_LAST_CALL_FAIL_CAUSE, NULL,
+			dial_fail_cause_cb, cbd, g_free) > 0)
+		return;
+
+	g_free(cbd);
+	CALLBACK_WITH_FAILURE(cb, data);
+}
+
 static gboolean auto_answer_call(gpointer user_data)
 {
 	struct ofono_voicecall *vc = user_data;
@@ -156,6 +241,8 @@ static void clcc_poll_cb(struct ril_msg *message, gpointer user_data)
 	GSList *n, *o;
 	struct ofono_call *nc, *oc;
 
+	vd->clcc_pending = FALSE;
+
 	/*
 	 * We consider all calls have been dropped if there is no radio, which
 	 * happens, for instance, when flight mode is set whilst in a call.
@@ -164,7 +251,7 @@ static void clcc_poll_cb(struct ril_msg *message, gpointer user_data)
 			message->error != RIL_E_RADIO_NOT_AVAILABLE) {
 		ofono_error("We are polling CLCC and received an error");
 		ofono_error("All bets are off for call management");
-		return;
+		goto done;
 	}
 
 	calls = g_ril_reply_parse_get_calls(vd->ril, message);
@@ -275,6 +362,19 @@ static void clcc_poll_cb(struct ril_msg *message, gpointer user_data)
 
 	vd->calls = calls;
 	vd->local_release = 0;
+
+done:
+	/* Also on errors, else a dirty list or a pending dial is stranded */
+	if (vd->clcc_dirty) {
+		vd->clcc_dirty = FALSE;
+		clcc_request(vc);
+	} else if (vd->cb) {
+		/* Still waiting for the call we dialed, but not forever */
+		if (g_get_monotonic_time() < vd->dial_deadline)
+			clcc_schedule(vc);
+		else
+			dial_timeout(vc);
+	}
 }
 
 gboolean ril_poll_clcc(gpointer user_data)
@@ -282,10 +382,8 @@ gboolean ril_poll_clcc(gpointer user_data)
 	struct ofono_voicecall *vc = user_data;
 	struct ril_voicecall_data *vd = ofono_voicecall_get_data(vc);
 
-	g_ril_send(vd->ril, RIL_REQUEST_GET_CURRENT_CALLS, NULL,
-			clcc_poll_cb, vc, NULL);
-
 	vd->clcc_source = 0;
+	clcc_request(vc);
 
 	return FALSE;
 }
@@ -318,8 +416,7 @@ static void generic_cb(struct ril_msg *message, gpointer user_data)
 	}
 
 out:
-	g_ril_send(vd->ril, RIL_REQUEST_GET_CURRENT_CALLS, NULL,
-			clcc_poll_cb, req->vc, NULL);
+	clcc_request(req->vc);
 
 	/* We have to callback after we schedule a poll if required */
 	if (req->cb)
@@ -383,9 +480,11 @@ static void rild_cb(struct ril_msg *message, gpointer user_data)
 	 * UNSOL_RESPONSE_CALL_STATE_CHANGED has been issued and the CLCC
 	 * has been called already. So, there's no need to trigger another CLCC.
 	 */
-	if (!vd->clcc_source && vd->cb)
-		vd->clcc_source = g_timeout_add(POLL_CLCC_INTERVAL,
-						ril_poll_clcc, vc);
+	if (vd->cb) {
+		vd->clcc_backoff = CLCC_BACKOFF_MIN_MS;
+		clcc_schedule(vc);
+	}
+
 	return;
 
 out:
@@ -430,6 +529,8 @@ static void dial(struct ofono_voicecall *vc,
 		 */
 		vd->cb = cb;
 		vd->data = data;
+		vd->dial_deadline = g_get_monotonic_time() +
+					DIAL_TIMEOUT_S * G_USEC_PER_SEC;
 	}
 }
 
@@ -565,7 +666,8 @@ void ril_call_state_notify(struct ril_msg *message, gpointer user_data)
 	g_ril_print_unsol_no_args(vd->ril, message);
 
 	/* Just need to request the call list again */
-	ril_poll_clcc(vc);
+	vd->clcc_backoff = CLCC_BACKOFF_MIN_MS;
+	clcc_request(vc);
 
 	return;
 }
@@ -749,7 +851,7 @@ static gboolean ril_delayed_register(gpointer user_data)
 	ofono_voicecall_register(vc);
 
 	/* Initialize call list */
-	ril_poll_clcc(vc);
+	clcc_request(vc);
 
 	/* Unsol when call state changes */
 	g_ril_register(vd->ril, RIL_UNSOL_RESPONSE_CALL_STATE_CHANGED,
@@ -776,6 +878,11 @@ void ril_voicecall_start(struct ril_voicecall_driver_data *driver_data,
 	vd->vendor = vendor;
 	vd->cb = NULL;
 	vd->data = NULL;
+	vd->clcc_backoff = CLCC_BACKOFF_MIN_MS;
+
+	/* Legacy fixed interval polling, for rilds with late indications */
+	if (getenv("OFONO_RIL_CLCC_POLL"))
+		vd->clcc_fixed_poll = TRUE;
 
 	clear_dtmf_queue(vd);
 
@@ -24,12 +24,20 @@ struct ril_voicecall_data {
 	/* Call local hangup indicator, one bit per call (1 << call_id) */
 	unsigned int local_release;
 	unsigned int clcc_source;
+	/* GET_CURRENT_CALLS in flight, and whether to repeat it */
+	gboolean clcc_pending;
+	gboolean clcc_dirty;
+	/* Next poll interval while a dial is not yet in the call list */
+	unsigned int clcc_backoff;
+	gboolean clcc_fixed_poll;
 	GRil *ril;
 	struct ofono_modem *modem;
 	unsigned int vendor;
 	unsigned char flags;
 	ofono_voicecall_cb_t cb;
 	void *data;
+	/* When to give up on the dialed call showing in the call list */
+	gint64 dial_deadline;
 	gchar *tone_queue;
 	gboolean tone_pending;
 };
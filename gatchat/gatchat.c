@@ -35,12 +35,16 @@
 #include "ringbuffer.h"
 #include "gatchat.h"
 #include "gatio.h"
+#include "gatutil.h"
 
 /* #define WRITE_SCHEDULER_DEBUG 1 */
 
 #define COMMAND_FLAG_EXPECT_PDU			0x1
 #define COMMAND_FLAG_EXPECT_SHORT_PROMPT	0x2
 
+/* Larger response buffers are not kept for the next command */
+#define RESPONSE_BUF_KEEP 16384
+
 struct at_chat;
 static void chat_wakeup_writer(struct at_chat *chat);
 
@@ -70,9 +74,22 @@ struct at_notify_node {
 typedef gboolean (*node_remove_func)(struct at_notify_node *node,
 					gpointer user_data);
 
+/*
+ * Registered prefixes are indexed by a character trie, so matching a line
+ * costs its length rather than the number of registrations. Nodes are only
+ * freed with the chat, the hash table still owns the at_notify structures.
+ */
+struct at_notify_trie {
+	char c;
+	struct at_notify *notify;		/* Prefix ending here, if any */
+	struct at_notify_trie *child;		/* First longer prefix */
+	struct at_notify_trie *next;		/* Sibling, same length */
+};
+
 struct at_notify {
 	GSList *nodes;
 	gboolean pdu;
+	struct at_notify_trie *trie;
 };
 
 struct at_chat {
@@ -84,6 +101,7 @@ struct at_chat {
 	GQueue *command_queue;			/* Command queue */
 	guint cmd_bytes_written;		/* bytes written from cmd */
 	GHashTable *notify_list;		/* List of notification reg */
+	struct at_notify_trie notify_trie;	/* Prefix index of the list */
 	GAtDisconnectFunc user_disconnect;	/* user disconnect func */
 	gpointer user_disconnect_data;		/* user disconnect data */
 	guint read_so_far;			/* Number of bytes processed */
@@ -91,7 +109,10 @@ struct at_chat {
 	GAtDebugFunc debugf;			/* debugging output function */
 	gpointer debug_data;			/* Data to pass to debug func */
 	char *pdu_notify;			/* Unsolicited Resp w/ PDU */
-	GSList *response_lines;			/* char * lines of the response */
+	GString *line_buf;			/* Line being processed */
+	GString *response_buf;			/* Lines of the response */
+	GArray *response_offsets;		/* Line starts in response_buf */
+	GPtrArray *response_index;		/* Lines handed to callback */
 	char *wakeup;				/* command sent to wakeup modem */
 	gint timeout_source;
 	gdouble inactivity_time;		/* Period of inactivity */
@@ -147,10 +168,64 @@ static void at_notify_node_destroy(gpointer data, gpointer user_data)
 	g_free(node);
 }
 
+static struct at_notify_trie *at_notify_trie_child(
+					const struct at_notify_trie *node,
+					char c)
+{
+	struct at_notify_trie *child;
+
+	for (child = node->child; child; child = child->next)
+		if (child->c == c)
+			break;
+
+	return child;
+}
+
+static struct at_notify_trie *at_notify_trie_insert(
+					struct at_notify_trie *root,
+					const char *prefix)
+{
+	struct at_notify_trie *node = root;
+	struct at_notify_trie *child;
+
+	for (; *prefix; prefix++) {
+		child = at_notify_trie_child(node, *prefix);
+
+		if (child == NULL) {
+			child = g_try_new0(struct at_notify_trie, 1);
+			if (child == NULL)
+				return NULL;
+
+			child->c = *prefix;
+			child->next = node->child;
+			node->child = child;
+		}
+
+		node = child;
+	}
+
+	return node;
+}
+
+static void at_notify_trie_free(struct at_notify_trie *node)
+{
+	struct at_notify_trie *next;
+
+	while (node) {
+		next = node->next;
+		at_notify_trie_free(node->child);
+		g_free(node);
+		node = next;
+	}
+}
+
 static void at_notify_destroy(gpointer user_data)
 {
 	struct at_notify *notify = user_data;
 
+	if (notify->trie)
+		notify->trie->notify = NULL;
+
 	g_slist_foreach(notify->nodes, at_notify_node_destroy, NULL);
 	g_slist_free(notify->nodes);
 	g_free(notify);
@@ -313,6 +388,29 @@ static void free_terminator(struct terminator_info *info)
 	info = NULL;
 }
 
+/*
+ * The line buffers and the prefix trie outlive chat_cleanup(), a read
+ * handler may still be walking them when the chat is destroyed.
+ */
+static void chat_free(struct at_chat *chat)
+{
+	at_notify_trie_free(chat->notify_trie.child);
+
+	if (chat->line_buf)
+		g_string_free(chat->line_buf, TRUE);
+
+	if (chat->response_buf)
+		g_string_free(chat->response_buf, TRUE);
+
+	if (chat->response_offsets)
+		g_array_free(chat->response_offsets, TRUE);
+
+	if (chat->response_index)
+		g_ptr_array_free(chat->response_index, TRUE);
+
+	g_free(chat);
+}
+
 static void chat_cleanup(struct at_chat *chat)
 {
 	struct at_command *c;
@@ -325,9 +423,7 @@ static void chat_cleanup(struct at_chat *chat)
 	chat->command_queue = NULL;
 
 	/* Cleanup any response lines we have pending */
-	g_slist_foreach(chat->response_lines, (GFunc)g_free, NULL);
-	g_slist_free(chat->response_lines);
-	chat->response_lines = NULL;
+	g_array_set_size(chat->response_offsets, 0);
 
 	/* Cleanup registered notifications */
 	g_hash_table_destroy(chat->notify_list);
@@ -386,26 +482,30 @@ static void at_notify_call_callback(gpointer data, gpointer user_data)
 
 static gboolean at_chat_match_notify(struct at_chat *chat, char *line)
 {
-	GHashTableIter iter;
+	struct at_notify_trie *node = &chat->notify_trie;
 	struct at_notify *notify;
-	gpointer key, value;
 	gboolean ret = FALSE;
 	GAtResult result;
+	char *lines[] = { line, NULL };
+	const char *c;
 
-	g_hash_table_iter_init(&iter, chat->notify_list);
-	result.lines = 0;
+	result.lines = lines;
 	result.final_or_pdu = 0;
 
 	chat->in_notify = TRUE;
 
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		notify = value;
+	/* Every node on the path of the line is a matching prefix */
+	for (c = line; *c; c++) {
+		node = at_notify_trie_child(node, *c);
+		if (node == NULL)
+			break;
 
-		if (!g_str_has_prefix(line, key))
+		notify = node->notify;
+		if (notify == NULL)
 			continue;
 
 		if (notify->pdu) {
-			chat->pdu_notify = line;
+			chat->pdu_notify = g_strdup(line);
 
 			if (chat->syntax->set_hint)
 				chat->syntax->set_hint(chat->syntax,
@@ -413,9 +513,6 @@ static gboolean at_chat_match_notify(struct at_chat *chat, char *line)
 			return TRUE;
 		}
 
-		if (result.lines == NULL)
-			result.lines = g_slist_prepend(NULL, line);
-
 		g_slist_foreach(notify->nodes, at_notify_call_callback,
 					&result);
 		ret = TRUE;
@@ -423,20 +520,52 @@ static gboolean at_chat_match_notify(struct at_chat *chat, char *line)
 
 	chat->in_notify = FALSE;
 
-	if (ret) {
-		g_slist_free(result.lines);
-		g_free(line);
-
+	if (ret)
 		at_chat_unregister_all(chat, FALSE, node_is_destroyed, NULL);
-	}
 
 	return ret;
 }
 
+static void at_chat_add_response_line(struct at_chat *p, const char *line)
+{
+	gsize offset;
+
+	/* First line of a response, what is left belongs to the last one */
+	if (p->response_offsets->len == 0) {
+		if (p->response_buf->allocated_len > RESPONSE_BUF_KEEP) {
+			g_string_free(p->response_buf, TRUE);
+			p->response_buf = g_string_sized_new(0);
+		} else
+			g_string_truncate(p->response_buf, 0);
+	}
+
+	offset = p->response_buf->len;
+
+	/* Keep the terminating NUL, lines are handed out in place */
+	g_string_append_len(p->response_buf, line, strlen(line) + 1);
+	g_array_append_val(p->response_offsets, offset);
+}
+
+static char **at_chat_response_lines(struct at_chat *p)
+{
+	GPtrArray *index = p->response_index;
+	guint i;
+
+	g_ptr_array_set_size(index, 0);
+
+	for (i = 0; i < p->response_offsets->len; i++)
+		g_ptr_array_add(index, p->response_buf->str +
+				g_array_index(p->response_offsets, gsize, i));
+
+	g_ptr_array_add(index, NULL);
+
+	return (char **) index->pdata;
+}
+
 static void at_chat_finish_command(struct at_chat *p, gboolean ok, char *final)
 {
 	struct at_command *cmd = g_queue_pop_head(p->command_queue);
-	GSList *response_lines;
+	char **lines;
 
 	/* Cannot happen, but lets be paranoid */
 	if (cmd == NULL)
@@ -447,24 +576,22 @@ static void at_chat_finish_command(struct at_chat *p, gboolean ok, char *final)
 	if (g_queue_peek_head(p->command_queue))
 		chat_wakeup_writer(p);
 
-	response_lines = p->response_lines;
-	p->response_lines = NULL;
+	/*
+	 * The lines stay in response_buf until the next response starts, the
+	 * callback might destroy the chat so it is not touched afterwards.
+	 */
+	lines = at_chat_response_lines(p);
+	g_array_set_size(p->response_offsets, 0);
 
 	if (cmd->callback) {
 		GAtResult result;
 
-		response_lines = g_slist_reverse(response_lines);
-
 		result.final_or_pdu = final;
-		result.lines = response_lines;
+		result.lines = lines;
 
 		cmd->callback(ok, &result, cmd->user_data);
 	}
 
-	g_slist_foreach(response_lines, (GFunc)g_free, NULL);
-	g_slist_free(response_lines);
-
-	g_free(final);
 	at_command_destroy(cmd);
 }
 
@@ -554,22 +681,20 @@ out:
 		p->syntax->set_hint(p->syntax, hint);
 
 	if (cmd->listing && (cmd->flags & COMMAND_FLAG_EXPECT_PDU)) {
-		p->pdu_notify = line;
+		p->pdu_notify = g_strdup(line);
 		return TRUE;
 	}
 
 	if (cmd->listing) {
 		GAtResult result;
+		char *lines[] = { line, NULL };
 
-		result.lines = g_slist_prepend(NULL, line);
+		result.lines = lines;
 		result.final_or_pdu = NULL;
 
 		cmd->listing(&result, cmd->user_data);
-
-		g_slist_free(result.lines);
-		g_free(line);
 	} else
-		p->response_lines = g_slist_prepend(p->response_lines, line);
+		at_chat_add_response_line(p, line);
 
 	return TRUE;
 }
@@ -584,7 +709,7 @@ static void have_line(struct at_chat *p, char *str)
 
 	/* Check for echo, this should not happen, but lets be paranoid */
 	if (!strncmp(str, "AT", 2))
-		goto done;
+		return;
 
 	cmd = g_queue_peek_head(p->command_queue);
 
@@ -604,34 +729,26 @@ static void have_line(struct at_chat *p, char *str)
 			return;
 	}
 
-	if (at_chat_match_notify(p, str) == TRUE)
-		return;
-
-done:
-	/* No matches & no commands active, ignore line */
-	g_free(str);
+	/* No matches & no commands active, the line is ignored */
+	at_chat_match_notify(p, str);
 }
 
 static void have_notify_pdu(struct at_chat *p, char *pdu, GAtResult *result)
 {
-	GHashTableIter iter;
+	struct at_notify_trie *node = &p->notify_trie;
 	struct at_notify *notify;
-	char *prefix;
-	gpointer key, value;
 	gboolean called = FALSE;
+	const char *c;
 
 	p->in_notify = TRUE;
 
-	g_hash_table_iter_init(&iter, p->notify_list);
-
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		prefix = key;
-		notify = value;
-
-		if (!g_str_has_prefix(p->pdu_notify, prefix))
-			continue;
+	for (c = p->pdu_notify; *c; c++) {
+		node = at_notify_trie_child(node, *c);
+		if (node == NULL)
+			break;
 
-		if (!notify->pdu)
+		notify = node->notify;
+		if (notify == NULL || !notify->pdu)
 			continue;
 
 		g_slist_foreach(notify->nodes, at_notify_call_callback, result);
@@ -648,12 +765,13 @@ static void have_pdu(struct at_chat *p, char *pdu)
 {
 	struct at_command *cmd;
 	GAtResult result;
+	char *lines[] = { p->pdu_notify, NULL };
 	gboolean listing_pdu = FALSE;
 
 	if (pdu == NULL)
 		goto error;
 
-	result.lines = g_slist_prepend(NULL, p->pdu_notify);
+	result.lines = lines;
 	result.final_or_pdu = pdu;
 
 	cmd = g_queue_peek_head(p->command_queue);
@@ -675,59 +793,57 @@ static void have_pdu(struct at_chat *p, char *pdu)
 	} else
 		have_notify_pdu(p, pdu, &result);
 
-	g_slist_free(result.lines);
-
 error:
 	g_free(p->pdu_notify);
 	p->pdu_notify = NULL;
-
-	if (pdu)
-		g_free(pdu);
 }
 
 static char *extract_line(struct at_chat *p, struct ring_buffer *rbuf)
 {
 	unsigned int wrap = ring_buffer_len_no_wrap(rbuf);
 	unsigned int pos = 0;
-	unsigned char *buf = ring_buffer_read_ptr(rbuf, pos);
+	unsigned int end;
+	const char *buf;
 	gboolean in_string = FALSE;
 	int strip_front = 0;
 	int line_length = 0;
-	char *line;
+	gsize skip;
 
 	while (pos < p->read_so_far) {
-		if (in_string == FALSE && (*buf == '\r' || *buf == '\n')) {
-			if (!line_length)
-				strip_front += 1;
-			else
-				break;
-		} else {
-			if (*buf == '"')
-				in_string = !in_string;
+		end = pos < wrap ? MIN(wrap, p->read_so_far) : p->read_so_far;
+		buf = (const char *) ring_buffer_read_ptr(rbuf, pos);
+
+		/* Everything up to the next quote or line break is content */
+		if (in_string)
+			skip = g_at_util_scan(buf, end - pos, '"', '"', '"');
+		else
+			skip = g_at_util_scan(buf, end - pos, '\r', '\n', '"');
+
+		line_length += skip;
+		pos += skip;
+
+		if (pos == end)
+			continue;
 
+		if (buf[skip] == '"') {
+			in_string = !in_string;
 			line_length += 1;
-		}
+		} else if (!line_length)
+			strip_front += 1;
+		else
+			break;
 
-		buf += 1;
 		pos += 1;
-
-		if (pos == wrap)
-			buf = ring_buffer_read_ptr(rbuf, pos);
 	}
 
-	line = g_try_new(char, line_length + 1);
-	if (line == NULL) {
-		ring_buffer_drain(rbuf, p->read_so_far);
-		return NULL;
-	}
+	/* The buffer is reused, lines are only valid until the next one */
+	g_string_set_size(p->line_buf, line_length);
 
 	ring_buffer_drain(rbuf, strip_front);
-	ring_buffer_read(rbuf, line, line_length);
+	ring_buffer_read(rbuf, p->line_buf->str, line_length);
 	ring_buffer_drain(rbuf, p->read_so_far - strip_front - line_length);
 
-	line[line_length] = '\0';
-
-	return line;
+	return p->line_buf->str;
 }
 
 static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
@@ -784,7 +900,7 @@ static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
 	p->in_read_handler = FALSE;
 
 	if (p->destroyed)
-		g_free(p);
+		chat_free(p);
 }
 
 static void wakeup_cb(gboolean ok, GAtResult *result, gpointer user_data)
@@ -980,7 +1096,7 @@ static void at_chat_unref(struct at_chat *chat)
 	if (chat->in_read_handler)
 		chat->destroyed = TRUE;
 	else
-		g_free(chat);
+		chat_free(chat);
 }
 
 static gboolean at_chat_set_disconnect_function(struct at_chat *chat,
@@ -1055,8 +1171,13 @@ static struct at_notify *at_notify_create(struct at_chat *chat,
 						gboolean pdu)
 {
 	struct at_notify *notify;
+	struct at_notify_trie *node;
 	char *key;
 
+	node = at_notify_trie_insert(&chat->notify_trie, prefix);
+	if (node == NULL)
+		return 0;
+
 	key = g_strdup(prefix);
 	if (key == NULL)
 		return 0;
@@ -1068,6 +1189,8 @@ static struct at_notify *at_notify_create(struct at_chat *chat,
 	}
 
 	notify->pdu = pdu;
+	notify->trie = node;
+	node->notify = notify;
 
 	g_hash_table_insert(chat->notify_list, key, notify);
 
@@ -1291,6 +1414,11 @@ static struct at_chat *create_chat(GIOChannel *channel, GIOFlags flags,
 	chat->notify_list = g_hash_table_new_full(g_str_hash, g_str_equal,
 						g_free, at_notify_destroy);
 
+	chat->line_buf = g_string_sized_new(0);
+	chat->response_buf = g_string_sized_new(0);
+	chat->response_offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+	chat->response_index = g_ptr_array_new();
+
 	g_at_io_set_read_handler(chat->io, new_bytes, chat);
 
 	chat->syntax = g_at_syntax_ref(syntax);
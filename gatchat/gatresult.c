@@ -33,9 +33,8 @@
 void g_at_result_iter_init(GAtResultIter *iter, GAtResult *result)
 {
 	iter->result = result;
-	iter->pre.next = result->lines;
-	iter->pre.data = NULL;
-	iter->l = &iter->pre;
+	iter->line = NULL;
+	iter->next_line = 0;
 	iter->line_pos = 0;
 }
 
@@ -45,8 +44,11 @@ gboolean g_at_result_iter_next(GAtResultIter *iter, const char *prefix)
 	int prefix_len = prefix ? strlen(prefix) : 0;
 	int linelen;
 
-	while ((iter->l = iter->l->next)) {
-		line = iter->l->data;
+	if (iter->result->lines == NULL)
+		return FALSE;
+
+	while ((line = iter->result->lines[iter->next_line])) {
+		iter->next_line += 1;
 		linelen = strlen(line);
 
 		if (linelen > G_AT_RESULT_LINE_LENGTH_MAX)
@@ -69,9 +71,13 @@ gboolean g_at_result_iter_next(GAtResultIter *iter, const char *prefix)
 		goto out;
 	}
 
+	iter->line = NULL;
+
 	return FALSE;
 
 out:
+	iter->line = line;
+
 	/* Already checked the length to be no more than buflen */
 	strcpy(iter->buf, line);
 	return TRUE;
@@ -84,10 +90,10 @@ const char *g_at_result_iter_raw_line(GAtResultIter *iter)
 	if (iter == NULL)
 		return NULL;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return NULL;
 
-	line = iter->l->data;
+	line = iter->line;
 
 	line += iter->line_pos;
 
@@ -116,10 +122,10 @@ gboolean g_at_result_iter_next_unquoted_string(GAtResultIter *iter,
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	pos = iter->line_pos;
@@ -160,10 +166,10 @@ gboolean g_at_result_iter_next_string(GAtResultIter *iter, const char **str)
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	pos = iter->line_pos;
@@ -212,10 +218,10 @@ gboolean g_at_result_iter_next_hexstring(GAtResultIter *iter,
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	pos = iter->line_pos;
@@ -267,10 +273,10 @@ gboolean g_at_result_iter_next_number(GAtResultIter *iter, gint *number)
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	pos = iter->line_pos;
@@ -302,10 +308,10 @@ gboolean g_at_result_iter_next_number_default(GAtResultIter *iter, gint dflt,
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	pos = skip_to_next_field(line, iter->line_pos, len);
@@ -334,10 +340,10 @@ gboolean g_at_result_iter_next_range(GAtResultIter *iter, gint *min, gint *max)
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	pos = iter->line_pos;
@@ -424,10 +430,10 @@ gboolean g_at_result_iter_skip_next(GAtResultIter *iter)
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 
 	skipped_to = skip_until(line, iter->line_pos, ',');
 
@@ -447,10 +453,10 @@ gboolean g_at_result_iter_open_list(GAtResultIter *iter)
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	if (iter->line_pos >= len)
@@ -476,10 +482,10 @@ gboolean g_at_result_iter_close_list(GAtResultIter *iter)
 	if (iter == NULL)
 		return FALSE;
 
-	if (iter->l == NULL)
+	if (iter->line == NULL)
 		return FALSE;
 
-	line = iter->l->data;
+	line = iter->line;
 	len = strlen(line);
 
 	if (iter->line_pos >= len)
@@ -519,5 +525,5 @@ gint g_at_result_num_response_lines(GAtResult *result)
 	if (result->lines == NULL)
 		return 0;
 
-	return g_slist_length(result->lines);
+	return g_strv_length(result->lines);
 }
@@ -27,7 +27,7 @@ extern "C" {
 #endif
 
 struct _GAtResult {
-	GSList *lines;
+	char **lines;		/* NULL terminated, borrowed from the chat */
 	char *final_or_pdu;
 };
 
@@ -37,10 +37,10 @@ typedef struct _GAtResult GAtResult;
 
 struct _GAtResultIter {
 	GAtResult *result;
-	GSList *l;
+	char *line;
+	unsigned int next_line;
 	char buf[G_AT_RESULT_LINE_LENGTH_MAX + 1];
 	unsigned int line_pos;
-	GSList pre;
 };
 
 typedef struct _GAtResultIter GAtResultIter;
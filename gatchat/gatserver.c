@@ -590,6 +590,7 @@ static void at_command_notify(GAtServer *server, char *command,
 {
 	struct at_command *node;
 	GAtResult result;
+	char *lines[] = { command, NULL };
 
 	node = g_hash_table_lookup(server->command_list, prefix);
 
@@ -598,12 +599,10 @@ static void at_command_notify(GAtServer *server, char *command,
 		return;
 	}
 
-	result.lines = g_slist_prepend(NULL, command);
+	result.lines = lines;
 	result.final_or_pdu = 0;
 
 	node->notify(server, type, &result, node->user_data);
-
-	g_slist_free(result.lines);
 }
 
 static unsigned int parse_extended_command(GAtServer *server, char *buf)
@@ -26,6 +26,7 @@
 #include <glib.h>
 
 #include "gatsyntax.h"
+#include "gatutil.h"
 
 enum GSMV1_STATE {
 	GSMV1_STATE_IDLE = 0,
@@ -116,16 +117,28 @@ static GAtSyntaxResult gsmv1_feed(GAtSyntax *syntax,
 				syntax->state = GSMV1_STATE_RESPONSE;
 			break;
 
+		/*
+		 * States waiting for a few given bytes skip everything else
+		 * in bulk, if none is found all the input is consumed.
+		 */
 		case GSMV1_STATE_RESPONSE:
-			if (byte == '\r')
+			i += g_at_util_scan(bytes + i, *len - i,
+						'\r', '"', '"');
+			if (i == *len)
+				goto out;
+
+			if (bytes[i] == '\r')
 				syntax->state = GSMV1_STATE_TERMINATOR_CR;
-			else if (byte == '"')
+			else
 				syntax->state = GSMV1_STATE_RESPONSE_STRING;
 			break;
 
 		case GSMV1_STATE_RESPONSE_STRING:
-			if (byte == '"')
-				syntax->state = GSMV1_STATE_RESPONSE;
+			i += g_at_util_scan(bytes + i, *len - i, '"', '"', '"');
+			if (i == *len)
+				goto out;
+
+			syntax->state = GSMV1_STATE_RESPONSE;
 			break;
 
 		case GSMV1_STATE_TERMINATOR_CR:
@@ -147,8 +160,12 @@ static GAtSyntaxResult gsmv1_feed(GAtSyntax *syntax,
 			break;
 
 		case GSMV1_STATE_MULTILINE_RESPONSE:
-			if (byte == '\r')
-				syntax->state = GSMV1_STATE_MULTILINE_TERMINATOR_CR;
+			i += g_at_util_scan(bytes + i, *len - i,
+						'\r', '\r', '\r');
+			if (i == *len)
+				goto out;
+
+			syntax->state = GSMV1_STATE_MULTILINE_TERMINATOR_CR;
 			break;
 
 		case GSMV1_STATE_MULTILINE_TERMINATOR_CR:
@@ -184,8 +201,12 @@ static GAtSyntaxResult gsmv1_feed(GAtSyntax *syntax,
 			goto out;
 
 		case GSMV1_STATE_PDU:
-			if (byte == '\r')
-				syntax->state = GSMV1_STATE_PDU_CR;
+			i += g_at_util_scan(bytes + i, *len - i,
+						'\r', '\r', '\r');
+			if (i == *len)
+				goto out;
+
+			syntax->state = GSMV1_STATE_PDU_CR;
 			break;
 
 		case GSMV1_STATE_PDU_CR:
@@ -294,21 +315,30 @@ static GAtSyntaxResult gsm_permissive_feed(GAtSyntax *syntax,
 				syntax->state = GSM_PERMISSIVE_STATE_RESPONSE;
 			break;
 
+		/* See gsmv1_feed, these states skip in bulk as well */
 		case GSM_PERMISSIVE_STATE_RESPONSE:
-			if (byte == '\r') {
+			i += g_at_util_scan(bytes + i, *len - i,
+						'\r', '"', '"');
+			if (i == *len)
+				goto out;
+
+			if (bytes[i] == '\r') {
 				syntax->state = GSM_PERMISSIVE_STATE_IDLE;
 
 				i += 1;
 				res = G_AT_SYNTAX_RESULT_LINE;
 				goto out;
-			} else if (byte == '"')
-				syntax->state =
-					GSM_PERMISSIVE_STATE_RESPONSE_STRING;
+			}
+
+			syntax->state = GSM_PERMISSIVE_STATE_RESPONSE_STRING;
 			break;
 
 		case GSM_PERMISSIVE_STATE_RESPONSE_STRING:
-			if (byte == '"')
-				syntax->state = GSM_PERMISSIVE_STATE_RESPONSE;
+			i += g_at_util_scan(bytes + i, *len - i, '"', '"', '"');
+			if (i == *len)
+				goto out;
+
+			syntax->state = GSM_PERMISSIVE_STATE_RESPONSE;
 			break;
 
 		case GSM_PERMISSIVE_STATE_GUESS_PDU:
@@ -317,14 +347,16 @@ static GAtSyntaxResult gsm_permissive_feed(GAtSyntax *syntax,
 			break;
 
 		case GSM_PERMISSIVE_STATE_PDU:
-			if (byte == '\r') {
-				syntax->state = GSM_PERMISSIVE_STATE_IDLE;
-
-				i += 1;
-				res = G_AT_SYNTAX_RESULT_PDU;
+			i += g_at_util_scan(bytes + i, *len - i,
+						'\r', '\r', '\r');
+			if (i == *len)
 				goto out;
-			}
-			break;
+
+			syntax->state = GSM_PERMISSIVE_STATE_IDLE;
+
+			i += 1;
+			res = G_AT_SYNTAX_RESULT_PDU;
+			goto out;
 
 		case GSM_PERMISSIVE_STATE_PROMPT:
 			if (byte == ' ') {
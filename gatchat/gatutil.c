@@ -198,3 +198,45 @@ gboolean g_at_util_setup_io(GIOChannel *io, GIOFlags flags)
 
 	return TRUE;
 }
+
+#define SCAN_ONES ((gulong) -1 / 0xff)
+#define SCAN_HIGHS (SCAN_ONES * 0x80)
+#define SCAN_HAS_ZERO(v) (((v) - SCAN_ONES) & ~(v) & SCAN_HIGHS)
+
+/*
+ * Returns the offset of the first c1, c2 or c3 in buf, or len if there is
+ * none. Repeat a character to look for fewer of them. Runs without any of
+ * them are skipped a word at a time, which is what matters for long
+ * listings where the interesting bytes are far apart.
+ */
+gsize g_at_util_scan(const char *buf, gsize len, char c1, char c2, char c3)
+{
+	gulong m1 = SCAN_ONES * (guchar) c1;
+	gulong m2 = SCAN_ONES * (guchar) c2;
+	gulong m3 = SCAN_ONES * (guchar) c3;
+	gsize i = 0;
+
+	if (c1 == c2 && c1 == c3) {
+		const char *p = memchr(buf, c1, len);
+
+		return p ? (gsize) (p - buf) : len;
+	}
+
+	while (i + sizeof(gulong) <= len) {
+		gulong word;
+
+		memcpy(&word, buf + i, sizeof(word));
+
+		if (SCAN_HAS_ZERO(word ^ m1) || SCAN_HAS_ZERO(word ^ m2) ||
+				SCAN_HAS_ZERO(word ^ m3))
+			break;
+
+		i += sizeof(word);
+	}
+
+	for (; i < len; i++)
+		if (buf[i] == c1 || buf[i] == c2 || buf[i] == c3)
+			return i;
+
+	return len;
+}
@@ -39,6 +39,8 @@ void g_at_util_debug_hexdump(gboolean in, const unsigned char *buf, gsize len,
 
 gboolean g_at_util_setup_io(GIOChannel *io, GIOFlags flags);
 
+gsize g_at_util_scan(const char *buf, gsize len, char c1, char c2, char c3);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,199 @@
+/*
+ *
+ *  RIL library with GLib integration
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN(s) (((s) + 7) & ~(gsize) 7)
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	gsize size;
+	gsize used;
+	/* Keeps data 8-byte aligned on 32-bit too */
+	guint64 data[];
+};
+
+struct arena {
+	struct arena_chunk *chunks;
+	gsize chunk_size;
+};
+
+static struct arena_chunk *arena_chunk_new(struct arena *arena, gsize size)
+{
+	struct arena_chunk *chunk;
+
+	chunk = g_malloc0(sizeof(*chunk) + size);
+	chunk->size = size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+
+	return chunk;
+}
+
+struct arena *arena_new(gsize chunk_size)
+{
+	struct arena *arena = g_new0(struct arena, 1);
+
+	arena->chunk_size = ARENA_ALIGN(MAX(chunk_size, 64));
+	arena_chunk_new(arena, arena->chunk_size);
+
+	return arena;
+}
+
+void arena_free(struct arena *arena)
+{
+	struct arena_chunk *chunk, *next;
+
+	if (arena == NULL)
+		return;
+
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		g_free(chunk);
+	}
+
+	g_free(arena);
+}
+
+gpointer arena_alloc0(struct arena *arena, gsize size)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	gpointer ret;
+
+	size = ARENA_ALIGN(MAX(size, 1));
+
+	if (chunk->size - chunk->used < size) {
+		/* Big blocks get their own chunk, behind the current one */
+		if (size > arena->chunk_size / 2) {
+			chunk = g_malloc0(sizeof(*chunk) + size);
+			chunk->size = size;
+			chunk->used = size;
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+
+			return chunk->data;
+		}
+
+		chunk = arena_chunk_new(arena, arena->chunk_size);
+	}
+
+	/* Chunks are zeroed when allocated and never reused */
+	ret = (char *) chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ret;
+}
+
+char *arena_strndup(struct arena *arena, const char *str, gsize n)
+{
+	char *ret;
+
+	if (str == NULL)
+		return NULL;
+
+	ret = arena_alloc0(arena, n + 1);
+	memcpy(ret, str, n);
+
+	return ret;
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+	if (str == NULL)
+		return NULL;
+
+	return arena_strndup(arena, str, strlen(str));
+}
+
+/* Like g_strsplit() with a single character delimiter */
+char **arena_strsplit(struct arena *arena, const char *str,
+			char delimiter, int max_tokens)
+{
+	const char *s, *next;
+	char **ret;
+	int n = 1;
+	int i;
+
+	if (max_tokens < 1)
+		max_tokens = G_MAXINT;
+
+	for (s = str; *s != '\0' && n < max_tokens; s++)
+		if (*s == delimiter)
+			n++;
+
+	ret = arena_alloc0(arena, (n + 1) * sizeof(char *));
+
+	if (*str == '\0')
+		return ret;
+
+	for (s = str, i = 0; i < n - 1; i++) {
+		next = strchr(s, delimiter);
+		ret[i] = arena_strndup(arena, s, next - s);
+		s = next + 1;
+	}
+
+	ret[i] = arena_strdup(arena, s);
+
+	return ret;
+}
+
+GSList *arena_slist_append(struct arena *arena, GSList *list,
+				gpointer data)
+{
+	GSList *node = arena_new0(arena, GSList);
+	GSList *last;
+
+	node->data = data;
+
+	if (list == NULL)
+		return node;
+
+	for (last = list; last->next; last = last->next)
+		;
+
+	last->next = node;
+
+	return list;
+}
+
+GSList *arena_slist_insert_sorted(struct arena *arena, GSList *list,
+					gpointer data, GCompareFunc func)
+{
+	GSList *node = arena_new0(arena, GSList);
+	GSList **link = &list;
+
+	node->data = data;
+
+	/* Equal elements keep their order, as with g_slist_insert_sorted */
+	while (*link && func(data, (*link)->data) > 0)
+		link = &(*link)->next;
+
+	node->next = *link;
+	*link = node;
+
+	return list;
+}
@@ -0,0 +1,58 @@
+/*
+ *
+ *  RIL library with GLib integration
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bump allocator for parsed replies: everything allocated from an arena
+ * is released at once by arena_free(), individual blocks are never
+ * freed.  GSList nodes allocated here must not be passed to g_slist_*
+ * functions that free or allocate nodes.
+ */
+struct arena;
+
+struct arena *arena_new(gsize chunk_size);
+void arena_free(struct arena *arena);
+
+gpointer arena_alloc0(struct arena *arena, gsize size);
+char *arena_strdup(struct arena *arena, const char *str);
+char *arena_strndup(struct arena *arena, const char *str, gsize n);
+char **arena_strsplit(struct arena *arena, const char *str,
+			char delimiter, int max_tokens);
+
+GSList *arena_slist_append(struct arena *arena, GSList *list,
+				gpointer data);
+GSList *arena_slist_insert_sorted(struct arena *arena, GSList *list,
+					gpointer data, GCompareFunc func);
+
+#define arena_new0(arena, type) \
+	((type *) arena_alloc0((arena), sizeof(type)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ARENA_H */
@@ -27,11 +27,13 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <netinet/in.h>
 #include <unistd.h>
@@ -51,6 +53,26 @@
 #define COMMAND_FLAG_EXPECT_PDU			0x1
 #define COMMAND_FLAG_EXPECT_SHORT_PROMPT	0x2
 
+/* Limits on the number of requests and bytes written per wakeup */
+#define RIL_MAX_WRITE_BATCH 16
+#define RIL_MAX_WRITE_BYTES GRIL_BUFFER_SIZE
+
+/*
+ * Requests are timed out on a timer wheel of RIL_WHEEL_SLOTS one-second
+ * slots, driven by a single timeout source that only runs while there
+ * are requests in flight.
+ */
+#define RIL_WHEEL_SLOTS 64
+#define RIL_DEFAULT_TIMEOUT 60
+#define RIL_LONG_TIMEOUT_FACTOR 5
+
+/* Upper bound for a single record, larger ones are dropped */
+#define RIL_MAX_RECORD_SIZE (1024 * 1024)
+
+/* Backoff while waiting for a restarted rild, milliseconds */
+#define RIL_RECONNECT_MIN_MS 100
+#define RIL_RECONNECT_MAX_MS 1600
+
 #define	RADIO_GID 1001
 #define	RADIO_UID 1001
 
@@ -63,11 +85,36 @@ struct ril_request {
 	GRilResponseFunc callback;
 	gpointer user_data;
 	GDestroyNotify notify;
+	enum g_ril_priority priority;
+	struct ril_tx_group *group;		/* Set until picked for writing */
+	GList *link;				/* Node in group or cmd queue */
+	gboolean sent;				/* Written, at least partly */
+	guint expires;				/* Timer wheel tick of expiry */
+	GList *wheel_link;			/* Node in timer wheel slot */
+	gint64 enqueue_time;			/* When g_ril_send was called */
+	gint64 write_time;			/* When fully written */
+};
+
+/*
+ * Unsent requests of one GRil instance at one priority.  Groups of the
+ * same priority are served round-robin, so one atom can not starve the
+ * others sharing the socket.
+ */
+struct ril_tx_group {
+	guint gid;
+	enum g_ril_priority priority;
+	GQueue requests;
 };
 
+#define TX_GROUP_KEY(gid, prio) \
+	GUINT_TO_POINTER((gid) * G_RIL_PRIORITY_LAST + (prio))
+
+struct ril_notify;
+
 struct ril_notify_node {
 	guint id;
 	guint gid;
+	struct ril_notify *notify;
 	GRilNotifyFunc callback;
 	gpointer user_data;
 	gboolean destroyed;
@@ -76,8 +123,37 @@ struct ril_notify_node {
 typedef gboolean (*node_remove_func)(struct ril_notify_node *node,
 					gpointer user_data);
 
+/*
+ * Nodes are kept in registration order.  Nodes unregistered while
+ * notifying are only marked, and the array is compacted once the
+ * notification is over.
+ */
 struct ril_notify {
-	GSList *nodes;
+	int req;
+	GPtrArray *nodes;
+	guint destroyed;			/* Nodes marked for removal */
+};
+
+/*
+ * Latest-value-wins unsolicited event.  The first event of a burst is
+ * delivered right away, later ones within the window only replace the
+ * held message, which is delivered when the window closes.
+ */
+struct ril_coalesce {
+	struct ril_s *ril;
+	int req;
+	guint window;				/* Milliseconds, 0 disabled */
+	guint source;				/* Window timer */
+	gboolean held;				/* Message waiting for window */
+	struct ril_msg message;
+	gsize buf_size;
+};
+
+struct ril_trace_ring {
+	struct ril_trace_entry *entries;
+	guint size;				/* Entries in the ring */
+	guint next;				/* Next entry to be written */
+	guint count;				/* Entries recorded so far */
 };
 
 struct ril_s {
@@ -86,17 +162,29 @@ struct ril_s {
 	guint next_notify_id;			/* Next notify id */
 	guint next_gid;				/* Next group id */
 	GRilIO *io;				/* GRil IO */
-	GQueue *command_queue;			/* Command queue */
-	GQueue *out_queue;			/* Commands sent/been sent */
+	GQueue *command_queue;			/* Requests being written */
+	GHashTable *tx_groups;			/* Unsent requests per group */
+	GQueue tx_ready[G_RIL_PRIORITY_LAST];	/* Round-robin of tx_groups */
+	guint tx_queued;			/* Number of unsent requests */
+	GHashTable *pending;			/* Requests indexed by serial */
 	guint req_bytes_written;		/* bytes written from req */
-	GHashTable *notify_list;		/* List of notification reg */
+	GHashTable *notify_list;		/* Notifications by event */
+	GHashTable *notify_nodes;		/* Notification nodes by id */
+	GSList *notify_dirty;			/* Events with marked nodes */
+	GHashTable *coalesce;			/* Coalesced events */
 	GRilDisconnectFunc user_disconnect;	/* user disconnect func */
 	gpointer user_disconnect_data;		/* user disconnect data */
-	guint read_so_far;			/* Number of bytes processed */
 	gboolean suspended;			/* Are we suspended? */
 	gboolean debug;
 	gboolean trace;
-	gint timeout_source;
+	gint timeout_source;			/* Timer wheel tick source */
+	GQueue wheel[RIL_WHEEL_SLOTS];		/* Requests by expiry tick */
+	guint wheel_tick;			/* Current timer wheel tick */
+	guint wheel_count;			/* Requests on the wheel */
+	guint timeout;				/* Request timeout, seconds */
+	GHashTable *timeouts;			/* Timed out count per req */
+	GHashTable *latency;			/* Latency stats per req */
+	struct ril_io_stats stats;		/* Throughput counters */
 	gboolean destroyed;			/* Re-entrancy guard */
 	gboolean in_read_handler;		/* Re-entrancy guard */
 	gboolean in_notify;
@@ -105,6 +193,35 @@ struct ril_s {
 	GRilMsgIdToStrFunc req_to_string;
 	GRilMsgIdToStrFunc unsol_to_string;
 	int version;
+	unsigned int max_data_calls;		/* Concurrent data calls */
+	gchar *scratch;				/* Wrapped record buffer */
+	gsize scratch_size;			/* Size of scratch buffer */
+	gsize spill_len;			/* Oversized record length */
+	gsize spill_read;			/* Oversized bytes read */
+	gboolean spill_discard;			/* Skip oversized record */
+	struct ril_trace_ring *trace_ring;	/* Own, or the session's */
+	struct _GRilSession *session;		/* Multi-slot session */
+	gchar *sock_path;			/* For reconnecting */
+	gboolean held;				/* See g_ril_session_new */
+	gboolean release_pending;		/* Release on session idle */
+	GQueue held_unsol;			/* Unsolicited held back */
+	GRilDebugFunc debugf;			/* Reapplied on reconnect */
+	gpointer debug_data;
+};
+
+struct _GRilSession {
+	gint ref_count;
+	GSList *slots;				/* struct ril_s, referenced */
+	gboolean hold;				/* Hold slots on connection */
+	guint tick_source;			/* Timer wheel of all slots */
+	guint reconnect_source;
+	guint reconnect_interval;		/* Milliseconds */
+	guint idle_source;			/* Deferred swap and release */
+	struct ril_s *swap_a;			/* Pending swap, if any */
+	struct ril_s *swap_b;
+	GRilSessionConnectFunc connect;
+	gpointer connect_data;
+	struct ril_trace_ring *trace_ring;
 };
 
 struct _GRil {
@@ -122,8 +239,98 @@ struct req_hdr {
 
 #define RIL_PRINT_BUF_SIZE 8096
 char print_buf[RIL_PRINT_BUF_SIZE] __attribute__((used));
+static gsize print_buf_len;
 
 static void ril_wakeup_writer(struct ril_s *ril);
+static void ril_unref(struct ril_s *ril);
+static void session_slot_disconnected(struct ril_s *ril);
+static void session_start_tick(GRilSession *session);
+
+static void trace_ring_free(struct ril_trace_ring *ring)
+{
+	if (ring == NULL)
+		return;
+
+	g_free(ring->entries);
+	g_free(ring);
+}
+
+static struct ril_trace_ring *trace_ring_new(guint entries)
+{
+	struct ril_trace_ring *ring = g_try_new0(struct ril_trace_ring, 1);
+
+	if (ring == NULL)
+		return NULL;
+
+	ring->entries = g_try_new0(struct ril_trace_entry, entries);
+	if (ring->entries == NULL) {
+		g_free(ring);
+		return NULL;
+	}
+
+	ring->size = entries;
+
+	return ring;
+}
+
+static void ril_held_clear(struct ril_s *ril)
+{
+	struct ril_msg *message;
+
+	while ((message = g_queue_pop_head(&ril->held_unsol))) {
+		g_free(message->buf);
+		g_free(message);
+	}
+}
+
+static void ril_free(struct ril_s *ril)
+{
+	if (ril->timeouts)
+		g_hash_table_destroy(ril->timeouts);
+
+	if (ril->latency)
+		g_hash_table_destroy(ril->latency);
+
+	/* A session's ring is left to the session */
+	if (ril->session == NULL)
+		trace_ring_free(ril->trace_ring);
+
+	ril_held_clear(ril);
+	g_free(ril->sock_path);
+
+	g_free(ril->scratch);
+	g_free(ril);
+}
+
+static void ril_trace_record(struct ril_s *ril, enum ril_trace_type type,
+				int serial, int req, int error,
+				const void *data, gsize len)
+{
+	struct ril_trace_ring *ring = ril->trace_ring;
+	struct ril_trace_entry *entry;
+
+	if (ring == NULL)
+		return;
+
+	entry = &ring->entries[ring->next];
+
+	if (++ring->next == ring->size)
+		ring->next = 0;
+
+	ring->count += 1;
+
+	entry->time = g_get_monotonic_time();
+	entry->type = type;
+	entry->slot = ril->slot;
+	entry->serial = serial;
+	entry->req = req;
+	entry->error = error;
+	entry->len = len;
+	entry->data_len = MIN(len, G_RIL_TRACE_DATA_SIZE);
+
+	if (entry->data_len)
+		memcpy(entry->data, data, entry->data_len);
+}
 
 static const char *request_id_to_string(struct ril_s *ril, int req)
 {
@@ -151,33 +358,94 @@ static const char *unsol_request_to_string(struct ril_s *ril, int req)
 	return str;
 }
 
-static void ril_notify_node_destroy(gpointer data, gpointer user_data)
-{
-	struct ril_notify_node *node = data;
-	g_free(node);
-}
-
 static void ril_notify_destroy(gpointer user_data)
 {
 	struct ril_notify *notify = user_data;
 
-	g_slist_foreach(notify->nodes, ril_notify_node_destroy, NULL);
-	g_slist_free(notify->nodes);
+	g_ptr_array_foreach(notify->nodes, (GFunc) g_free, NULL);
+	g_ptr_array_free(notify->nodes, TRUE);
 	g_free(notify);
 }
 
-static gint ril_notify_node_compare_by_id(gconstpointer a, gconstpointer b)
+static void ril_notify_mark(struct ril_s *ril, struct ril_notify_node *node)
+{
+	struct ril_notify *notify = node->notify;
+
+	if (node->destroyed)
+		return;
+
+	node->destroyed = TRUE;
+
+	if (notify->destroyed++ == 0)
+		ril->notify_dirty = g_slist_prepend(ril->notify_dirty, notify);
+}
+
+static void ril_notify_remove(struct ril_s *ril, struct ril_notify *notify)
+{
+	if (notify->nodes->len == 0)
+		g_hash_table_remove(ril->notify_list,
+					GINT_TO_POINTER(notify->req));
+}
+
+static void ril_notify_compact(struct ril_s *ril, struct ril_notify *notify)
+{
+	struct ril_notify_node *node;
+	guint i, j;
+
+	for (i = 0, j = 0; i < notify->nodes->len; i++) {
+		node = g_ptr_array_index(notify->nodes, i);
+
+		if (!node->destroyed) {
+			notify->nodes->pdata[j++] = node;
+			continue;
+		}
+
+		g_hash_table_remove(ril->notify_nodes,
+					GUINT_TO_POINTER(node->id));
+		g_free(node);
+	}
+
+	g_ptr_array_set_size(notify->nodes, j);
+	notify->destroyed = 0;
+
+	ril_notify_remove(ril, notify);
+}
+
+/* Drop the nodes that were unregistered while notifying */
+static void ril_notify_sweep(struct ril_s *ril)
+{
+	GSList *dirty = ril->notify_dirty;
+	GSList *l;
+
+	ril->notify_dirty = NULL;
+
+	if (ril->notify_list == NULL)
+		goto out;
+
+	for (l = dirty; l; l = l->next)
+		ril_notify_compact(ril, l->data);
+
+out:
+	g_slist_free(dirty);
+}
+
+static void ril_notify_node_remove(struct ril_s *ril,
+					struct ril_notify_node *node)
 {
-	const struct ril_notify_node *node = a;
-	guint id = GPOINTER_TO_UINT(b);
+	struct ril_notify *notify = node->notify;
 
-	if (node->id < id)
-		return -1;
+	g_hash_table_remove(ril->notify_nodes, GUINT_TO_POINTER(node->id));
+	g_ptr_array_remove(notify->nodes, node);
 
-	if (node->id > id)
-		return 1;
+	if (node->destroyed)
+		notify->destroyed -= 1;
 
-	return 0;
+	g_free(node);
+
+	if (notify->destroyed == 0)
+		ril->notify_dirty = g_slist_remove(ril->notify_dirty, notify);
+
+	ril_notify_remove(ril, notify);
 }
 
 static gboolean ril_unregister_all(struct ril_s *ril,
@@ -186,55 +454,32 @@ static gboolean ril_unregister_all(struct ril_s *ril,
 					gpointer userdata)
 {
 	GHashTableIter iter;
-	struct ril_notify *notify;
 	struct ril_notify_node *node;
 	gpointer key, value;
-	GSList *p;
-	GSList *c;
-	GSList *t;
+	GSList *removed = NULL;
+	GSList *l;
 
-	if (ril->notify_list == NULL)
+	if (ril->notify_nodes == NULL)
 		return FALSE;
 
-	g_hash_table_iter_init(&iter, ril->notify_list);
+	g_hash_table_iter_init(&iter, ril->notify_nodes);
 
 	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		notify = value;
-
-		p = NULL;
-		c = notify->nodes;
-
-		while (c) {
-			node = c->data;
+		node = value;
 
-			if (func(node, userdata) != TRUE) {
-				p = c;
-				c = c->next;
-				continue;
-			}
-
-			if (mark_only) {
-				node->destroyed = TRUE;
-				p = c;
-				c = c->next;
-				continue;
-			}
-
-			if (p)
-				p->next = c->next;
-			else
-				notify->nodes = c->next;
+		if (func(node, userdata) != TRUE)
+			continue;
 
-			ril_notify_node_destroy(node, NULL);
+		if (mark_only)
+			ril_notify_mark(ril, node);
+		else
+			removed = g_slist_prepend(removed, node);
+	}
 
-			t = c;
-			c = c->next;
-			g_slist_free_1(t);
-		}
+	for (l = removed; l; l = l->next)
+		ril_notify_node_remove(ril, l->data);
 
-		if (notify->nodes == NULL)
-			g_hash_table_iter_remove(&iter);
-	}
+	g_slist_free(removed);
 
 	return TRUE;
 }
@@ -248,6 +493,7 @@ static gboolean ril_unregister_all(struct ril_s *ril,
  */
 static struct ril_request *ril_request_create(struct ril_s *ril,
 						guint gid,
+						enum g_ril_priority priority,
 						const gint req,
 						const gint id,
 						struct parcel *rilp,
@@ -291,6 +537,7 @@ static struct ril_request *ril_request_create(struct ril_s *ril,
 		memcpy(r->data + sizeof(header), rilp->data, data_len);
 
 	r->req = req;
+	r->priority = priority;
 	r->gid = gid;
 	r->id = id;
 	r->callback = func;
@@ -311,6 +558,8 @@ static void ril_request_destroy(struct ril_request *req)
 
 static void ril_cleanup(struct ril_s *p)
 {
+	int i;
+
 	/* Cleanup pending commands */
 
 	if (p->command_queue) {
@@ -318,12 +567,36 @@ static void ril_cleanup(struct ril_s *p)
 		p->command_queue = NULL;
 	}
 
-	if (p->out_queue) {
-		g_queue_free(p->out_queue);
-		p->out_queue = NULL;
+	p->req_bytes_written = 0;
+
+	if (p->tx_groups) {
+		for (i = 0; i < G_RIL_PRIORITY_LAST; i++)
+			g_queue_clear(&p->tx_ready[i]);
+
+		g_hash_table_destroy(p->tx_groups);
+		p->tx_groups = NULL;
+		p->tx_queued = 0;
+	}
+
+	if (p->pending) {
+		g_hash_table_destroy(p->pending);
+		p->pending = NULL;
+	}
+
+	if (p->coalesce) {
+		g_hash_table_destroy(p->coalesce);
+		p->coalesce = NULL;
 	}
 
 	/* Cleanup registered notifications */
+	g_slist_free(p->notify_dirty);
+	p->notify_dirty = NULL;
+
+	if (p->notify_nodes) {
+		g_hash_table_destroy(p->notify_nodes);
+		p->notify_nodes = NULL;
+	}
+
 	if (p->notify_list) {
 		g_hash_table_destroy(p->notify_list);
 		p->notify_list = NULL;
@@ -333,6 +606,11 @@ static void ril_cleanup(struct ril_s *p)
 		g_source_remove(p->timeout_source);
 		p->timeout_source = 0;
 	}
+
+	for (i = 0; i < RIL_WHEEL_SLOTS; i++)
+		g_queue_clear(&p->wheel[i]);
+
+	p->wheel_count = 0;
 }
 
 void g_ril_set_disconnect_function(GRil *ril, GRilDisconnectFunc disconnect,
@@ -348,6 +626,11 @@ static void io_disconnect(gpointer user_data)
 
 	ofono_error("%s: disconnected from rild", __func__);
 
+	if (ril->session != NULL) {
+		session_slot_disconnected(ril);
+		return;
+	}
+
 	ril_cleanup(ril);
 	g_ril_io_unref(ril->io);
 	ril->io = NULL;
@@ -356,949 +639,2166 @@ static void io_disconnect(gpointer user_data)
 		ril->user_disconnect(ril->user_disconnect_data);
 }
 
-static void handle_response(struct ril_s *p, struct ril_msg *message)
+static enum g_ril_priority ril_request_priority(int req)
 {
-	guint count = g_queue_get_length(p->command_queue);
-	struct ril_request *req;
-	gboolean found = FALSE;
-	guint i, len;
-	gint id;
-
-	for (i = 0; i < count; i++) {
-		req = g_queue_peek_nth(p->command_queue, i);
-
-		if (req->id == message->serial_no) {
-			found = TRUE;
-			message->req = req->req;
-
-			if (message->error != RIL_E_SUCCESS)
-				RIL_TRACE(p, "[%d,%04d]< %s failed %s",
-					p->slot, message->serial_no,
-					request_id_to_string(p, message->req),
-					ril_error_to_string(message->error));
-
-			req = g_queue_pop_nth(p->command_queue, i);
-			if (req->callback)
-				req->callback(message, req->user_data);
-
-			len = g_queue_get_length(p->out_queue);
-
-			for (i = 0; i < len; i++) {
-				id = GPOINTER_TO_INT(g_queue_peek_nth(
-							p->out_queue, i));
-				if (id == req->id) {
-					g_queue_pop_nth(p->out_queue, i);
-					break;
-				}
-			}
+	switch (req) {
+	case RIL_REQUEST_DIAL:
+	case RIL_REQUEST_HANGUP:
+	case RIL_REQUEST_HANGUP_WAITING_OR_BACKGROUND:
+	case RIL_REQUEST_HANGUP_FOREGROUND_RESUME_BACKGROUND:
+	case RIL_REQUEST_SWITCH_WAITING_OR_HOLDING_AND_ACTIVE:
+	case RIL_REQUEST_CONFERENCE:
+	case RIL_REQUEST_UDUB:
+	case RIL_REQUEST_ANSWER:
+	case RIL_REQUEST_SEPARATE_CONNECTION:
+	case RIL_REQUEST_EXPLICIT_CALL_TRANSFER:
+	case RIL_REQUEST_DTMF:
+	case RIL_REQUEST_DTMF_START:
+	case RIL_REQUEST_DTMF_STOP:
+		return G_RIL_PRIORITY_CALL_CONTROL;
+	case RIL_REQUEST_SEND_SMS:
+	case RIL_REQUEST_SEND_SMS_EXPECT_MORE:
+	case RIL_REQUEST_SMS_ACKNOWLEDGE:
+	case RIL_REQUEST_ACKNOWLEDGE_INCOMING_GSM_SMS_WITH_PDU:
+	case RIL_REQUEST_IMS_SEND_SMS:
+		return G_RIL_PRIORITY_SMS;
+	case RIL_REQUEST_SIGNAL_STRENGTH:
+	case RIL_REQUEST_VOICE_REGISTRATION_STATE:
+	case RIL_REQUEST_DATA_REGISTRATION_STATE:
+	case RIL_REQUEST_OPERATOR:
+	case RIL_REQUEST_VOICE_RADIO_TECH:
+	case RIL_REQUEST_DATA_CALL_LIST:
+		return G_RIL_PRIORITY_POLL;
+	case RIL_REQUEST_SIM_IO:
+	case RIL_REQUEST_QUERY_AVAILABLE_NETWORKS:
+		return G_RIL_PRIORITY_BULK;
+	}
 
-			ril_request_destroy(req);
+	return G_RIL_PRIORITY_DEFAULT;
+}
 
-			if (g_queue_peek_head(p->command_queue))
-				ril_wakeup_writer(p);
+static void ril_tx_push(struct ril_s *ril, struct ril_request *req,
+				gboolean head)
+{
+	gpointer key = TX_GROUP_KEY(req->gid, req->priority);
+	struct ril_tx_group *group;
+
+	group = g_hash_table_lookup(ril->tx_groups, key);
+	if (group == NULL) {
+		group = g_new0(struct ril_tx_group, 1);
+		group->gid = req->gid;
+		group->priority = req->priority;
+		g_queue_init(&group->requests);
+
+		g_hash_table_insert(ril->tx_groups, key, group);
+		g_queue_push_tail(&ril->tx_ready[req->priority], group);
+	}
 
-			break;
-		}
+	if (head) {
+		g_queue_push_head(&group->requests, req);
+		req->link = g_queue_peek_head_link(&group->requests);
+	} else {
+		g_queue_push_tail(&group->requests, req);
+		req->link = g_queue_peek_tail_link(&group->requests);
 	}
 
-	if (found == FALSE)
-		ofono_error("No matching request for reply: %s serial_no: %d!",
-			request_id_to_string(p, message->req),
-			message->serial_no);
+	req->group = group;
 
+	ril->tx_queued += 1;
 }
 
-static gboolean node_check_destroyed(struct ril_notify_node *node,
-					gpointer userdata)
+static void ril_tx_unlink(struct ril_s *ril, struct ril_request *req)
 {
-	gboolean val = GPOINTER_TO_UINT(userdata);
+	struct ril_tx_group *group = req->group;
 
-	if (node->destroyed == val)
-		return TRUE;
-
-	return FALSE;
-}
+	g_queue_delete_link(&group->requests, req->link);
+	req->link = NULL;
+	req->group = NULL;
 
-static void handle_unsol_req(struct ril_s *p, struct ril_msg *message)
-{
-	struct ril_notify *notify;
+	ril->tx_queued -= 1;
 
-	if (p->notify_list == NULL)
+	if (!g_queue_is_empty(&group->requests))
 		return;
 
-	p->in_notify = TRUE;
+	g_queue_remove(&ril->tx_ready[group->priority], group);
+	g_hash_table_remove(ril->tx_groups,
+				TX_GROUP_KEY(group->gid, group->priority));
+}
 
-	notify = g_hash_table_lookup(p->notify_list, &message->req);
-	if (notify != NULL) {
-		GSList *list_item;
+/*
+ * Picks the next request to be written: the highest priority wins, and
+ * within a priority the groups take turns.  A held slot only writes
+ * session requests.
+ */
+static struct ril_request *ril_tx_pop(struct ril_s *ril)
+{
+	struct ril_tx_group *group;
+	struct ril_request *req;
+	int last = ril->held ? G_RIL_PRIORITY_SESSION + 1 : G_RIL_PRIORITY_LAST;
+	int i;
 
-		for (list_item = notify->nodes; list_item;
-				list_item = g_slist_next(list_item)) {
-			struct ril_notify_node *node = list_item->data;
+	for (i = 0; i < last; i++) {
+		group = g_queue_pop_head(&ril->tx_ready[i]);
+		if (group == NULL)
+			continue;
 
-			if (node->destroyed)
-				continue;
+		g_queue_push_tail(&ril->tx_ready[i], group);
 
-			node->callback(message, node->user_data);
-		}
-	} else {
-		/* Only log events not being listended for... */
-		DBG("RIL Event slot %d: %s\n",
-			p->slot, unsol_request_to_string(p, message->req));
-	}
+		req = g_queue_peek_head(&group->requests);
+		ril_tx_unlink(ril, req);
 
-	p->in_notify = FALSE;
+		return req;
+	}
 
-	/* Now destroy nodes possibly removed by callbacks */
-	if (notify != NULL)
-		ril_unregister_all(p, FALSE, node_check_destroyed,
-					GUINT_TO_POINTER(TRUE));
+	return NULL;
 }
 
-static void dispatch(struct ril_s *p, struct ril_msg *message)
+static guint ril_request_timeout(struct ril_s *ril, int req)
 {
-	int32_t *unsolicited_field, *id_num_field;
-	gchar *bufp = message->buf;
-	gchar *datap;
-	gsize data_len;
-
-	if (message->buf_len == 0) {
-		ofono_error("RIL error: incoming message with size 0");
-		goto error;
+	switch (req) {
+	case RIL_REQUEST_QUERY_AVAILABLE_NETWORKS:
+	case RIL_REQUEST_SET_NETWORK_SELECTION_AUTOMATIC:
+	case RIL_REQUEST_SET_NETWORK_SELECTION_MANUAL:
+	case RIL_REQUEST_SETUP_DATA_CALL:
+	case RIL_REQUEST_DEACTIVATE_DATA_CALL:
+	case RIL_REQUEST_RADIO_POWER:
+		return ril->timeout * RIL_LONG_TIMEOUT_FACTOR;
 	}
 
-	/* This could be done with a struct/union... */
-	unsolicited_field = (int32_t *) (void *) bufp;
-	if (*unsolicited_field)
-		message->unsolicited = TRUE;
-	else
-		message->unsolicited = FALSE;
+	return ril->timeout;
+}
 
-	bufp += 4;
+static gboolean ril_wheel_tick(gpointer user_data);
 
-	id_num_field = (int32_t *) (void *) bufp;
-	if (message->unsolicited) {
-		message->req = (int) *id_num_field;
+static void ril_wheel_add(struct ril_s *ril, struct ril_request *req,
+				guint timeout)
+{
+	GQueue *slot;
 
-		/*
-		 * A RIL Unsolicited Event is two UINT32 fields ( unsolicited,
-		 * and req/ev ), so subtract the length of the header from the
-		 * overall length to calculate the length of the Event Data.
-		 */
-		data_len = message->buf_len - 8;
-	} else {
-		message->serial_no = (int) *id_num_field;
+	req->expires = ril->wheel_tick + MAX(timeout, 1);
 
-		bufp += 4;
-		message->error = *((int32_t *) (void *) bufp);
+	slot = &ril->wheel[req->expires % RIL_WHEEL_SLOTS];
+	g_queue_push_tail(slot, req);
+	req->wheel_link = g_queue_peek_tail_link(slot);
 
-		/*
-		 * A RIL Solicited Response is three UINT32 fields ( unsolicied,
-		 * serial_no and error ), so subtract the length of the header
-		 * from the overall length to calculate the length of the Event
-		 * Data.
-		 */
-		data_len = message->buf_len - 12;
-	}
+	ril->wheel_count += 1;
 
-	/* advance to start of data.. */
-	bufp += 4;
+	if (ril->session != NULL)
+		session_start_tick(ril->session);
+	else if (ril->timeout_source == 0)
+		ril->timeout_source = g_timeout_add_seconds(1, ril_wheel_tick,
+								ril);
+}
 
-	/*
-	 * Now, use buffer for event data if present
-	 */
-	if (data_len) {
-		datap = g_try_malloc(data_len);
-		if (datap == NULL)
-			goto error;
+static void ril_wheel_remove(struct ril_s *ril, struct ril_request *req)
+{
+	if (req->wheel_link == NULL)
+		return;
 
-		/* Copy event bytes from message->buf into new buffer */
-		memcpy(datap, bufp, data_len);
+	g_queue_delete_link(&ril->wheel[req->expires % RIL_WHEEL_SLOTS],
+				req->wheel_link);
+	req->wheel_link = NULL;
 
-		/* Free buffer that includes header */
-		g_free(message->buf);
+	ril->wheel_count -= 1;
+}
 
-		/* ...and replace with new buffer */
-		message->buf = datap;
-		message->buf_len = data_len;
-	} else {
-		/* Free buffer that includes header */
-		g_free(message->buf);
+static void ril_request_unlink(struct ril_s *p, struct ril_request *req)
+{
+	ril_wheel_remove(p, req);
 
-		/* To know if there was no data when parsing */
-		message->buf = NULL;
-		message->buf_len = 0;
+	if (req->group != NULL) {
+		ril_tx_unlink(p, req);
+		return;
 	}
 
-	if (message->unsolicited == TRUE)
-		handle_unsol_req(p, message);
-	else
-		handle_response(p, message);
+	if (req->link == NULL)
+		return;
 
-error:
-	g_free(message->buf);
-	g_free(message);
+	g_queue_delete_link(p->command_queue, req->link);
+	req->link = NULL;
 }
 
-static struct ril_msg *read_fixed_record(struct ril_s *p,
-						const guchar *bytes, gsize *len)
+static guint latency_bucket(gint64 usecs)
 {
-	struct ril_msg *message;
-	unsigned message_len, plen;
+	guint i = 0;
 
-	/* First four bytes are length in TCP byte order (Big Endian) */
-	plen = ntohl(*((uint32_t *) (void *) bytes));
-	bytes += 4;
+	while (i < G_RIL_LATENCY_BUCKETS - 1 && usecs >= (1000LL << i))
+		i++;
 
-	/*
-	 * TODO: Verify that 8k is the max message size from rild.
-	 *
-	 * This condition shouldn't happen.  If it does
-	 * there are three options:
-	 *
-	 * 1) Exit; ofono will restart via DBus (this is what we do now)
-	 * 2) Consume the bytes & continue
-	 * 3) force a disconnect
-	 */
-	if (plen > GRIL_BUFFER_SIZE - 4) {
-		ofono_error("ERROR RIL parcel bigger than buffer (%u), exiting",
-				plen);
-		exit(1);
-	}
+	return i;
+}
 
-	/*
-	 * If we don't have the whole fixed record in the ringbuffer
-	 * then return NULL & leave ringbuffer as is.
-	 */
+/*
+ * Queue wait is the time from g_ril_send until the request was fully
+ * written, modem time from then until the response arrived.
+ */
+static void ril_latency_record(struct ril_s *p, struct ril_request *req)
+{
+	struct ril_latency_stats *stats;
+	gint64 queue_time, modem_time;
 
-	message_len = *len - 4;
-	if (message_len < plen)
-		return NULL;
+	if (req->write_time == 0)
+		return;
+
+	stats = g_hash_table_lookup(p->latency, GINT_TO_POINTER(req->req));
+	if (stats == NULL) {
+		stats = g_new0(struct ril_latency_stats, 1);
+		g_hash_table_insert(p->latency, GINT_TO_POINTER(req->req),
+					stats);
+	}
 
-	message = g_malloc(sizeof(struct ril_msg));
+	queue_time = req->write_time - req->enqueue_time;
+	modem_time = g_get_monotonic_time() - req->write_time;
 
-	/* allocate ril_msg->buffer */
-	message->buf_len = plen;
-	message->buf = g_malloc(plen);
+	stats->count += 1;
+	stats->queue_time += queue_time;
+	stats->modem_time += modem_time;
 
-	/* Copy bytes into message buffer */
-	memmove(message->buf, (const void *) bytes, plen);
+	if ((guint64) modem_time > stats->modem_time_max)
+		stats->modem_time_max = modem_time;
 
-	/* Indicate to caller size of record we extracted */
-	*len = plen + 4;
-	return message;
+	stats->queue_hist[latency_bucket(queue_time)] += 1;
+	stats->modem_hist[latency_bucket(modem_time)] += 1;
 }
 
-static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
+static void handle_response(struct ril_s *p, struct ril_msg *message)
 {
-	struct ril_msg *message;
-	struct ril_s *p = user_data;
-	unsigned int len = ring_buffer_len(rbuf);
-	unsigned int wrap = ring_buffer_len_no_wrap(rbuf);
-	guchar *buf = ring_buffer_read_ptr(rbuf, p->read_so_far);
+	struct ril_request *req;
 
-	p->in_read_handler = TRUE;
+	req = g_hash_table_lookup(p->pending,
+					GINT_TO_POINTER(message->serial_no));
 
-	while (p->suspended == FALSE && (p->read_so_far < len)) {
-		gsize rbytes = MIN(len - p->read_so_far, wrap - p->read_so_far);
+	ril_trace_record(p, RIL_TRACE_RESPONSE, message->serial_no,
+				req ? req->req : 0, message->error,
+				message->buf, message->buf_len);
 
-		if (rbytes < 4) {
-			DBG("Not enough bytes for header length: len: %d", len);
-			return;
-		}
-
-		/*
-		 * This function attempts to read the next full length
-		 * fixed message from the stream.  if not all bytes are
-		 * available, it returns NULL.  otherwise it allocates
-		 * and returns a ril_message with the copied bytes, and
-		 * drains those bytes from the ring_buffer
-		 */
-		message = read_fixed_record(p, buf, &rbytes);
-
-		/* wait for the rest of the record... */
-		if (message == NULL)
-			break;
-
-		buf += rbytes;
-		p->read_so_far += rbytes;
+	if (req == NULL) {
+		ofono_error("No matching request for reply: %s serial_no: %d!",
+			request_id_to_string(p, message->req),
+			message->serial_no);
+		return;
+	}
 
-		/* TODO: need to better understand how wrap works! */
-		if (p->read_so_far == wrap) {
-			buf = ring_buffer_read_ptr(rbuf, p->read_so_far);
-			wrap = len;
-		}
+	message->req = req->req;
+	p->stats.responses += 1;
 
-		dispatch(p, message);
+	ril_latency_record(p, req);
 
-		ring_buffer_drain(rbuf, p->read_so_far);
+	if (message->error != RIL_E_SUCCESS)
+		RIL_TRACE(p, "[%d,%04d]< %s failed %s",
+			p->slot, message->serial_no,
+			request_id_to_string(p, message->req),
+			ril_error_to_string(message->error));
 
-		len -= p->read_so_far;
-		wrap -= p->read_so_far;
-		p->read_so_far = 0;
-	}
+	g_hash_table_remove(p->pending, GINT_TO_POINTER(req->id));
+	ril_request_unlink(p, req);
 
-	p->in_read_handler = FALSE;
+	if (req->callback)
+		req->callback(message, req->user_data);
 
-	if (p->destroyed)
-		g_free(p);
+	ril_request_destroy(req);
 }
 
-/*
- * This function is a GIOFunc and may be called directly or via an IO watch.
- * The return value controls whether the watch stays active ( TRUE ), or is
- * removed ( FALSE ).
- */
-static gboolean can_write_data(gpointer data)
+static void ril_trace_foreach(struct ril_s *ril, GRilTraceFunc func,
+				gpointer user_data)
 {
-	struct ril_s *ril = data;
-	struct ril_request *req;
-	gsize bytes_written, towrite, len;
-	guint qlen, oqlen;
-	gint id;
-	gboolean written = TRUE;
-	guint i, j;
+	struct ril_trace_ring *ring = ril->trace_ring;
+	guint count = MIN(ring->count, ring->size);
+	guint i = (ring->next + ring->size - count) % ring->size;
 
-	qlen = g_queue_get_length(ril->command_queue);
-	if (qlen < 1)
-		return FALSE;
+	while (count--) {
+		func(&ring->entries[i], user_data);
 
-	/* if the whole request was not written */
-	if (ril->req_bytes_written != 0) {
-
-		for (i = 0; i < qlen; i++) {
-			req = g_queue_peek_nth(ril->command_queue, i);
-			if (req) {
-				id = GPOINTER_TO_INT(g_queue_peek_head(
-							ril->out_queue));
-				if (req->id == id)
-					goto out;
-			} else {
-				return FALSE;
-			}
-		}
+		if (++i == ring->size)
+			i = 0;
 	}
-	/* if no requests already sent */
-	oqlen = g_queue_get_length(ril->out_queue);
-	if (oqlen < 1) {
-		req = g_queue_peek_head(ril->command_queue);
-		if (req == NULL)
-			return FALSE;
+}
 
-		g_queue_push_head(ril->out_queue, GINT_TO_POINTER(req->id));
+static void ril_trace_dump_entry(const struct ril_trace_entry *entry,
+					gpointer user_data)
+{
+	struct ril_s *ril = user_data;
+	static const char *type_str[] = { ">", "<", "U", "T" };
+	char hex[G_RIL_TRACE_DATA_SIZE * 2 + 1];
+	const char *name;
+	guint i;
 
-		goto out;
-	}
+	for (i = 0; i < entry->data_len; i++)
+		sprintf(hex + i * 2, "%02x", entry->data[i]);
 
-	for (i = 0; i < qlen; i++) {
-		req = g_queue_peek_nth(ril->command_queue, i);
-		if (req == NULL)
-			return FALSE;
+	hex[i * 2] = '\0';
 
-		for (j = 0; j < oqlen; j++) {
-			id = GPOINTER_TO_INT(
-					g_queue_peek_nth(ril->out_queue, j));
-			if (req->id == id) {
-				written = TRUE;
-				break;
-			} else {
-				written = FALSE;
-			}
-		}
+	if (entry->type == RIL_TRACE_UNSOL)
+		name = unsol_request_to_string(ril, entry->req);
+	else
+		name = request_id_to_string(ril, entry->req);
 
-		if (written == FALSE)
-			break;
-	}
+	ofono_info("[%d,%04d]%s %" G_GINT64_FORMAT " %s err=%d len=%u %s",
+			entry->slot, entry->serial, type_str[entry->type],
+			entry->time, name, entry->error, entry->len, hex);
+}
 
-	/* watcher fired though requests already written */
-	if (written == TRUE)
-		return FALSE;
+static void ril_trace_dump(struct ril_s *ril)
+{
+	if (ril->trace_ring == NULL)
+		return;
 
-	g_queue_push_head(ril->out_queue, GINT_TO_POINTER(req->id));
+	ofono_info("RIL trace of slot %d, %u entries recorded", ril->slot,
+			ril->trace_ring->count);
 
-out:
-	len = req->data_len;
+	ril_trace_foreach(ril, ril_trace_dump_entry, ril);
+}
 
-	towrite = len - ril->req_bytes_written;
+static void ril_request_timed_out(struct ril_s *p, struct ril_request *req)
+{
+	struct ril_msg message;
+	guint count;
 
-#ifdef WRITE_SCHEDULER_DEBUG
-	if (towrite > 5)
-		towrite = 5;
-#endif
+	count = GPOINTER_TO_UINT(g_hash_table_lookup(p->timeouts,
+						GINT_TO_POINTER(req->req)));
+	g_hash_table_insert(p->timeouts, GINT_TO_POINTER(req->req),
+				GUINT_TO_POINTER(count + 1));
+	p->stats.timeouts += 1;
 
-	bytes_written = g_ril_io_write(ril->io,
-					req->data + ril->req_bytes_written,
-					towrite);
+	ofono_error("[%d,%04d]< %s timed out (%u so far for this request)",
+			p->slot, req->id, request_id_to_string(p, req->req),
+			count + 1);
 
-	if (bytes_written == 0)
-		return FALSE;
+	ril_trace_record(p, RIL_TRACE_TIMEOUT, req->id, req->req,
+				RIL_E_TIMEOUT, NULL, 0);
 
-	ril->req_bytes_written += bytes_written;
-	if (bytes_written < towrite)
-		return TRUE;
-	else
-		ril->req_bytes_written = 0;
+	memset(&message, 0, sizeof(message));
+	message.req = req->req;
+	message.serial_no = req->id;
+	message.error = RIL_E_TIMEOUT;
 
-	return FALSE;
-}
+	if (req->callback)
+		req->callback(&message, req->user_data);
 
-static void ril_wakeup_writer(struct ril_s *ril)
-{
-	g_ril_io_set_write_handler(ril->io, can_write_data, ril);
+	ril_request_destroy(req);
 }
 
-static void ril_suspend(struct ril_s *ril)
+/* Advances the timer wheel of one slot by a second */
+static void ril_wheel_advance(struct ril_s *ril)
 {
-	ril->suspended = TRUE;
+	struct ril_request *req;
+	GSList *expired = NULL;
+	GSList *l;
+	GQueue *slot;
+	GList *link, *next;
 
-	g_ril_io_set_write_handler(ril->io, NULL, NULL);
-	g_ril_io_set_read_handler(ril->io, NULL, NULL);
-	g_ril_io_set_debug(ril->io, NULL, NULL);
-}
+	ril->wheel_tick += 1;
+	slot = &ril->wheel[ril->wheel_tick % RIL_WHEEL_SLOTS];
 
-static gboolean ril_set_debug(struct ril_s *ril,
-				GRilDebugFunc func, gpointer user_data)
-{
-	if (ril->io == NULL)
-		return FALSE;
+	for (link = g_queue_peek_head_link(slot); link; link = next) {
+		next = link->next;
+		req = link->data;
 
-	g_ril_io_set_debug(ril->io, func, user_data);
+		if (req->expires > ril->wheel_tick)
+			continue;
 
-	return TRUE;
-}
+		ril_wheel_remove(ril, req);
 
-static void ril_unref(struct ril_s *ril)
-{
-	gboolean is_zero;
+		/* Can't drop a request half way through writing it */
+		if (req->sent && req->link != NULL) {
+			ril_wheel_add(ril, req, 1);
+			continue;
+		}
 
-	is_zero = g_atomic_int_dec_and_test(&ril->ref_count);
+		g_hash_table_remove(ril->pending, GINT_TO_POINTER(req->id));
+		ril_request_unlink(ril, req);
+		expired = g_slist_prepend(expired, req);
+	}
 
-	if (is_zero == FALSE)
-		return;
+	expired = g_slist_reverse(expired);
 
-	if (ril->io) {
-		ril_suspend(ril);
-		g_ril_io_unref(ril->io);
-		ril->io = NULL;
-		ril_cleanup(ril);
-	}
+	for (l = expired; l; l = l->next)
+		ril_request_timed_out(ril, l->data);
 
-	if (ril->in_read_handler)
-		ril->destroyed = TRUE;
-	else
-		g_free(ril);
+	/* Keep the history leading up to a wedged rild */
+	if (expired != NULL && ril->trace_ring != NULL)
+		ril_trace_dump(ril);
+
+	g_slist_free(expired);
 }
 
-static gboolean node_compare_by_group(struct ril_notify_node *node,
-					gpointer userdata)
+static gboolean ril_wheel_tick(gpointer user_data)
 {
-	guint group = GPOINTER_TO_UINT(userdata);
+	struct ril_s *ril = user_data;
+	gboolean again;
 
-	if (node->gid == group)
-		return TRUE;
+	/* Callbacks might drop the last reference */
+	g_atomic_int_inc(&ril->ref_count);
 
-	return FALSE;
-}
+	ril_wheel_advance(ril);
 
-static void set_process_id(gid_t gid, uid_t uid)
-{
-	if (setegid(gid) < 0)
-		ofono_error("%s: setegid(%d) failed: %s (%d)",
-				__func__, gid, strerror(errno), errno);
+	again = ril->wheel_count > 0 && ril->timeout_source != 0;
+	if (again == FALSE)
+		ril->timeout_source = 0;
 
-	if (seteuid(uid) < 0)
-		ofono_error("%s: seteuid(%d) failed: %s (%d)",
-				__func__, uid, strerror(errno), errno);
-}
+	ril_unref(ril);
 
-static struct ril_s *create_ril(const char *sock_path)
+	return again;
+}
 
+static void ril_notify_event(struct ril_s *p, struct ril_msg *message)
 {
-	struct ril_s *ril;
-	struct sockaddr_un addr;
-	int sk;
-	GIOChannel *io;
+	struct ril_notify *notify;
 
-	ril = g_try_new0(struct ril_s, 1);
-	if (ril == NULL)
-		return ril;
+	if (p->notify_list == NULL)
+		return;
 
-	ril->ref_count = 1;
-	ril->next_cmd_id = 1;
-	ril->next_notify_id = 1;
-	ril->next_gid = 0;
-	ril->req_bytes_written = 0;
-	ril->trace = FALSE;
+	notify = g_hash_table_lookup(p->notify_list,
+					GINT_TO_POINTER(message->req));
+	if (notify != NULL) {
+		/* Nodes registered by the callbacks are not notified */
+		guint len = notify->nodes->len;
+		guint i;
 
-	/* sock_path is allowed to be NULL for unit tests */
-	if (sock_path == NULL)
-		return ril;
+		p->in_notify = TRUE;
 
-	sk = socket(AF_UNIX, SOCK_STREAM, 0);
-	if (sk < 0) {
-		ofono_error("create_ril: can't create unix socket: %s (%d)\n",
-				strerror(errno), errno);
-		goto error;
-	}
+		for (i = 0; i < len && p->notify_list; i++) {
+			struct ril_notify_node *node =
+				g_ptr_array_index(notify->nodes, i);
 
-	memset(&addr, 0, sizeof(addr));
-	addr.sun_family = AF_UNIX;
-	strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+			if (node->destroyed)
+				continue;
 
-	/* RIL expects user radio to connect to the socket */
-	set_process_id(RADIO_GID, RADIO_UID);
+			node->callback(message, node->user_data);
+		}
 
-	if (connect(sk, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
-		ofono_error("create_ril: can't connect to RILD: %s (%d)\n",
-				strerror(errno), errno);
-		/* Switch back to root */
-		set_process_id(0, 0);
-		goto error;
+		p->in_notify = FALSE;
+	} else {
+		/* Only log events not being listended for... */
+		DBG("RIL Event slot %d: %s\n",
+			p->slot, unsol_request_to_string(p, message->req));
 	}
 
-	/* Switch back to root */
-	set_process_id(0, 0);
+	/* Now destroy nodes removed by callbacks, if any */
+	if (p->notify_dirty != NULL)
+		ril_notify_sweep(p);
+}
 
-	io = g_io_channel_unix_new(sk);
-	if (io == NULL) {
-		ofono_error("create_ril: can't open RILD io channel: %s (%d)\n",
-				strerror(errno), errno);
-		goto error;
-	}
+static gboolean ril_coalesce_timeout(gpointer user_data)
+{
+	struct ril_coalesce *c = user_data;
+	struct ril_s *ril = c->ril;
 
-	g_io_channel_set_close_on_unref(io, TRUE);
-	g_io_channel_set_flags(io, G_IO_FLAG_NONBLOCK, NULL);
+	c->source = 0;
 
-	ril->io = g_ril_io_new(io);
-	g_io_channel_unref(io);
+	if (c->held == FALSE)
+		return FALSE;
 
-	if (ril->io == NULL) {
-		ofono_error("create_ril: can't create ril->io");
-		goto error;
-	}
+	c->held = FALSE;
 
-	g_ril_io_set_disconnect_function(ril->io, io_disconnect, ril);
+	/* Callbacks might drop the last reference */
+	g_atomic_int_inc(&ril->ref_count);
 
-	ril->command_queue = g_queue_new();
-	if (ril->command_queue == NULL) {
-		ofono_error("create_ril: Couldn't create command_queue.");
-		goto error;
-	}
+	ril_notify_event(ril, &c->message);
 
-	ril->out_queue = g_queue_new();
-	if (ril->out_queue == NULL) {
-		ofono_error("create_ril: Couldn't create out_queue.");
-		goto error;
-	}
+	/* Hold back the rest of the burst for another window */
+	if (ril->coalesce != NULL && c->window > 0)
+		c->source = g_timeout_add(c->window, ril_coalesce_timeout, c);
 
-	ril->notify_list = g_hash_table_new_full(g_int_hash, g_int_equal,
-							g_free,
-							ril_notify_destroy);
+	ril_unref(ril);
 
-	g_ril_io_set_read_handler(ril->io, new_bytes, ril);
+	return FALSE;
+}
 
-	return ril;
+static void ril_coalesce_destroy(gpointer user_data)
+{
+	struct ril_coalesce *c = user_data;
 
-error:
-	ril_unref(ril);
+	if (c->source)
+		g_source_remove(c->source);
 
-	return NULL;
+	g_free(c->message.buf);
+	g_free(c);
 }
 
-static struct ril_notify *ril_notify_create(struct ril_s *ril,
-						const int req)
+static gboolean ril_coalesce_hold(struct ril_s *p, struct ril_msg *message)
 {
-	struct ril_notify *notify;
-	int *key;
+	struct ril_coalesce *c;
 
-	notify = g_try_new0(struct ril_notify, 1);
-	if (notify == NULL)
-		return 0;
+	if (p->coalesce == NULL)
+		return FALSE;
 
-	key = g_try_new0(int, 1);
-	if (key == NULL)
-		return 0;
+	c = g_hash_table_lookup(p->coalesce, GINT_TO_POINTER(message->req));
+	if (c == NULL || c->window == 0)
+		return FALSE;
+
+	if (c->source == 0) {
+		c->source = g_timeout_add(c->window, ril_coalesce_timeout, c);
+		return FALSE;
+	}
 
-	*key = req;
+	if (message->buf_len > c->buf_size) {
+		c->message.buf = g_realloc(c->message.buf, message->buf_len);
+		c->buf_size = message->buf_len;
+	}
 
-	g_hash_table_insert(ril->notify_list, key, notify);
+	if (message->buf_len > 0)
+		memcpy(c->message.buf, message->buf, message->buf_len);
 
-	return notify;
+	c->message.buf_len = message->buf_len;
+	c->message.unsolicited = message->unsolicited;
+	c->message.req = message->req;
+	c->message.serial_no = message->serial_no;
+	c->message.error = message->error;
+
+	if (c->held)
+		p->stats.coalesced += 1;
+
+	c->held = TRUE;
+
+	return TRUE;
 }
 
-static void ril_cancel_group(struct ril_s *ril, guint group)
+static void handle_unsol_req(struct ril_s *p, struct ril_msg *message)
 {
-	int n = 0;
-	guint len, i;
-	struct ril_request *req;
-	gboolean sent;
+	ril_trace_record(p, RIL_TRACE_UNSOL, 0, message->req, 0,
+				message->buf, message->buf_len);
 
-	if (ril->command_queue == NULL)
+	p->stats.unsolicited += 1;
+
+	if (ril_coalesce_hold(p, message))
 		return;
 
-	while ((req = g_queue_peek_nth(ril->command_queue, n)) != NULL) {
-		if (req->id == 0 || req->gid != group) {
-			n += 1;
-			continue;
-		}
+	ril_notify_event(p, message);
+}
 
-		req->callback = NULL;
-		sent = FALSE;
-
-		len = g_queue_get_length(ril->out_queue);
-		for (i = 0; i < len; i++) {
-			if (GPOINTER_TO_INT(
-					g_queue_peek_nth(ril->out_queue, i))
-					== req->id) {
-				n += 1;
-				sent = TRUE;
-				break;
-			}
-		 }
+/* Kept until the slot is released, the read buffer is reused */
+static void ril_hold_unsol(struct ril_s *p, struct ril_msg *message)
+{
+	struct ril_msg *held = g_new(struct ril_msg, 1);
 
-		if (sent)
-			continue;
+	*held = *message;
+	held->buf = g_memdup(message->buf, message->buf_len);
 
-		g_queue_remove(ril->command_queue, req);
-		ril_request_destroy(req);
-	}
+	g_queue_push_tail(&p->held_unsol, held);
 }
 
-static guint ril_register(struct ril_s *ril, guint group,
-				const int req, GRilNotifyFunc func,
-				gpointer user_data)
+static void dispatch(struct ril_s *p, struct ril_msg *message)
 {
-	struct ril_notify *notify;
-	struct ril_notify_node *node;
+	int32_t *unsolicited_field, *id_num_field;
+	gchar *bufp = message->buf;
+	gsize hdr_len;
 
-	if (ril->notify_list == NULL)
-		return 0;
+	if (message->buf_len < 8) {
+		ofono_error("RIL error: incoming message with size %u",
+				(unsigned int) message->buf_len);
+		return;
+	}
 
-	if (func == NULL)
-		return 0;
+	/* This could be done with a struct/union... */
+	unsolicited_field = (int32_t *) (void *) bufp;
+	if (*unsolicited_field)
+		message->unsolicited = TRUE;
+	else
+		message->unsolicited = FALSE;
 
-	notify = g_hash_table_lookup(ril->notify_list, &req);
+	bufp += 4;
 
-	if (notify == NULL)
-		notify = ril_notify_create(ril, req);
+	id_num_field = (int32_t *) (void *) bufp;
+	if (message->unsolicited) {
+		message->req = (int) *id_num_field;
 
-	if (notify == NULL)
-		return 0;
+		/*
+		 * A RIL Unsolicited Event is two UINT32 fields ( unsolicited,
+		 * and req/ev ), so subtract the length of the header from the
+		 * overall length to calculate the length of the Event Data.
+		 */
+		hdr_len = 8;
+	} else {
+		if (message->buf_len < 12) {
+			ofono_error("RIL error: response with size %u",
+					(unsigned int) message->buf_len);
+			return;
+		}
+
+		message->serial_no = (int) *id_num_field;
+
+		bufp += 4;
+		message->error = *((int32_t *) (void *) bufp);
+
+		/*
+		 * A RIL Solicited Response is three UINT32 fields ( unsolicied,
+		 * serial_no and error ), so subtract the length of the header
+		 * from the overall length to calculate the length of the Event
+		 * Data.
+		 */
+		hdr_len = 12;
+	}
+
+	/* advance to start of data.. */
+	bufp += 4;
+
+	/*
+	 * The event data is parsed in place, straight from the read
+	 * buffer.  NULL lets the parsers know that there was no data.
+	 */
+	message->buf_len -= hdr_len;
+	message->buf = message->buf_len ? bufp : NULL;
+
+	if (message->unsolicited == FALSE)
+		handle_response(p, message);
+	else if (p->held)
+		ril_hold_unsol(p, message);
+	else
+		handle_unsol_req(p, message);
+}
+
+static gchar *ril_scratch_reserve(struct ril_s *p, gsize size)
+{
+	if (p->scratch_size < size) {
+		g_free(p->scratch);
+		p->scratch = g_malloc(size);
+		p->scratch_size = size;
+	}
+
+	return p->scratch;
+}
+
+/*
+ * Returns a pointer to the next len bytes of the ring buffer following
+ * offset.  Records that are contiguous and suitably aligned are used in
+ * place, otherwise they are gathered into the per-connection scratch
+ * buffer, which is reused for every record that needs it.
+ */
+static gchar *ril_record_ptr(struct ril_s *p, struct ring_buffer *rbuf,
+				unsigned int offset, unsigned int len)
+{
+	unsigned int wrap = ring_buffer_len_no_wrap(rbuf);
+	guchar *ptr = ring_buffer_read_ptr(rbuf, offset);
+	gchar *scratch;
+	unsigned int head;
+
+	if (offset + len <= wrap && ((uintptr_t) ptr & 3) == 0)
+		return (gchar *) ptr;
+
+	scratch = ril_scratch_reserve(p, len);
+
+	if (offset >= wrap) {
+		memcpy(scratch, ptr, len);
+		return scratch;
+	}
+
+	head = MIN(len, wrap - offset);
+	memcpy(scratch, ptr, head);
+	memcpy(scratch + head, ring_buffer_read_ptr(rbuf, wrap), len - head);
+
+	return scratch;
+}
+
+/*
+ * Records that do not fit in the ring buffer are reassembled in the
+ * scratch buffer as their bytes arrive.  Returns TRUE once the whole
+ * record has been read.
+ */
+static gboolean read_spilled_record(struct ril_s *p, struct ring_buffer *rbuf)
+{
+	unsigned int chunk = MIN((gsize) ring_buffer_len(rbuf),
+					p->spill_len - p->spill_read);
+
+	if (p->spill_discard)
+		ring_buffer_drain(rbuf, chunk);
+	else
+		ring_buffer_read(rbuf, p->scratch + p->spill_read, chunk);
+
+	p->spill_read += chunk;
+
+	return p->spill_read == p->spill_len;
+}
+
+static void new_bytes(struct ring_buffer *rbuf, gpointer user_data)
+{
+	struct ril_msg message;
+	struct ril_s *p = user_data;
+	unsigned int len, plen;
+	uint32_t net_len;
+
+	p->in_read_handler = TRUE;
+
+	while (p->suspended == FALSE) {
+		len = ring_buffer_len(rbuf);
+
+		if (p->spill_len) {
+			if (read_spilled_record(p, rbuf) == FALSE)
+				break;
+
+			plen = p->spill_len;
+			p->spill_len = 0;
+			p->stats.bytes_read += plen + 4;
+
+			if (p->spill_discard)
+				continue;
+
+			memset(&message, 0, sizeof(message));
+			message.buf_len = plen;
+			message.buf = p->scratch;
+
+			dispatch(p, &message);
+			continue;
+		}
+
+		if (len < 4) {
+			DBG("Not enough bytes for header length: len: %d", len);
+			break;
+		}
+
+		/* First four bytes are length in TCP byte order (Big Endian) */
+		memcpy(&net_len, ril_record_ptr(p, rbuf, 0, 4), 4);
+		plen = ntohl(net_len);
+
+		/*
+		 * Records bigger than the ring buffer are streamed into the
+		 * scratch buffer.  Anything beyond RIL_MAX_RECORD_SIZE is
+		 * assumed bogus and skipped, the stream stays in sync.
+		 */
+		if (plen > (unsigned int) ring_buffer_capacity(rbuf) - 4) {
+			ring_buffer_drain(rbuf, 4);
+
+			p->spill_len = plen;
+			p->spill_read = 0;
+			p->spill_discard = plen > RIL_MAX_RECORD_SIZE;
+
+			if (p->spill_discard)
+				ofono_error("RIL parcel too big (%u), dropping",
+						plen);
+			else
+				ril_scratch_reserve(p, plen);
+
+			continue;
+		}
+
+		/* wait for the rest of the record... */
+		if (len - 4 < plen)
+			break;
+
+		memset(&message, 0, sizeof(message));
+		message.buf_len = plen;
+		message.buf = ril_record_ptr(p, rbuf, 4, plen);
+
+		dispatch(p, &message);
+
+		/* The record is only released once it has been dispatched */
+		ring_buffer_drain(rbuf, plen + 4);
+		p->stats.bytes_read += plen + 4;
+	}
+
+	p->in_read_handler = FALSE;
+
+	if (p->destroyed)
+		ril_free(p);
+}
+
+/*
+ * This function is a GIOFunc and may be called directly or via an IO watch.
+ * The return value controls whether the watch stays active ( TRUE ), or is
+ * removed ( FALSE ).
+ *
+ * Requests are taken from the scheduler into command_queue and several
+ * of them are gathered into a single writev(), bounded by
+ * RIL_MAX_WRITE_BATCH requests and RIL_MAX_WRITE_BYTES bytes so a big
+ * burst does not hog the main loop or delay urgent requests for long.
+ */
+static gboolean can_write_data(gpointer data)
+{
+	struct ril_s *ril = data;
+	struct iovec iov[RIL_MAX_WRITE_BATCH];
+	struct ril_request *req;
+	gsize batch_len = 0;
+	gsize towrite;
+	gssize bytes_written;
+	guint offset;
+	gint64 now;
+	GList *l;
+	int n = 0;
+
+	l = g_queue_peek_head_link(ril->command_queue);
+
+	while (n < RIL_MAX_WRITE_BATCH && batch_len < RIL_MAX_WRITE_BYTES) {
+		if (l != NULL) {
+			req = l->data;
+			l = l->next;
+		} else {
+			req = ril_tx_pop(ril);
+			if (req == NULL)
+				break;
+
+			g_queue_push_tail(ril->command_queue, req);
+			req->link = g_queue_peek_tail_link(ril->command_queue);
+		}
+
+		offset = n == 0 ? ril->req_bytes_written : 0;
+
+		iov[n].iov_base = req->data + offset;
+		iov[n].iov_len = req->data_len - offset;
+
+		batch_len += iov[n].iov_len;
+		n += 1;
+
+#ifdef WRITE_SCHEDULER_DEBUG
+		if (iov[0].iov_len > 5)
+			iov[0].iov_len = 5;
+
+		break;
+#endif
+	}
+
+	if (n == 0)
+		return FALSE;
+
+	bytes_written = g_ril_io_writev(ril->io, iov, n);
+	if (bytes_written < 0)
+		return FALSE;
+
+	ril->stats.bytes_written += bytes_written;
+	now = g_get_monotonic_time();
+
+	/* Retire every request fully written */
+	while (bytes_written > 0) {
+		req = g_queue_peek_head(ril->command_queue);
+		req->sent = TRUE;
+
+		towrite = req->data_len - ril->req_bytes_written;
+		if ((gsize) bytes_written < towrite) {
+			ril->req_bytes_written += bytes_written;
+			break;
+		}
+
+		bytes_written -= towrite;
+		ril->req_bytes_written = 0;
+		req->write_time = now;
+
+		g_queue_pop_head(ril->command_queue);
+		req->link = NULL;
+	}
+
+	return !g_queue_is_empty(ril->command_queue) || ril->tx_queued > 0;
+}
+
+static void ril_wakeup_writer(struct ril_s *ril)
+{
+	/* Session slots keep queueing while rild is away */
+	if (ril->io == NULL)
+		return;
+
+	g_ril_io_set_write_handler(ril->io, can_write_data, ril);
+}
+
+static void ril_suspend(struct ril_s *ril)
+{
+	ril->suspended = TRUE;
+
+	g_ril_io_set_write_handler(ril->io, NULL, NULL);
+	g_ril_io_set_read_handler(ril->io, NULL, NULL);
+	g_ril_io_set_debug(ril->io, NULL, NULL);
+}
+
+static gboolean ril_set_debug(struct ril_s *ril,
+				GRilDebugFunc func, gpointer user_data)
+{
+	ril->debugf = func;
+	ril->debug_data = user_data;
+
+	if (ril->io == NULL)
+		return FALSE;
+
+	g_ril_io_set_debug(ril->io, func, user_data);
+
+	return TRUE;
+}
+
+static void ril_unref(struct ril_s *ril)
+{
+	gboolean is_zero;
+
+	is_zero = g_atomic_int_dec_and_test(&ril->ref_count);
+
+	if (is_zero == FALSE)
+		return;
+
+	if (ril->io) {
+		ril_suspend(ril);
+		g_ril_io_unref(ril->io);
+		ril->io = NULL;
+	}
+
+	ril_cleanup(ril);
+
+	if (ril->in_read_handler)
+		ril->destroyed = TRUE;
+	else
+		ril_free(ril);
+}
+
+static gboolean node_compare_by_group(struct ril_notify_node *node,
+					gpointer userdata)
+{
+	guint group = GPOINTER_TO_UINT(userdata);
+
+	if (node->gid == group)
+		return TRUE;
+
+	return FALSE;
+}
+
+static void set_process_id(gid_t gid, uid_t uid)
+{
+	if (setegid(gid) < 0)
+		ofono_error("%s: setegid(%d) failed: %s (%d)",
+				__func__, gid, strerror(errno), errno);
+
+	if (seteuid(uid) < 0)
+		ofono_error("%s: seteuid(%d) failed: %s (%d)",
+				__func__, uid, strerror(errno), errno);
+}
+
+static GIOChannel *ril_socket_connect(const char *sock_path)
+{
+	struct sockaddr_un addr;
+	GIOChannel *io;
+	int sk;
+
+	sk = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sk < 0) {
+		ofono_error("%s: can't create unix socket: %s (%d)",
+				__func__, strerror(errno), errno);
+		return NULL;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+
+	/* RIL expects user radio to connect to the socket */
+	set_process_id(RADIO_GID, RADIO_UID);
+
+	if (connect(sk, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		ofono_error("%s: can't connect to %s: %s (%d)",
+				__func__, sock_path, strerror(errno), errno);
+		/* Switch back to root */
+		set_process_id(0, 0);
+		close(sk);
+		return NULL;
+	}
+
+	/* Switch back to root */
+	set_process_id(0, 0);
+
+	io = g_io_channel_unix_new(sk);
+	if (io == NULL) {
+		ofono_error("%s: can't open RILD io channel: %s (%d)",
+				__func__, strerror(errno), errno);
+		close(sk);
+		return NULL;
+	}
+
+	g_io_channel_set_close_on_unref(io, TRUE);
+	g_io_channel_set_flags(io, G_IO_FLAG_NONBLOCK, NULL);
+
+	return io;
+}
+
+static gboolean ril_connect(struct ril_s *ril)
+{
+	GIOChannel *io;
+
+	io = ril_socket_connect(ril->sock_path);
+	if (io == NULL)
+		return FALSE;
+
+	ril->io = g_ril_io_new(io);
+	g_io_channel_unref(io);
+
+	if (ril->io == NULL) {
+		ofono_error("%s: can't create ril->io", __func__);
+		return FALSE;
+	}
+
+	g_ril_io_set_disconnect_function(ril->io, io_disconnect, ril);
+	g_ril_io_set_read_handler(ril->io, new_bytes, ril);
+
+	if (ril->debugf)
+		g_ril_io_set_debug(ril->io, ril->debugf, ril->debug_data);
+
+	return TRUE;
+}
+
+static struct ril_s *create_ril(const char *sock_path)
+
+{
+	struct ril_s *ril;
+	int i;
+
+	ril = g_try_new0(struct ril_s, 1);
+	if (ril == NULL)
+		return ril;
+
+	ril->ref_count = 1;
+	ril->next_cmd_id = 1;
+	ril->next_notify_id = 1;
+	ril->next_gid = 0;
+	ril->req_bytes_written = 0;
+	ril->trace = FALSE;
+	ril->timeout = RIL_DEFAULT_TIMEOUT;
+	g_queue_init(&ril->held_unsol);
+
+	/* sock_path is allowed to be NULL for unit tests */
+	if (sock_path == NULL)
+		return ril;
+
+	ril->sock_path = g_strdup(sock_path);
+
+	ril->command_queue = g_queue_new();
+	if (ril->command_queue == NULL) {
+		ofono_error("create_ril: Couldn't create command_queue.");
+		goto error;
+	}
+
+	ril->pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ril->timeouts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ril->latency = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+						NULL, g_free);
+
+	for (i = 0; i < RIL_WHEEL_SLOTS; i++)
+		g_queue_init(&ril->wheel[i]);
+	ril->tx_groups = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+						NULL, g_free);
+
+	for (i = 0; i < G_RIL_PRIORITY_LAST; i++)
+		g_queue_init(&ril->tx_ready[i]);
+
+	ril->notify_list = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+							NULL,
+							ril_notify_destroy);
+	ril->notify_nodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	if (ril_connect(ril) == FALSE)
+		goto error;
+
+	return ril;
+
+error:
+	ril_unref(ril);
+
+	return NULL;
+}
+
+static struct ril_notify *ril_notify_create(struct ril_s *ril,
+						const int req)
+{
+	struct ril_notify *notify;
+
+	notify = g_try_new0(struct ril_notify, 1);
+	if (notify == NULL)
+		return 0;
+
+	notify->req = req;
+	notify->nodes = g_ptr_array_new();
+
+	g_hash_table_insert(ril->notify_list, GINT_TO_POINTER(req), notify);
+
+	return notify;
+}
+
+static void ril_cancel_group(struct ril_s *ril, guint group)
+{
+	GHashTableIter iter;
+	struct ril_request *req;
+	gpointer key, value;
+	GSList *cancelled = NULL;
+	GSList *l;
+
+	if (ril->pending == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, ril->pending);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		req = value;
+
+		if (req->id == 0 || req->gid != group)
+			continue;
+
+		req->callback = NULL;
+
+		/* Already on the wire, wait for the reply to drop it */
+		if (req->sent)
+			continue;
+
+		ril_request_unlink(ril, req);
+		g_hash_table_iter_remove(&iter);
+		cancelled = g_slist_prepend(cancelled, req);
+	}
+
+	/* Destroy notifiers are free to queue new requests */
+	for (l = cancelled; l; l = l->next)
+		ril_request_destroy(l->data);
+
+	g_slist_free(cancelled);
+}
+
+static guint ril_register(struct ril_s *ril, guint group,
+				const int req, GRilNotifyFunc func,
+				gpointer user_data)
+{
+	struct ril_notify *notify;
+	struct ril_notify_node *node;
+
+	if (ril->notify_list == NULL)
+		return 0;
+
+	if (func == NULL)
+		return 0;
+
+	notify = g_hash_table_lookup(ril->notify_list, GINT_TO_POINTER(req));
+
+	if (notify == NULL)
+		notify = ril_notify_create(ril, req);
+
+	if (notify == NULL)
+		return 0;
+
+	node = g_try_new0(struct ril_notify_node, 1);
+	if (node == NULL)
+		return 0;
+
+	node->id = ril->next_notify_id++;
+	node->gid = group;
+	node->notify = notify;
+	node->callback = func;
+	node->user_data = user_data;
+
+	g_ptr_array_add(notify->nodes, node);
+	g_hash_table_insert(ril->notify_nodes, GUINT_TO_POINTER(node->id),
+				node);
+
+	return node->id;
+}
+
+static gboolean ril_unregister(struct ril_s *ril, gboolean mark_only,
+					guint group, guint id)
+{
+	struct ril_notify_node *node;
+
+	if (ril->notify_nodes == NULL)
+		return FALSE;
+
+	node = g_hash_table_lookup(ril->notify_nodes, GUINT_TO_POINTER(id));
+	if (node == NULL)
+		return FALSE;
+
+	if (node->gid != group)
+		return FALSE;
+
+	if (mark_only)
+		ril_notify_mark(ril, node);
+	else
+		ril_notify_node_remove(ril, node);
+
+	return TRUE;
+}
+
+void g_ril_init_parcel(const struct ril_msg *message, struct parcel *rilp)
+{
+	/* Set up Parcel struct for proper parsing */
+	rilp->data = message->buf;
+	rilp->size = message->buf_len;
+	rilp->capacity = message->buf_len;
+	rilp->offset = 0;
+	rilp->malformed = 0;
+}
+
+GRil *g_ril_new(const char *sock_path, enum ofono_ril_vendor vendor)
+{
+	GRil *ril;
+
+	ril = g_try_new0(GRil, 1);
+	if (ril == NULL)
+		return NULL;
+
+	ril->parent = create_ril(sock_path);
+	if (ril->parent == NULL) {
+		g_free(ril);
+		return NULL;
+	}
+
+	ril->group = ril->parent->next_gid++;
+	ril->ref_count = 1;
+
+	ril->parent->vendor = vendor;
+	ril->parent->version = RIL_VERSION_UNSPECIFIED;
+	ril->parent->max_data_calls = RIL_DEFAULT_NUM_DATA_CALLS;
+
+	return ril;
+}
+
+GRil *g_ril_clone(GRil *clone)
+{
+	GRil *ril;
+
+	if (clone == NULL)
+		return NULL;
+
+	ril = g_try_new0(GRil, 1);
+	if (ril == NULL)
+		return NULL;
+
+	ril->parent = clone->parent;
+	ril->group = ril->parent->next_gid++;
+	ril->ref_count = 1;
+	g_atomic_int_inc(&ril->parent->ref_count);
+
+	return ril;
+}
+
+GIOChannel *g_ril_get_channel(GRil *ril)
+{
+	if (ril == NULL || ril->parent->io == NULL)
+		return NULL;
+
+	return g_ril_io_get_channel(ril->parent->io);
+
+}
+
+GRilIO *g_ril_get_io(GRil *ril)
+{
+	if (ril == NULL)
+		return NULL;
+
+	return ril->parent->io;
+}
+
+GRil *g_ril_ref(GRil *ril)
+{
+	if (ril == NULL)
+		return NULL;
+
+	g_atomic_int_inc(&ril->ref_count);
+
+	return ril;
+}
+
+gint g_ril_send_with_priority(GRil *ril, const gint reqid,
+				struct parcel *rilp, GRilResponseFunc func,
+				gpointer user_data, GDestroyNotify notify,
+				enum g_ril_priority priority)
+{
+	struct ril_request *r;
+	struct ril_s *p;
+	guint timeout;
+
+	if (ril == NULL
+		|| ril->parent == NULL
+		|| ril->parent->command_queue == NULL)
+			return 0;
+
+	if (priority >= G_RIL_PRIORITY_LAST)
+		priority = G_RIL_PRIORITY_DEFAULT;
+
+	p = ril->parent;
+
+	r = ril_request_create(p, ril->group, priority, reqid, p->next_cmd_id,
+				rilp, func, user_data, notify, FALSE);
+
+	if (rilp != NULL)
+		parcel_free(rilp);
+
+	if (r == NULL)
+		return 0;
+
+	p->next_cmd_id++;
+	p->stats.requests += 1;
+
+	r->enqueue_time = g_get_monotonic_time();
+	g_hash_table_insert(p->pending, GINT_TO_POINTER(r->id), r);
+	ril_tx_push(p, r, FALSE);
+
+	ril_trace_record(p, RIL_TRACE_REQUEST, r->id, reqid, 0,
+				r->data + sizeof(struct req_hdr),
+				r->data_len - sizeof(struct req_hdr));
+
+	timeout = ril_request_timeout(p, reqid);
+	if (timeout > 0)
+		ril_wheel_add(p, r, timeout);
+
+	ril_wakeup_writer(p);
+
+	if (rilp == NULL)
+		g_ril_print_request_no_args(ril, r->id, reqid);
+	else
+		g_ril_print_request(ril, r->id, reqid);
+
+	return r->id;
+}
+
+gint g_ril_send(GRil *ril, const gint reqid, struct parcel *rilp,
+		GRilResponseFunc func, gpointer user_data,
+		GDestroyNotify notify)
+{
+	return g_ril_send_with_priority(ril, reqid, rilp, func, user_data,
+					notify, ril_request_priority(reqid));
+}
+
+void g_ril_unref(GRil *ril)
+{
+	gboolean is_zero;
+
+	if (ril == NULL)
+		return;
+
+	is_zero = g_atomic_int_dec_and_test(&ril->ref_count);
+
+	if (is_zero == FALSE)
+		return;
+
+	ril_cancel_group(ril->parent, ril->group);
+	g_ril_unregister_all(ril);
+	ril_unref(ril->parent);
+
+	g_free(ril);
+}
+
+gboolean g_ril_get_trace(GRil *ril)
+{
+
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	return ril->parent->trace;
+}
+
+gboolean g_ril_set_trace(GRil *ril, gboolean trace)
+{
+
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	return ril->parent->trace = trace;
+}
+
+static gboolean session_set_trace_ring(GRilSession *session, guint entries)
+{
+	GSList *l;
+
+	trace_ring_free(session->trace_ring);
+	session->trace_ring = NULL;
+
+	if (entries > 0)
+		session->trace_ring = trace_ring_new(entries);
+
+	for (l = session->slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
+
+		ril->trace_ring = session->trace_ring;
+	}
+
+	return entries == 0 || session->trace_ring != NULL;
+}
+
+gboolean g_ril_set_trace_ring(GRil *ril, guint entries)
+{
+	struct ril_s *p;
+
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	p = ril->parent;
+
+	if (p->session != NULL)
+		return session_set_trace_ring(p->session, entries);
+
+	trace_ring_free(p->trace_ring);
+	p->trace_ring = NULL;
+
+	if (entries == 0)
+		return TRUE;
+
+	p->trace_ring = trace_ring_new(entries);
+
+	return p->trace_ring != NULL;
+}
+
+gboolean g_ril_trace_ring_foreach(GRil *ril, GRilTraceFunc func,
+					gpointer user_data)
+{
+	if (ril == NULL || ril->parent == NULL || func == NULL)
+		return FALSE;
+
+	if (ril->parent->trace_ring == NULL)
+		return FALSE;
+
+	ril_trace_foreach(ril->parent, func, user_data);
+
+	return TRUE;
+}
+
+void g_ril_trace_ring_dump(GRil *ril)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return;
+
+	ril_trace_dump(ril->parent);
+}
+
+static void print_buf_vprintf(gsize offset, const char *fmt, va_list ap)
+{
+	int len;
+
+	len = vsnprintf(print_buf + offset, RIL_PRINT_BUF_SIZE - offset,
+			fmt, ap);
+	if (len < 0)
+		len = 0;
+
+	print_buf_len = MIN(offset + len, RIL_PRINT_BUF_SIZE - 1);
+}
+
+void g_ril_print_buf_start(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	print_buf_vprintf(0, fmt, ap);
+	va_end(ap);
+}
+
+void g_ril_print_buf_append(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	print_buf_vprintf(print_buf_len, fmt, ap);
+	va_end(ap);
+}
+
+gboolean g_ril_set_coalesce(GRil *ril, int unsol, guint window)
+{
+	struct ril_s *p;
+	struct ril_coalesce *c;
+
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	p = ril->parent;
+
+	if (p->coalesce == NULL) {
+		if (window == 0)
+			return TRUE;
+
+		p->coalesce = g_hash_table_new_full(g_direct_hash,
+							g_direct_equal, NULL,
+							ril_coalesce_destroy);
+	}
+
+	c = g_hash_table_lookup(p->coalesce, GINT_TO_POINTER(unsol));
+	if (c == NULL) {
+		if (window == 0)
+			return TRUE;
+
+		c = g_new0(struct ril_coalesce, 1);
+		c->ril = p;
+		c->req = unsol;
+		g_hash_table_insert(p->coalesce, GINT_TO_POINTER(unsol), c);
+	}
+
+	/*
+	 * Entries are never freed before the GRil is gone, the window
+	 * timer only stops once a held message has been delivered.
+	 */
+	c->window = window;
+
+	return TRUE;
+}
+
+gboolean g_ril_get_io_stats(GRil *ril, struct ril_io_stats *stats)
+{
+	if (ril == NULL || ril->parent == NULL || stats == NULL)
+		return FALSE;
+
+	*stats = ril->parent->stats;
+
+	return TRUE;
+}
+
+gboolean g_ril_latency_foreach(GRil *ril, GRilLatencyFunc func,
+				gpointer user_data)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (ril == NULL || ril->parent == NULL || func == NULL)
+		return FALSE;
+
+	if (ril->parent->latency == NULL)
+		return FALSE;
+
+	g_hash_table_iter_init(&iter, ril->parent->latency);
+
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		func(GPOINTER_TO_INT(key), value, user_data);
+
+	return TRUE;
+}
+
+void g_ril_reset_stats(GRil *ril)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return;
+
+	memset(&ril->parent->stats, 0, sizeof(ril->parent->stats));
+
+	if (ril->parent->latency)
+		g_hash_table_remove_all(ril->parent->latency);
+
+	if (ril->parent->timeouts)
+		g_hash_table_remove_all(ril->parent->timeouts);
+}
+
+gboolean g_ril_set_timeout(GRil *ril, guint timeout)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	ril->parent->timeout = timeout;
+	return TRUE;
+}
+
+guint g_ril_get_timeout_count(GRil *ril, int req)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return 0;
+
+	if (req < 0)
+		return ril->parent->stats.timeouts;
+
+	return GPOINTER_TO_UINT(g_hash_table_lookup(ril->parent->timeouts,
+							GINT_TO_POINTER(req)));
+}
+
+gboolean g_ril_set_slot(GRil *ril, int slot)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	ril->parent->slot = slot;
+	return TRUE;
+}
+
+int g_ril_get_slot(GRil *ril)
+{
+	if (ril == NULL)
+		return 0;
+
+	return ril->parent->slot;
+}
+
+gboolean g_ril_set_version(GRil *ril, int version)
+{
+	if (ril == NULL || ril->parent == NULL ||
+			ril->parent->version != RIL_VERSION_UNSPECIFIED)
+		return FALSE;
+
+	ril->parent->version = version;
+	return TRUE;
+}
+
+int g_ril_get_version(GRil *ril)
+{
+	if (ril == NULL)
+		return RIL_VERSION_UNSPECIFIED;
+
+	return ril->parent->version;
+}
+
+gboolean g_ril_set_max_data_calls(GRil *ril, unsigned int max)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	if (max == 0 || max > RIL_MAX_NUM_DATA_CALLS)
+		return FALSE;
+
+	ril->parent->max_data_calls = max;
+	return TRUE;
+}
+
+unsigned int g_ril_get_max_data_calls(GRil *ril)
+{
+	if (ril == NULL)
+		return RIL_DEFAULT_NUM_DATA_CALLS;
+
+	return ril->parent->max_data_calls;
+}
+
+gboolean g_ril_set_debugf(GRil *ril,
+			GRilDebugFunc func, gpointer user_data)
+{
+
+	if (ril == NULL || ril->group != 0)
+		return FALSE;
+
+	return ril_set_debug(ril->parent, func, user_data);
+}
+
+gboolean g_ril_set_vendor_print_msg_id_funcs(GRil *ril,
+					GRilMsgIdToStrFunc req_to_string,
+					GRilMsgIdToStrFunc unsol_to_string)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	ril->parent->req_to_string = req_to_string;
+	ril->parent->unsol_to_string = unsol_to_string;
+
+	return TRUE;
+}
+
+guint g_ril_register(GRil *ril, const int req,
+			GRilNotifyFunc func, gpointer user_data)
+{
+	if (ril == NULL)
+		return 0;
+
+	return ril_register(ril->parent, ril->group, req,
+				func, user_data);
+}
+
+gboolean g_ril_unregister(GRil *ril, guint id)
+{
+	if (ril == NULL)
+		return FALSE;
+
+	return ril_unregister(ril->parent, ril->parent->in_notify,
+					ril->group, id);
+}
+
+gboolean g_ril_unregister_all(GRil *ril)
+{
+	if (ril == NULL)
+		return FALSE;
+
+	return ril_unregister_all(ril->parent,
+					ril->parent->in_notify,
+					node_compare_by_group,
+					GUINT_TO_POINTER(ril->group));
+}
+
+enum ofono_ril_vendor g_ril_vendor(GRil *ril)
+{
+	if (ril == NULL)
+		return OFONO_RIL_VENDOR_AOSP;
+
+	return ril->parent->vendor;
+}
+
+const char *g_ril_request_id_to_string(GRil *ril, int req)
+{
+	return request_id_to_string(ril->parent, req);
+}
+
+const char *g_ril_unsol_request_to_string(GRil *ril, int req)
+{
+	return unsol_request_to_string(ril->parent, req);
+}
+
+gboolean g_ril_is_connected(GRil *ril)
+{
+	if (ril == NULL || ril->parent == NULL)
+		return FALSE;
+
+	return ril->parent->io != NULL;
+}
+
+static gint request_id_compare(gconstpointer a, gconstpointer b)
+{
+	const struct ril_request *ra = a;
+	const struct ril_request *rb = b;
+
+	return ra->id - rb->id;
+}
+
+/* Fails what rild took but will never answer, in the order it was sent */
+static void ril_fail_sent(struct ril_s *ril)
+{
+	GHashTableIter iter;
+	struct ril_request *req;
+	struct ril_msg message;
+	gpointer key, value;
+	GSList *failed = NULL;
+	GSList *l;
+
+	g_hash_table_iter_init(&iter, ril->pending);
+
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		req = value;
+
+		if (req->sent == FALSE)
+			continue;
+
+		ril_request_unlink(ril, req);
+		g_hash_table_iter_remove(&iter);
+		failed = g_slist_prepend(failed, req);
+	}
+
+	ril->req_bytes_written = 0;
+	failed = g_slist_sort(failed, request_id_compare);
+
+	for (l = failed; l; l = l->next) {
+		req = l->data;
+
+		memset(&message, 0, sizeof(message));
+		message.req = req->req;
+		message.serial_no = req->id;
+		message.error = RIL_E_RADIO_NOT_AVAILABLE;
+
+		if (req->callback)
+			req->callback(&message, req->user_data);
+
+		ril_request_destroy(req);
+	}
+
+	g_slist_free(failed);
+}
+
+/*
+ * Requests picked for writing but not written yet go back to the head
+ * of their queue, so a held slot does not write them before release.
+ */
+static void ril_requeue_unsent(struct ril_s *ril)
+{
+	struct ril_request *req;
+
+	while ((req = g_queue_pop_tail(ril->command_queue))) {
+		req->link = NULL;
+		ril_tx_push(ril, req, TRUE);
+	}
+}
+
+static gboolean session_reconnect(gpointer user_data);
+
+static void session_schedule_reconnect(GRilSession *session)
+{
+	if (session->reconnect_source != 0)
+		return;
+
+	session->reconnect_source = g_timeout_add(session->reconnect_interval,
+							session_reconnect,
+							session);
+}
+
+static void session_slot_disconnected(struct ril_s *ril)
+{
+	g_ril_io_unref(ril->io);
+	ril->io = NULL;
+
+	/* Whatever was half way through the socket is lost */
+	ril->spill_len = 0;
+	ril_held_clear(ril);
+	ril->held = ril->session->hold;
+	ril->release_pending = FALSE;
+
+	/* Callbacks are free to drop the session, and with it the slot */
+	g_atomic_int_inc(&ril->ref_count);
 
-	node = g_try_new0(struct ril_notify_node, 1);
-	if (node == NULL)
-		return 0;
+	ril_fail_sent(ril);
+	ril_requeue_unsent(ril);
 
-	node->id = ril->next_notify_id++;
-	node->gid = group;
-	node->callback = func;
-	node->user_data = user_data;
+	if (ril->user_disconnect)
+		ril->user_disconnect(ril->user_disconnect_data);
 
-	notify->nodes = g_slist_prepend(notify->nodes, node);
+	if (ril->session != NULL)
+		session_schedule_reconnect(ril->session);
 
-	return node->id;
+	ril_unref(ril);
 }
 
-static gboolean ril_unregister(struct ril_s *ril, gboolean mark_only,
-					guint group, guint id)
+static gboolean session_reconnect(gpointer user_data)
 {
-	GHashTableIter iter;
-	struct ril_notify *notify;
-	struct ril_notify_node *node;
-	gpointer key, value;
+	GRilSession *session = user_data;
+	gboolean retry = FALSE;
+	GSList *slots;
 	GSList *l;
 
-	if (ril->notify_list == NULL)
-		return FALSE;
+	session->reconnect_source = 0;
 
-	g_hash_table_iter_init(&iter, ril->notify_list);
+	g_ril_session_ref(session);
+	slots = g_slist_copy(session->slots);
 
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		notify = value;
+	for (l = slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
 
-		l = g_slist_find_custom(notify->nodes, GUINT_TO_POINTER(id),
-					ril_notify_node_compare_by_id);
+		if (ril->io != NULL)
+			continue;
 
-		if (l == NULL)
+		if (ril_connect(ril) == FALSE) {
+			retry = TRUE;
 			continue;
+		}
 
-		node = l->data;
+		ril->stats.reconnects += 1;
+		ril->held = session->hold;
+		ril->release_pending = FALSE;
 
-		if (node->gid != group)
-			return FALSE;
+		ofono_info("Slot %d reconnected to %s", ril->slot,
+				ril->sock_path);
 
-		if (mark_only) {
-			node->destroyed = TRUE;
-			return TRUE;
-		}
+		if (session->connect)
+			session->connect(ril->slot, session->connect_data);
 
-		ril_notify_node_destroy(node, NULL);
-		notify->nodes = g_slist_remove(notify->nodes, node);
+		ril_wakeup_writer(ril);
+	}
 
-		if (notify->nodes == NULL)
-			g_hash_table_iter_remove(&iter);
+	g_slist_free(slots);
 
-		return TRUE;
+	if (retry) {
+		session->reconnect_interval = MIN(RIL_RECONNECT_MAX_MS,
+					session->reconnect_interval * 2);
+		session_schedule_reconnect(session);
+	} else {
+		session->reconnect_interval = RIL_RECONNECT_MIN_MS;
 	}
 
+	g_ril_session_unref(session);
+
 	return FALSE;
 }
 
-void g_ril_init_parcel(const struct ril_msg *message, struct parcel *rilp)
+static gboolean session_tick(gpointer user_data)
 {
-	/* Set up Parcel struct for proper parsing */
-	rilp->data = message->buf;
-	rilp->size = message->buf_len;
-	rilp->capacity = message->buf_len;
-	rilp->offset = 0;
-	rilp->malformed = 0;
-}
+	GRilSession *session = user_data;
+	gboolean again = FALSE;
+	GSList *l;
 
-GRil *g_ril_new(const char *sock_path, enum ofono_ril_vendor vendor)
-{
-	GRil *ril;
+	/* The session references the slots, the callbacks can't free them */
+	g_ril_session_ref(session);
 
-	ril = g_try_new0(GRil, 1);
-	if (ril == NULL)
-		return NULL;
+	for (l = session->slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
 
-	ril->parent = create_ril(sock_path);
-	if (ril->parent == NULL) {
-		g_free(ril);
-		return NULL;
+		if (ril->wheel_count == 0)
+			continue;
+
+		ril_wheel_advance(ril);
+
+		if (ril->wheel_count > 0)
+			again = TRUE;
 	}
 
-	ril->group = ril->parent->next_gid++;
-	ril->ref_count = 1;
+	if (again == FALSE)
+		session->tick_source = 0;
 
-	ril->parent->vendor = vendor;
-	ril->parent->version = RIL_VERSION_UNSPECIFIED;
+	g_ril_session_unref(session);
 
-	return ril;
+	return again;
 }
 
-GRil *g_ril_clone(GRil *clone)
+static void session_start_tick(GRilSession *session)
 {
-	GRil *ril;
+	if (session->tick_source != 0)
+		return;
 
-	if (clone == NULL)
-		return NULL;
+	session->tick_source = g_timeout_add_seconds(1, session_tick, session);
+}
 
-	ril = g_try_new0(GRil, 1);
-	if (ril == NULL)
-		return NULL;
+static gboolean ril_has_sent(struct ril_s *ril)
+{
+	GHashTableIter iter;
+	gpointer key, value;
 
-	ril->parent = clone->parent;
-	ril->group = ril->parent->next_gid++;
-	ril->ref_count = 1;
-	g_atomic_int_inc(&ril->parent->ref_count);
+	g_hash_table_iter_init(&iter, ril->pending);
 
-	return ril;
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct ril_request *req = value;
+
+		if (req->sent)
+			return TRUE;
+	}
+
+	return FALSE;
 }
 
-GIOChannel *g_ril_get_channel(GRil *ril)
+static gboolean session_can_swap(struct ril_s *a, struct ril_s *b)
 {
-	if (ril == NULL || ril->parent->io == NULL)
-		return NULL;
+	if (a->io == NULL || b->io == NULL)
+		return FALSE;
 
-	return g_ril_io_get_channel(ril->parent->io);
+	if (a->held == FALSE || b->held == FALSE)
+		return FALSE;
+
+	if (a->spill_len || b->spill_len)
+		return FALSE;
 
+	return ril_has_sent(a) == FALSE && ril_has_sent(b) == FALSE;
 }
 
-GRilIO *g_ril_get_io(GRil *ril)
+static void ril_attach_io(struct ril_s *ril, GRilIO *io)
 {
-	if (ril == NULL)
-		return NULL;
+	ril->io = io;
 
-	return ril->parent->io;
+	g_ril_io_set_disconnect_function(io, io_disconnect, ril);
+	g_ril_io_set_read_handler(io, new_bytes, ril);
+	g_ril_io_set_write_handler(io, NULL, NULL);
+	g_ril_io_set_debug(io, ril->debugf, ril->debug_data);
 }
 
-GRil *g_ril_ref(GRil *ril)
+static void session_swap(struct ril_s *a, struct ril_s *b)
 {
-	if (ril == NULL)
-		return NULL;
+	GRilIO *io = a->io;
+	gchar *sock_path = a->sock_path;
+	GQueue held_unsol = a->held_unsol;
 
-	g_atomic_int_inc(&ril->ref_count);
+	ofono_info("Slot %d now on %s, slot %d on %s", a->slot, b->sock_path,
+			b->slot, a->sock_path);
 
-	return ril;
+	ril_attach_io(a, b->io);
+	ril_attach_io(b, io);
+
+	a->sock_path = b->sock_path;
+	b->sock_path = sock_path;
+
+	/* Held events came from the socket, they follow it */
+	a->held_unsol = b->held_unsol;
+	b->held_unsol = held_unsol;
+
+	ril_wakeup_writer(a);
+	ril_wakeup_writer(b);
 }
 
-gint g_ril_send(GRil *ril, const gint reqid, struct parcel *rilp,
-		GRilResponseFunc func, gpointer user_data,
-		GDestroyNotify notify)
+static void ril_release(struct ril_s *ril)
 {
-	struct ril_request *r;
-	struct ril_s *p;
+	struct ril_msg *message;
 
-	if (ril == NULL
-		|| ril->parent == NULL
-		|| ril->parent->command_queue == NULL)
-			return 0;
+	ril->release_pending = FALSE;
+	ril->held = FALSE;
 
-	p = ril->parent;
+	while ((message = g_queue_pop_head(&ril->held_unsol))) {
+		handle_unsol_req(ril, message);
+
+		g_free(message->buf);
+		g_free(message);
+	}
 
-	r = ril_request_create(p, ril->group, reqid, p->next_cmd_id, rilp,
-				func, user_data, notify, FALSE);
+	ril_wakeup_writer(ril);
+}
 
-	if (rilp != NULL)
-		parcel_free(rilp);
+static gboolean session_idle(gpointer user_data)
+{
+	GRilSession *session = user_data;
+	GSList *l;
 
-	if (r == NULL)
-		return 0;
+	session->idle_source = 0;
 
-	p->next_cmd_id++;
+	g_ril_session_ref(session);
 
-	g_queue_push_tail(p->command_queue, r);
+	if (session->swap_a != NULL) {
+		if (session_can_swap(session->swap_a, session->swap_b))
+			session_swap(session->swap_a, session->swap_b);
+		else
+			ofono_error("%s: slots %d and %d can't be swapped",
+					__func__, session->swap_a->slot,
+					session->swap_b->slot);
 
-	ril_wakeup_writer(p);
+		session->swap_a = NULL;
+		session->swap_b = NULL;
+	}
 
-	if (rilp == NULL)
-		g_ril_print_request_no_args(ril, r->id, reqid);
-	else
-		g_ril_print_request(ril, r->id, reqid);
+	for (l = session->slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
 
-	return r->id;
+		if (ril->release_pending)
+			ril_release(ril);
+	}
+
+	g_ril_session_unref(session);
+
+	return FALSE;
 }
 
-void g_ril_unref(GRil *ril)
+static void session_schedule_idle(GRilSession *session)
 {
-	gboolean is_zero;
-
-	if (ril == NULL)
-		return;
+	if (session->idle_source == 0)
+		session->idle_source = g_idle_add(session_idle, session);
+}
 
-	is_zero = g_atomic_int_dec_and_test(&ril->ref_count);
+static struct ril_s *session_find_slot(GRilSession *session, int slot)
+{
+	GSList *l;
 
-	if (is_zero == FALSE)
-		return;
+	for (l = session->slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
 
-	ril_cancel_group(ril->parent, ril->group);
-	g_ril_unregister_all(ril);
-	ril_unref(ril->parent);
+		if (ril->slot == slot)
+			return ril;
+	}
 
-	g_free(ril);
+	return NULL;
 }
 
-gboolean g_ril_get_trace(GRil *ril)
+GRilSession *g_ril_session_new(gboolean hold)
 {
+	GRilSession *session = g_try_new0(GRilSession, 1);
 
-	if (ril == NULL || ril->parent == NULL)
-		return FALSE;
+	if (session == NULL)
+		return NULL;
 
-	return ril->parent->trace;
+	session->ref_count = 1;
+	session->hold = hold;
+	session->reconnect_interval = RIL_RECONNECT_MIN_MS;
+
+	return session;
 }
 
-gboolean g_ril_set_trace(GRil *ril, gboolean trace)
+GRilSession *g_ril_session_ref(GRilSession *session)
 {
+	if (session == NULL)
+		return NULL;
 
-	if (ril == NULL || ril->parent == NULL)
-		return FALSE;
+	g_atomic_int_inc(&session->ref_count);
 
-	return ril->parent->trace = trace;
+	return session;
 }
 
-gboolean g_ril_set_slot(GRil *ril, int slot)
+void g_ril_session_unref(GRilSession *session)
 {
-	if (ril == NULL || ril->parent == NULL)
-		return FALSE;
+	GSList *l;
 
-	ril->parent->slot = slot;
-	return TRUE;
-}
+	if (session == NULL)
+		return;
 
-int g_ril_get_slot(GRil *ril)
-{
-	if (ril == NULL)
-		return 0;
+	if (g_atomic_int_dec_and_test(&session->ref_count) == FALSE)
+		return;
 
-	return ril->parent->slot;
+	if (session->tick_source)
+		g_source_remove(session->tick_source);
+
+	if (session->reconnect_source)
+		g_source_remove(session->reconnect_source);
+
+	if (session->idle_source)
+		g_source_remove(session->idle_source);
+
+	/* Slots still in use carry on on their own */
+	for (l = session->slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
+
+		ril->session = NULL;
+		ril->trace_ring = NULL;
+		ril->held = FALSE;
+		ril->release_pending = FALSE;
+		ril_held_clear(ril);
+
+		if (ril->wheel_count > 0 && ril->timeout_source == 0)
+			ril->timeout_source = g_timeout_add_seconds(1,
+							ril_wheel_tick, ril);
+
+		ril_wakeup_writer(ril);
+		ril_unref(ril);
+	}
+
+	g_slist_free(session->slots);
+	trace_ring_free(session->trace_ring);
+	g_free(session);
 }
 
-gboolean g_ril_set_version(GRil *ril, int version)
+void g_ril_session_set_connect_function(GRilSession *session,
+					GRilSessionConnectFunc func,
+					gpointer user_data)
 {
-	if (ril == NULL || ril->parent == NULL ||
-			ril->parent->version != RIL_VERSION_UNSPECIFIED)
-		return FALSE;
+	if (session == NULL)
+		return;
 
-	ril->parent->version = version;
-	return TRUE;
+	session->connect = func;
+	session->connect_data = user_data;
 }
 
-int g_ril_get_version(GRil *ril)
+GRil *g_ril_session_add_slot(GRilSession *session, int slot,
+				const char *sock_path,
+				enum ofono_ril_vendor vendor)
 {
+	struct ril_s *p;
+	GRil *ril;
+
+	if (session == NULL || session_find_slot(session, slot) != NULL)
+		return NULL;
+
+	ril = g_ril_new(sock_path, vendor);
 	if (ril == NULL)
-		return RIL_VERSION_UNSPECIFIED;
+		return NULL;
 
-	return ril->parent->version;
+	p = ril->parent;
+	p->slot = slot;
+	p->session = session;
+	p->held = session->hold;
+	p->trace_ring = session->trace_ring;
+
+	g_atomic_int_inc(&p->ref_count);
+	session->slots = g_slist_append(session->slots, p);
+
+	return ril;
 }
 
-gboolean g_ril_set_debugf(GRil *ril,
-			GRilDebugFunc func, gpointer user_data)
+gboolean g_ril_session_swap_slots(GRilSession *session, int slot_a,
+					int slot_b)
 {
+	struct ril_s *a, *b;
 
-	if (ril == NULL || ril->group != 0)
+	if (session == NULL || session->swap_a != NULL || slot_a == slot_b)
 		return FALSE;
 
-	return ril_set_debug(ril->parent, func, user_data);
-}
+	a = session_find_slot(session, slot_a);
+	b = session_find_slot(session, slot_b);
 
-gboolean g_ril_set_vendor_print_msg_id_funcs(GRil *ril,
-					GRilMsgIdToStrFunc req_to_string,
-					GRilMsgIdToStrFunc unsol_to_string)
-{
-	if (ril == NULL || ril->parent == NULL)
+	if (a == NULL || b == NULL || session_can_swap(a, b) == FALSE)
 		return FALSE;
 
-	ril->parent->req_to_string = req_to_string;
-	ril->parent->unsol_to_string = unsol_to_string;
+	session->swap_a = a;
+	session->swap_b = b;
+	session_schedule_idle(session);
 
 	return TRUE;
 }
 
-guint g_ril_register(GRil *ril, const int req,
-			GRilNotifyFunc func, gpointer user_data)
+gboolean g_ril_session_release(GRilSession *session, int slot)
 {
-	if (ril == NULL)
-		return 0;
+	struct ril_s *ril;
 
-	return ril_register(ril->parent, ril->group, req,
-				func, user_data);
-}
+	if (session == NULL)
+		return FALSE;
 
-gboolean g_ril_unregister(GRil *ril, guint id)
-{
-	if (ril == NULL)
+	ril = session_find_slot(session, slot);
+	if (ril == NULL || ril->held == FALSE)
 		return FALSE;
 
-	return ril_unregister(ril->parent, ril->parent->in_notify,
-					ril->group, id);
+	ril->release_pending = TRUE;
+	session_schedule_idle(session);
+
+	return TRUE;
 }
 
-gboolean g_ril_unregister_all(GRil *ril)
+gboolean g_ril_session_get_io_stats(GRilSession *session,
+					struct ril_io_stats *stats)
 {
-	if (ril == NULL)
-		return FALSE;
+	GSList *l;
 
-	return ril_unregister_all(ril->parent,
-					ril->parent->in_notify,
-					node_compare_by_group,
-					GUINT_TO_POINTER(ril->group));
-}
+	if (session == NULL || stats == NULL)
+		return FALSE;
 
-enum ofono_ril_vendor g_ril_vendor(GRil *ril)
-{
-	if (ril == NULL)
-		return OFONO_RIL_VENDOR_AOSP;
+	memset(stats, 0, sizeof(*stats));
 
-	return ril->parent->vendor;
-}
+	for (l = session->slots; l; l = l->next) {
+		struct ril_s *ril = l->data;
 
-const char *g_ril_request_id_to_string(GRil *ril, int req)
-{
-	return request_id_to_string(ril->parent, req);
-}
+		stats->requests += ril->stats.requests;
+		stats->responses += ril->stats.responses;
+		stats->unsolicited += ril->stats.unsolicited;
+		stats->coalesced += ril->stats.coalesced;
+		stats->timeouts += ril->stats.timeouts;
+		stats->bytes_written += ril->stats.bytes_written;
+		stats->bytes_read += ril->stats.bytes_read;
+		stats->reconnects += ril->stats.reconnects;
+	}
 
-const char *g_ril_unsol_request_to_string(GRil *ril, int req)
-{
-	return unsol_request_to_string(ril->parent, req);
+	return TRUE;
 }
@@ -33,11 +33,15 @@ extern "C" {
 #include "ril_constants.h"
 #include "drivers/rilmodem/vendor.h"
 
-#define RIL_MAX_NUM_ACTIVE_DATA_CALLS 2
+/* Data calls allowed unless the modem plugin configures more */
+#define RIL_DEFAULT_NUM_DATA_CALLS 2
+#define RIL_MAX_NUM_DATA_CALLS 32
 
 struct _GRil;
+struct _GRilSession;
 
 typedef struct _GRil GRil;
+typedef struct _GRilSession GRilSession;
 
 /*
  * This struct represents an entire RIL message read
@@ -53,12 +57,86 @@ struct ril_msg {
 	int error;
 };
 
+/*
+ * Request priorities, highest first.  Queued requests of a higher
+ * priority are always written before lower priority ones, requests of
+ * the same priority are written round-robin across GRil instances.
+ */
+enum g_ril_priority {
+	G_RIL_PRIORITY_SESSION = 0,	/* Also written while a slot is held */
+	G_RIL_PRIORITY_CALL_CONTROL,
+	G_RIL_PRIORITY_SMS,
+	G_RIL_PRIORITY_DEFAULT,
+	G_RIL_PRIORITY_POLL,
+	G_RIL_PRIORITY_BULK,
+	G_RIL_PRIORITY_LAST
+};
+
 typedef void (*GRilResponseFunc)(struct ril_msg *message, gpointer user_data);
 
 typedef void (*GRilNotifyFunc)(struct ril_msg *message, gpointer user_data);
 
 typedef const char *(*GRilMsgIdToStrFunc)(int msg_id);
 
+#define G_RIL_TRACE_DATA_SIZE 32
+
+enum ril_trace_type {
+	RIL_TRACE_REQUEST = 0,
+	RIL_TRACE_RESPONSE,
+	RIL_TRACE_UNSOL,
+	RIL_TRACE_TIMEOUT,
+};
+
+/*
+ * Entry of the binary trace ring.  Only the first G_RIL_TRACE_DATA_SIZE
+ * bytes of the payload are kept, len holds the full payload length.
+ */
+struct ril_trace_entry {
+	gint64 time;			/* Monotonic time, microseconds */
+	guint8 type;			/* enum ril_trace_type */
+	guint8 slot;
+	guint16 data_len;
+	gint serial;
+	gint req;
+	gint error;
+	guint32 len;
+	guint8 data[G_RIL_TRACE_DATA_SIZE];
+};
+
+typedef void (*GRilTraceFunc)(const struct ril_trace_entry *entry,
+				gpointer user_data);
+
+/*
+ * Latency histogram bucket i counts latencies below 2^i ms, the last
+ * bucket counts everything longer.
+ */
+#define G_RIL_LATENCY_BUCKETS 16
+
+struct ril_latency_stats {
+	guint count;
+	guint64 queue_time;		/* Total queue wait, microseconds */
+	guint64 modem_time;		/* Total modem time, microseconds */
+	guint64 modem_time_max;
+	guint queue_hist[G_RIL_LATENCY_BUCKETS];
+	guint modem_hist[G_RIL_LATENCY_BUCKETS];
+};
+
+struct ril_io_stats {
+	guint64 requests;
+	guint64 responses;
+	guint64 unsolicited;
+	guint64 coalesced;		/* Unsolicited events dropped */
+	guint64 timeouts;
+	guint64 bytes_written;
+	guint64 bytes_read;
+	guint64 reconnects;		/* Session reconnections to rild */
+};
+
+typedef void (*GRilLatencyFunc)(int req, const struct ril_latency_stats *stats,
+				gpointer user_data);
+
+typedef void (*GRilSessionConnectFunc)(int slot, gpointer user_data);
+
 /**
  * TRACE:
  * @fmt: format string
@@ -93,9 +171,15 @@ extern char print_buf[];
 		g_ril_get_slot(gril), message->serial_no,		\
 			g_ril_request_id_to_string(gril, message->req))
 
+/* Starts the text of a trace line, later calls append to it */
+#define g_ril_start_print_buf(gril, x...) do {	\
+	if (gril && g_ril_get_trace(gril))	\
+		g_ril_print_buf_start(x);	\
+} while (0)
+
 #define g_ril_append_print_buf(gril, x...) do {	\
 	if (gril && g_ril_get_trace(gril))	\
-		sprintf(print_buf, x);		\
+		g_ril_print_buf_append(x);	\
 } while (0)
 
 #define g_ril_print_unsol(gril, message)				\
@@ -108,6 +192,11 @@ extern char print_buf[];
 	G_RIL_TRACE(gril, "[%d,UNSOL]< %s", g_ril_get_slot(gril),	\
 			g_ril_unsol_request_to_string(gril, message->req))
 
+void g_ril_print_buf_start(const char *fmt, ...)
+				__attribute__((format(printf, 1, 2)));
+void g_ril_print_buf_append(const char *fmt, ...)
+				__attribute__((format(printf, 1, 2)));
+
 void g_ril_init_parcel(const struct ril_msg *message, struct parcel *rilp);
 
 GRil *g_ril_new(const char *sock_path, enum ofono_ril_vendor vendor);
@@ -126,12 +215,62 @@ void g_ril_set_disconnect_function(GRil *ril, GRilDisconnectFunc disconnect,
 gboolean g_ril_get_trace(GRil *ril);
 gboolean g_ril_set_trace(GRil *ril, gboolean trace);
 
+/*!
+ * Keeps the last entries requests, responses, unsolicited events and
+ * timeouts in a binary ring, which costs a few stores per message.
+ * 0 disables the ring.  The ring is dumped to the log whenever a
+ * request times out, or on demand with g_ril_trace_ring_dump.
+ */
+gboolean g_ril_set_trace_ring(GRil *ril, guint entries);
+gboolean g_ril_trace_ring_foreach(GRil *ril, GRilTraceFunc func,
+					gpointer user_data);
+void g_ril_trace_ring_dump(GRil *ril);
+
+/*!
+ * Coalesces bursts of the given unsolicited event: within window
+ * milliseconds of a delivery only the latest event is kept, and it is
+ * delivered when the window expires.  Only meant for events whose last
+ * value supersedes the earlier ones.  A window of 0 disables it.
+ */
+gboolean g_ril_set_coalesce(GRil *ril, int unsol, guint window);
+
+/*!
+ * Request statistics: throughput counters and, per request id, latency
+ * histograms split in time spent queued in GRil and time spent waiting
+ * for rild to answer.
+ */
+gboolean g_ril_get_io_stats(GRil *ril, struct ril_io_stats *stats);
+gboolean g_ril_latency_foreach(GRil *ril, GRilLatencyFunc func,
+				gpointer user_data);
+void g_ril_reset_stats(GRil *ril);
+
+/*!
+ * Sets the number of seconds after which a request that got no reply is
+ * failed with RIL_E_TIMEOUT, 0 disables the timeout.  Requests known to
+ * take long, such as network scans, get a multiple of it.
+ */
+gboolean g_ril_set_timeout(GRil *ril, guint timeout);
+
+/*!
+ * Returns how many requests with the given id timed out so far, or the
+ * total for all requests if req is negative.
+ */
+guint g_ril_get_timeout_count(GRil *ril, int req);
+
 int g_ril_get_slot(GRil *ril);
 gboolean g_ril_set_slot(GRil *ril, int slot);
 
 int g_ril_get_version(GRil *ril);
 gboolean g_ril_set_version(GRil *ril, int version);
 
+/*!
+ * Upper bound for concurrent data calls on this modem, shared by all
+ * clones.  The limit reported by the modem in DATA_REGISTRATION_STATE
+ * is still honoured when it is lower.
+ */
+gboolean g_ril_set_max_data_calls(GRil *ril, unsigned int max);
+unsigned int g_ril_get_max_data_calls(GRil *ril);
+
 /*!
  * If the function is not NULL, then on every read/write from the GIOChannel
  * provided to GRil the logging function will be called with the
@@ -157,6 +296,15 @@ gint g_ril_send(GRil *ril, const gint reqid, struct parcel *rilp,
 		GRilResponseFunc func, gpointer user_data,
 		GDestroyNotify notify);
 
+/*!
+ * Same as g_ril_send, but queues the request with the given priority
+ * instead of the one g_ril_send picks based on the request id.
+ */
+gint g_ril_send_with_priority(GRil *ril, const gint reqid,
+				struct parcel *rilp, GRilResponseFunc func,
+				gpointer user_data, GDestroyNotify notify,
+				enum g_ril_priority priority);
+
 guint g_ril_register(GRil *ril, const int req,
 			GRilNotifyFunc func, gpointer user_data);
 
@@ -168,6 +316,53 @@ enum ofono_ril_vendor g_ril_vendor(GRil *ril);
 const char *g_ril_request_id_to_string(GRil *ril, int req);
 const char *g_ril_unsol_request_to_string(GRil *ril, int req);
 
+gboolean g_ril_is_connected(GRil *ril);
+
+/*!
+ * A session groups the rild sockets of the slots of a multi-SIM modem.
+ * The slots share one timer source for request timeouts, one trace
+ * ring and one reconnection timer.  When rild drops a socket, the GRil
+ * of that slot and its clones stay valid: registrations and unsent
+ * requests are kept, requests already on the wire fail with
+ * RIL_E_RADIO_NOT_AVAILABLE, and the socket is reconnected with a
+ * short backoff, after which the connect function is called.
+ *
+ * If hold is TRUE, slots start held and are held again after every
+ * reconnection: only G_RIL_PRIORITY_SESSION requests are written and
+ * unsolicited events are queued, until g_ril_session_release is called.
+ * This gives the plugin a chance to check which rild socket now serves
+ * which physical slot, and to swap them before anything else is sent.
+ */
+GRilSession *g_ril_session_new(gboolean hold);
+GRilSession *g_ril_session_ref(GRilSession *session);
+void g_ril_session_unref(GRilSession *session);
+
+void g_ril_session_set_connect_function(GRilSession *session,
+					GRilSessionConnectFunc func,
+					gpointer user_data);
+
+/*!
+ * Connects to sock_path for the given slot, returns NULL if that fails.
+ * The trace ring set on any slot of the session is shared by all.
+ */
+GRil *g_ril_session_add_slot(GRilSession *session, int slot,
+				const char *sock_path,
+				enum ofono_ril_vendor vendor);
+
+/*!
+ * Exchanges the sockets of two held, connected slots with no request
+ * on the wire.  Both the swap and the release take effect once the
+ * current dispatch is over, a swap requested before a release is done
+ * first.
+ */
+gboolean g_ril_session_swap_slots(GRilSession *session, int slot_a,
+					int slot_b);
+gboolean g_ril_session_release(GRilSession *session, int slot);
+
+/* Sum of the counters of all slots */
+gboolean g_ril_session_get_io_stats(GRilSession *session,
+					struct ril_io_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include <glib.h>
 
@@ -154,6 +155,42 @@ gsize g_ril_io_write(GRilIO *io, const gchar *data, gsize count)
 	return bytes_written;
 }
 
+gssize g_ril_io_writev(GRilIO *io, const struct iovec *iov, int iovcnt)
+{
+	ssize_t bytes_written;
+	gsize left;
+	gsize len;
+	int i;
+
+	do {
+		bytes_written = writev(g_io_channel_unix_get_fd(io->channel),
+					iov, iovcnt);
+	} while (bytes_written < 0 && errno == EINTR);
+
+	if (bytes_written < 0) {
+		if (errno == EAGAIN)
+			return 0;
+
+		g_source_remove(io->read_watch);
+		return -1;
+	}
+
+	if (io->debugf == NULL)
+		return bytes_written;
+
+	left = bytes_written;
+
+	for (i = 0; i < iovcnt && left > 0; i++) {
+		len = MIN(left, iov[i].iov_len);
+
+		g_ril_util_debug_hexdump(FALSE, iov[i].iov_base, len,
+					io->debugf, io->debug_data);
+		left -= len;
+	}
+
+	return bytes_written;
+}
+
 static void write_watcher_destroy_notify(gpointer user_data)
 {
 	GRilIO *io = user_data;
@@ -42,6 +42,8 @@
 #include "util.h"
 #include "grilreply.h"
 #include "grilutil.h"
+#include "grilschema.h"
+#include "arena.h"
 
 #define OPERATOR_NUM_PARAMS 3
 
@@ -69,10 +71,8 @@ static void ril_reply_free_operator(gpointer data)
 
 void g_ril_reply_free_avail_ops(struct reply_avail_ops *reply)
 {
-	if (reply) {
-		g_slist_free_full(reply->list, ril_reply_free_operator);
-		g_free(reply);
-	}
+	if (reply)
+		arena_free(reply->arena);
 }
 
 struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
@@ -81,6 +81,7 @@ struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
 	struct parcel rilp;
 	struct reply_operator *operator;
 	struct reply_avail_ops *reply = NULL;
+	struct arena *arena;
 	unsigned int num_ops, num_strings;
 	unsigned int i;
 	int strings_per_opt;
@@ -104,7 +105,7 @@ struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
 	}
 
 	g_ril_init_parcel(message, &rilp);
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	/* Number of operators at the list */
 	num_strings = (unsigned int) parcel_r_int32(&rilp);
@@ -119,46 +120,43 @@ struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
 	num_ops = num_strings / strings_per_opt;
 	DBG("noperators = %d", num_ops);
 
-	reply = g_try_new0(struct reply_avail_ops, 1);
-	if (reply == NULL) {
-		ofono_error("%s: can't allocate reply struct", __func__);
-		goto error;
-	}
+	/* UTF-8 strings take about half the space of the UTF-16 ones */
+	arena = arena_new(message->buf_len);
+
+	reply = arena_new0(arena, struct reply_avail_ops);
+	reply->arena = arena;
 
 	reply->num_ops = num_ops;
 	for (i = 0; i < num_ops; i++) {
-		operator = g_try_new0(struct reply_operator, 1);
-		if (operator == NULL) {
-			ofono_error("%s: can't allocate reply struct",
-					__func__);
-			goto error;
-		}
+		operator = arena_new0(arena, struct reply_operator);
 
-		operator->lalpha = parcel_r_string(&rilp);
-		operator->salpha = parcel_r_string(&rilp);
-		operator->numeric = parcel_r_string(&rilp);
-		operator->status = parcel_r_string(&rilp);
+		operator->lalpha = parcel_r_string_arena(&rilp, arena);
+		operator->salpha = parcel_r_string_arena(&rilp, arena);
+		operator->numeric = parcel_r_string_arena(&rilp, arena);
+		operator->status = parcel_r_string_arena(&rilp, arena);
 
 		/*
 		 * MTK: additional string with technology: 2G/3G are the only
 		 * valid values currently.
 		 */
 		if (vendor == OFONO_RIL_VENDOR_MTK) {
-			char *tech = parcel_r_string(&rilp);
+			char tech[4];
+
+			parcel_r_string_buf(&rilp, tech, sizeof(tech));
+
 			if (strcmp(tech, "3G") == 0)
 				operator->tech = RADIO_TECH_UMTS;
 			else
 				operator->tech = RADIO_TECH_GSM;
-			g_free(tech);
 		} else {
 			operator->tech = RADIO_TECH_GSM;
 		}
 
+		/* Dropped operators are released along with the arena */
 		if (operator->lalpha == NULL && operator->salpha == NULL) {
 			ofono_error("%s: operator (%s) doesn't specify names",
 					operator->numeric,
 					__func__);
-			g_ril_reply_free_operator(operator);
 			continue;
 		}
 
@@ -168,7 +166,6 @@ struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
 					operator->lalpha,
 					operator->salpha,
 					__func__);
-			g_ril_reply_free_operator(operator);
 			continue;
 		}
 
@@ -178,15 +175,13 @@ struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
 					operator->lalpha,
 					operator->salpha,
 					__func__);
-			g_ril_reply_free_operator(operator);
 			continue;
 		}
 
-		reply->list = g_slist_append(reply->list, operator);
+		reply->list = arena_slist_append(arena, reply->list, operator);
 
-		g_ril_append_print_buf(gril, "%s [lalpha=%s, salpha=%s, "
+		g_ril_append_print_buf(gril, " [lalpha=%s, salpha=%s, "
 				" numeric=%s status=%s tech=%s]",
-				print_buf,
 				operator->lalpha,
 				operator->salpha,
 				operator->numeric,
@@ -194,7 +189,7 @@ struct reply_avail_ops *g_ril_reply_parse_avail_ops(GRil *gril,
 				ril_radio_tech_to_string(operator->tech));
 	}
 
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 	return reply;
@@ -255,7 +250,7 @@ struct reply_operator *g_ril_reply_parse_operator(GRil *gril,
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"(lalpha=%s, salpha=%s, numeric=%s)",
 				PRINTABLE_STR(reply->lalpha),
 				PRINTABLE_STR(reply->salpha), reply->numeric);
@@ -316,18 +311,18 @@ static void set_reg_state(GRil *gril, struct reply_reg_state *reply,
 			strstate = str;
 		}
 		reply->status = val;
-		g_ril_append_print_buf(gril, "%s%s", print_buf, strstate);
+		g_ril_append_print_buf(gril, "%s", strstate);
 		break;
 	case RST_IX_LAC:
 		reply->lac = val;
-		g_ril_append_print_buf(gril, "%s0x%x", print_buf, val);
+		g_ril_append_print_buf(gril, "0x%x", val);
 		break;
 	case RST_IX_CID:
 		reply->ci = val;
-		g_ril_append_print_buf(gril, "%s0x%x", print_buf, val);
+		g_ril_append_print_buf(gril, "0x%x", val);
 		break;
 	case RST_IX_RAT:
-		g_ril_append_print_buf(gril, "%s%s", print_buf,
+		g_ril_append_print_buf(gril, "%s",
 					ril_radio_tech_to_string(val));
 
 		if (g_ril_vendor(gril) == OFONO_RIL_VENDOR_MTK ||
@@ -363,7 +358,7 @@ static void set_reg_state(GRil *gril, struct reply_reg_state *reply,
 	return;
 
 no_val:
-	g_ril_append_print_buf(gril, "%s%s", print_buf, str ? str : "(null)");
+	g_ril_append_print_buf(gril, "%s", str ? str : "(null)");
 }
 
 struct reply_reg_state *g_ril_reply_parse_voice_reg_state(GRil *gril,
@@ -393,13 +388,13 @@ struct reply_reg_state *g_ril_reply_parse_voice_reg_state(GRil *gril,
 	reply->lac = -1;
 	reply->ci = -1;
 
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	for (i = 0; i < str_arr->num_str; ++i) {
 		char *str = str_arr->str[i];
 
 		if (i > 0)
-			g_ril_append_print_buf(gril, "%s,", print_buf);
+			g_ril_append_print_buf(gril, ",");
 
 		switch (i) {
 		case RST_IX_STATE: case RST_IX_LAC:
@@ -407,12 +402,12 @@ struct reply_reg_state *g_ril_reply_parse_voice_reg_state(GRil *gril,
 			set_reg_state(gril, reply, i, str);
 			break;
 		default:
-			g_ril_append_print_buf(gril, "%s%s", print_buf,
+			g_ril_append_print_buf(gril, "%s",
 						str ? str : "(null)");
 		}
 	}
 
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 	/* As a minimum we require a valid status string */
@@ -452,7 +447,7 @@ static void set_data_reg_state(GRil *gril, struct reply_data_reg_state *reply,
 			reply->max_cids = MTK_MODEM_MAX_CIDS;
 		else
 			reply->max_cids = val;
-		g_ril_append_print_buf(gril, "%s%u", print_buf, val);
+		g_ril_append_print_buf(gril, "%u", val);
 		break;
 	default:
 		goto no_val;
@@ -461,7 +456,7 @@ static void set_data_reg_state(GRil *gril, struct reply_data_reg_state *reply,
 	return;
 
 no_val:
-	g_ril_append_print_buf(gril, "%s%s", print_buf, str ? str : "(null)");
+	g_ril_append_print_buf(gril, "%s", str ? str : "(null)");
 }
 
 struct reply_data_reg_state *g_ril_reply_parse_data_reg_state(GRil *gril,
@@ -491,13 +486,13 @@ struct reply_data_reg_state *g_ril_reply_parse_data_reg_state(GRil *gril,
 	reply->reg_state.lac = -1;
 	reply->reg_state.ci = -1;
 
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	for (i = 0; i < str_arr->num_str; ++i) {
 		char *str = str_arr->str[i];
 
 		if (i > 0)
-			g_ril_append_print_buf(gril, "%s,", print_buf);
+			g_ril_append_print_buf(gril, ",");
 
 		switch (i) {
 		case RST_IX_STATE: case RST_IX_LAC:
@@ -508,12 +503,12 @@ struct reply_data_reg_state *g_ril_reply_parse_data_reg_state(GRil *gril,
 			set_data_reg_state(gril, reply, i, str);
 			break;
 		default:
-			g_ril_append_print_buf(gril, "%s%s", print_buf,
+			g_ril_append_print_buf(gril, "%s",
 						str ? str : "(null)");
 		}
 	}
 
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 	/* As a minimum we require a valid status string */
@@ -537,11 +532,27 @@ void g_ril_reply_free_sim_io(struct reply_sim_io *reply)
 	}
 }
 
+/* SIM_IO_Response as found on the wire */
+struct sim_io_response {
+	int sw1;
+	int sw2;
+	char *response;
+};
+
+static const struct ril_field sim_io_response_fields[] = {
+	RIL_FIELD_HEX(struct sim_io_response, sw1),
+	RIL_FIELD_HEX(struct sim_io_response, sw2),
+	RIL_FIELD_STR(struct sim_io_response, response),
+};
+
+static const struct ril_schema sim_io_response_schema =
+	RIL_SCHEMA("SIM_IO_Response", sim_io_response_fields);
+
 struct reply_sim_io *g_ril_reply_parse_sim_io(GRil *gril,
 						const struct ril_msg *message)
 {
 	struct parcel rilp;
-	char *response = NULL;
+	struct sim_io_response rsp = { 0 };
 	struct reply_sim_io *reply;
 
 	/*
@@ -559,34 +570,32 @@ struct reply_sim_io *g_ril_reply_parse_sim_io(GRil *gril,
 	reply =	g_new0(struct reply_sim_io, 1);
 
 	g_ril_init_parcel(message, &rilp);
-	reply->sw1 = parcel_r_int32(&rilp);
-	reply->sw2 = parcel_r_int32(&rilp);
 
-	response = parcel_r_string(&rilp);
+	if (g_ril_schema_decode(gril, &sim_io_response_schema, &rilp,
+					&rsp, NULL) == FALSE)
+		goto error;
 
-	g_ril_append_print_buf(gril,
-				"(sw1=0x%.2X,sw2=0x%.2X,%s)",
-				reply->sw1,
-				reply->sw2,
-				response);
+	g_ril_schema_trace(gril, &sim_io_response_schema, &rsp);
 	g_ril_print_response(gril, message);
 
-	if (rilp.malformed)
-		goto error;
+	reply->sw1 = rsp.sw1;
+	reply->sw2 = rsp.sw2;
 
-	if (response != NULL) {
+	if (rsp.response != NULL) {
 		reply->hex_response =
-			decode_hex(response, strlen(response),
+			decode_hex(rsp.response, strlen(rsp.response),
 					(long *) &reply->hex_len, -1);
-		g_free(response);
 
 		if (reply->hex_response == NULL)
 			goto error;
 	}
 
+	g_free(rsp.response);
+
 	return reply;
 
 error:
+	g_free(rsp.response);
 	g_free(reply);
 
 	return NULL;
@@ -601,7 +610,7 @@ gchar *g_ril_reply_parse_imsi(GRil *gril, const struct ril_msg *message)
 
 	imsi = parcel_r_string(&rilp);
 
-	g_ril_append_print_buf(gril, "{%s}", imsi ? imsi : "NULL");
+	g_ril_start_print_buf(gril, "{%s}", imsi ? imsi : "NULL");
 	g_ril_print_response(gril, message);
 
 	return imsi;
@@ -609,19 +618,8 @@ gchar *g_ril_reply_parse_imsi(GRil *gril, const struct ril_msg *message)
 
 void g_ril_reply_free_sim_status(struct reply_sim_status *status)
 {
-	if (status) {
-		guint i;
-
-		for (i = 0; i < status->num_apps; i++) {
-			if (status->apps[i] != NULL) {
-				g_free(status->apps[i]->aid_str);
-				g_free(status->apps[i]->app_str);
-				g_free(status->apps[i]);
-			}
-		}
-
-		g_free(status);
-	}
+	if (status)
+		arena_free(status->arena);
 }
 
 struct reply_sim_status *g_ril_reply_parse_sim_status(GRil *gril,
@@ -630,15 +628,19 @@ struct reply_sim_status *g_ril_reply_parse_sim_status(GRil *gril,
 	struct parcel rilp;
 	unsigned int i;
 	struct reply_sim_status *status;
+	struct arena *arena;
 	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
 
-	g_ril_append_print_buf(gril, "[%d,%04d]< %s",
+	g_ril_start_print_buf(gril, "[%d,%04d]< %s",
 			g_ril_get_slot(gril), message->serial_no,
 			ril_request_id_to_string(message->req));
 
 	g_ril_init_parcel(message, &rilp);
 
-	status = g_new0(struct reply_sim_status, 1);
+	arena = arena_new(sizeof(*status) + message->buf_len);
+
+	status = arena_new0(arena, struct reply_sim_status);
+	status->arena = arena;
 
 	status->card_state = parcel_r_int32(&rilp);
 
@@ -662,7 +664,7 @@ struct reply_sim_status *g_ril_reply_parse_sim_status(GRil *gril,
 	if (rilp.malformed)
 		goto error;
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"(card_state=%d,universal_pin_state=%d,"
 				"gsm_umts_index=%d,cdma_index=%d,"
 				"ims_index=%d, ",
@@ -683,25 +685,17 @@ struct reply_sim_status *g_ril_reply_parse_sim_status(GRil *gril,
 	for (i = 0; i < status->num_apps; i++) {
 		struct reply_sim_app *app;
 		DBG("processing app[%d]", i);
-		status->apps[i] = g_try_new0(struct reply_sim_app, 1);
+		status->apps[i] = arena_new0(arena, struct reply_sim_app);
 		app = status->apps[i];
-		if (app == NULL) {
-			ofono_error("Can't allocate app_data");
-			goto error;
-		}
 
 		app->app_type = parcel_r_int32(&rilp);
 		app->app_state = parcel_r_int32(&rilp);
 		app->perso_substate = parcel_r_int32(&rilp);
 
-		/*
-		 * TODO: we need a way to instruct parcel to skip
-		 * a string, without allocating memory...
-		 */
 		/* application ID (AID) */
-		app->aid_str = parcel_r_string(&rilp);
+		app->aid_str = parcel_r_string_arena(&rilp, arena);
 		/* application label */
-		app->app_str = parcel_r_string(&rilp);
+		app->app_str = parcel_r_string_arena(&rilp, arena);
 
 		app->pin_replaced = parcel_r_int32(&rilp);
 		app->pin1_state = parcel_r_int32(&rilp);
@@ -721,11 +715,10 @@ struct reply_sim_status *g_ril_reply_parse_sim_status(GRil *gril,
 		}
 
 		g_ril_append_print_buf(gril,
-					"%s[app_type=%d,app_state=%d,"
+					"[app_type=%d,app_state=%d,"
 					"perso_substate=%d,aid_ptr=%s,"
 					"app_label_ptr=%s,pin1_replaced=%d,"
 					"pin1=%d,pin2=%d],",
-					print_buf,
 					app->app_type,
 					app->app_state,
 					app->perso_substate,
@@ -740,7 +733,7 @@ struct reply_sim_status *g_ril_reply_parse_sim_status(GRil *gril,
 		goto error;
 
 done:
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 	return status;
@@ -790,7 +783,7 @@ struct ofono_phone_number *g_ril_reply_parse_get_smsc_address(
 	strncpy(sca->number, number, OFONO_MAX_PHONE_NUMBER_LENGTH);
 	sca->number[OFONO_MAX_PHONE_NUMBER_LENGTH] = '\0';
 
-	g_ril_append_print_buf(gril, "{type=%d,number=%s}",
+	g_ril_start_print_buf(gril, "{type=%d,number=%s}",
 				sca->type, sca->number);
 	g_ril_print_response(gril, message);
 
@@ -823,7 +816,7 @@ int g_ril_reply_parse_sms_response(GRil *gril, const struct ril_msg *message)
 	ack_pdu = parcel_r_string(&rilp);
 	error = parcel_r_int32(&rilp);
 
-	g_ril_append_print_buf(gril, "{%d,%s,%d}",
+	g_ril_start_print_buf(gril, "{%d,%s,%d}",
 				mr, ack_pdu, error);
 	g_ril_print_response(gril, message);
 
@@ -856,7 +849,7 @@ GSList *g_ril_reply_parse_get_calls(GRil *gril, const struct ril_msg *message)
 
 	g_ril_init_parcel(message, &rilp);
 
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	/* maguro signals no calls with empty event data */
 	if (rilp.size < sizeof(int32_t))
@@ -902,9 +895,8 @@ GSList *g_ril_reply_parse_get_calls(GRil *gril, const struct ril_msg *message)
 			call->clip_validity = 2;
 
 		g_ril_append_print_buf(gril,
-					"%s [id=%d,status=%d,type=%d,"
+					" [id=%d,status=%d,type=%d,"
 					"number=%s,name=%s]",
-					print_buf,
 					call->id, call->status, call->type,
 					call->phone_number.number, call->name);
 
@@ -912,7 +904,7 @@ GSList *g_ril_reply_parse_get_calls(GRil *gril, const struct ril_msg *message)
 	}
 
 no_calls:
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 	return l;
@@ -935,7 +927,7 @@ enum ofono_disconnect_reason g_ril_reply_parse_call_fail_cause(
 	if (last_cause == CALL_FAIL_NORMAL || last_cause == CALL_FAIL_BUSY)
 		reason = OFONO_DISCONNECT_REASON_REMOTE_HANGUP;
 
-	g_ril_append_print_buf(gril, "{%d}", last_cause);
+	g_ril_start_print_buf(gril, "{%d}", last_cause);
 	g_ril_print_response(gril, message);
 
 	return reason;
@@ -952,7 +944,7 @@ int g_ril_reply_parse_get_mute(GRil *gril, const struct ril_msg *message)
 	parcel_r_int32(&rilp);
 	muted = parcel_r_int32(&rilp);
 
-	g_ril_append_print_buf(gril, "{%d}", muted);
+	g_ril_start_print_buf(gril, "{%d}", muted);
 	g_ril_print_response(gril, message);
 
 	return muted;
@@ -969,7 +961,7 @@ char *g_ril_reply_parse_baseband_version(GRil *gril,
 
 	version = parcel_r_string(&rilp);
 
-	g_ril_append_print_buf(gril, "{%s}", version);
+	g_ril_start_print_buf(gril, "{%s}", version);
 	g_ril_print_response(gril, message);
 
 	return version;
@@ -985,7 +977,7 @@ char *g_ril_reply_parse_get_imei(GRil *gril,
 
 	imei = parcel_r_string(&rilp);
 
-	g_ril_append_print_buf(gril, "{%s}", imei);
+	g_ril_start_print_buf(gril, "{%s}", imei);
 	g_ril_print_response(gril, message);
 
 	return imei;
@@ -1012,7 +1004,7 @@ int g_ril_reply_parse_query_call_waiting(GRil *gril,
 	else
 		cls = 0;
 
-	g_ril_append_print_buf(gril, "{%d,0x%x}", enabled, cls);
+	g_ril_start_print_buf(gril, "{%d,0x%x}", enabled, cls);
 	g_ril_print_response(gril, message);
 
 	return cls;
@@ -1037,7 +1029,7 @@ int g_ril_reply_parse_query_clip(GRil *gril,
 
 	clip_status = parcel_r_int32(&rilp);
 
-	g_ril_append_print_buf(gril, "{%d}", clip_status);
+	g_ril_start_print_buf(gril, "{%d}", clip_status);
 	g_ril_print_response(gril, message);
 
 	return clip_status;
@@ -1079,7 +1071,7 @@ struct reply_clir *g_ril_reply_parse_get_clir(GRil *gril,
 	/* State of the CLIR supplementary service in the network */
 	rclir->provisioned = parcel_r_int32(&rilp);
 
-	g_ril_append_print_buf(gril, "{%d,%d}",
+	g_ril_start_print_buf(gril, "{%d,%d}",
 				rclir->status, rclir->provisioned);
 	g_ril_print_response(gril, message);
 
@@ -1124,11 +1116,9 @@ struct ofono_call_forwarding_condition
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	for (i = 0; i < *list_size; i++) {
-		char *str;
-
 		list[i].status =  parcel_r_int32(&rilp);
 
 		parcel_r_int32(&rilp); /* skip reason */
@@ -1136,16 +1126,8 @@ struct ofono_call_forwarding_condition
 		list[i].cls = parcel_r_int32(&rilp);
 		list[i].phone_number.type = parcel_r_int32(&rilp);
 
-		str = parcel_r_string(&rilp);
-
-		if (str != NULL) {
-			strncpy(list[i].phone_number.number, str,
-				OFONO_MAX_PHONE_NUMBER_LENGTH);
-			g_free(str);
-
-			list[i].phone_number.number[
-				OFONO_MAX_PHONE_NUMBER_LENGTH] = '\0';
-		}
+		parcel_r_string_buf(&rilp, list[i].phone_number.number,
+				sizeof(list[i].phone_number.number));
 
 		list[i].time = parcel_r_int32(&rilp);
 
@@ -1155,8 +1137,7 @@ struct ofono_call_forwarding_condition
 			goto error;
 		}
 
-		g_ril_append_print_buf(gril, "%s [%d,%d,%d,%s,%d]",
-					print_buf,
+		g_ril_append_print_buf(gril, " [%d,%d,%d,%s,%d]",
 					list[i].status,
 					list[i].cls,
 					list[i].phone_number.type,
@@ -1165,7 +1146,7 @@ struct ofono_call_forwarding_condition
 
 	}
 
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 	return list;
@@ -1220,7 +1201,7 @@ int g_ril_reply_parse_get_preferred_network_type(GRil *gril,
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril, "{%d}", parcel_net_type);
+	g_ril_start_print_buf(gril, "{%d}", parcel_net_type);
 	g_ril_print_response(gril, message);
 
 	return net_type;
@@ -1251,7 +1232,7 @@ int g_ril_reply_parse_query_facility_lock(GRil *gril,
 		goto error;
 	}
 
-	g_ril_append_print_buf(gril, "{%d}", status);
+	g_ril_start_print_buf(gril, "{%d}", status);
 	g_ril_print_response(gril, message);
 
 	return status;
@@ -1289,7 +1270,7 @@ int g_ril_reply_parse_set_facility_lock(GRil *gril,
 	}
 
 done:
-	g_ril_append_print_buf(gril, "{%d}", retries);
+	g_ril_start_print_buf(gril, "{%d}", retries);
 	g_ril_print_response(gril, message);
 
 	/* -1 indicates unknown; reset to 0 so as to not trigger failure */
@@ -1333,7 +1314,7 @@ int *g_ril_reply_parse_retries(GRil *gril, const struct ril_msg *message,
 		if (message->error == RIL_E_PASSWORD_INCORRECT)
 			retries[passwd_type] = parcel_r_int32(&rilp);
 
-		g_ril_append_print_buf(gril, "{%d}", retries[passwd_type]);
+		g_ril_start_print_buf(gril, "{%d}", retries[passwd_type]);
 		break;
 	case OFONO_RIL_VENDOR_MTK:
 	case OFONO_RIL_VENDOR_MTK2:
@@ -1345,7 +1326,7 @@ int *g_ril_reply_parse_retries(GRil *gril, const struct ril_msg *message,
 		if (numint == 1) {
 			retries[passwd_type] = parcel_r_int32(&rilp);
 
-			g_ril_append_print_buf(gril, "{%d}",
+			g_ril_start_print_buf(gril, "{%d}",
 							retries[passwd_type]);
 		} else if (numint == 4) {
 			retries[OFONO_SIM_PASSWORD_SIM_PIN] =
@@ -1357,7 +1338,7 @@ int *g_ril_reply_parse_retries(GRil *gril, const struct ril_msg *message,
 			retries[OFONO_SIM_PASSWORD_SIM_PUK2] =
 							parcel_r_int32(&rilp);
 
-			g_ril_append_print_buf(gril,
+			g_ril_start_print_buf(gril,
 					"{pin %d, pin2 %d, puk %d, puk2 %d}",
 					retries[OFONO_SIM_PASSWORD_SIM_PIN],
 					retries[OFONO_SIM_PASSWORD_SIM_PIN2],
@@ -1421,16 +1402,16 @@ struct reply_oem_hook *g_ril_reply_oem_hook_raw(GRil *gril,
 		goto end;
 	}
 
-	g_ril_append_print_buf(gril, "{%d", reply->length);
+	g_ril_start_print_buf(gril, "{%d", reply->length);
 
 	if (reply->data != NULL) {
 		char *hex_dump;
 		hex_dump = encode_hex(reply->data, reply->length, '\0');
-		g_ril_append_print_buf(gril, "%s,%s", print_buf, hex_dump);
+		g_ril_append_print_buf(gril, ",%s", hex_dump);
 		g_free(hex_dump);
 	}
 
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 	g_ril_print_response(gril, message);
 
 end:
@@ -1452,14 +1433,14 @@ struct parcel_str_array *g_ril_reply_oem_hook_strings(GRil *gril,
 		goto out;
 	}
 
-	g_ril_append_print_buf(gril, "{");
+	g_ril_start_print_buf(gril, "{");
 
 	for (i = 0; i < str_arr->num_str; ++i) {
 		if (i + 1 == str_arr->num_str)
-			g_ril_append_print_buf(gril, "%s%s}", print_buf,
+			g_ril_append_print_buf(gril, "%s}",
 						str_arr->str[i]);
 		else
-			g_ril_append_print_buf(gril, "%s%s, ", print_buf,
+			g_ril_append_print_buf(gril, "%s, ",
 						str_arr->str[i]);
 	}
 
@@ -1469,96 +1450,94 @@ out:
 	return str_arr;
 }
 
+static const struct ril_field radio_capability_fields[] = {
+	RIL_FIELD_INT(struct reply_radio_capability, version),
+	RIL_FIELD_INT(struct reply_radio_capability, session),
+	RIL_FIELD_INT(struct reply_radio_capability, phase),
+	RIL_FIELD_INT(struct reply_radio_capability, rat),
+	RIL_FIELD_BUF(struct reply_radio_capability, modem_uuid),
+	RIL_FIELD_INT(struct reply_radio_capability, status),
+};
+
+static const struct ril_schema radio_capability_schema =
+	RIL_SCHEMA("RIL_RadioCapability", radio_capability_fields);
+
 struct reply_radio_capability *g_ril_reply_parse_get_radio_capability(
 				GRil *gril, const struct ril_msg *message)
 {
 	struct reply_radio_capability *reply;
 	struct parcel rilp;
-	char *modem_uuid;
 
 	reply = g_new0(struct reply_radio_capability, 1);
 	g_ril_init_parcel(message, &rilp);
 
-	reply->version = parcel_r_int32(&rilp);
-	reply->session = parcel_r_int32(&rilp);
-	reply->phase = parcel_r_int32(&rilp);
-	reply->rat = parcel_r_int32(&rilp);
-	modem_uuid = parcel_r_string(&rilp);
-	if (modem_uuid != NULL) {
-		strncpy(reply->modem_uuid, modem_uuid,
-						sizeof(reply->modem_uuid) - 1);
-		g_free(modem_uuid);
-	}
-
-	reply->status = parcel_r_int32(&rilp);
-
-	if (rilp.malformed) {
-		ofono_error("%s: malformed parcel", __func__);
+	if (g_ril_schema_decode(gril, &radio_capability_schema, &rilp,
+					reply, NULL) == FALSE) {
 		g_free(reply);
 		reply = NULL;
 		goto end;
 	}
 
-	g_ril_append_print_buf(gril, "{%d,%d,%s,[",
+	g_ril_start_print_buf(gril, "{%d,%d,%s,[",
 				reply->version, reply->session,
 				ril_rc_phase_to_string(reply->phase));
 
 	if (reply->rat & RIL_RAF_UNKNOWN)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_UNKNOWN));
 	if (reply->rat & RIL_RAF_GPRS)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_GPRS));
 	if (reply->rat & RIL_RAF_EDGE)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_EDGE));
 	if (reply->rat & RIL_RAF_UMTS)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_UMTS));
 	if (reply->rat & RIL_RAF_IS95A)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_IS95A));
 	if (reply->rat & RIL_RAF_IS95B)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_IS95B));
 	if (reply->rat & RIL_RAF_1xRTT)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_1xRTT));
 	if (reply->rat & RIL_RAF_EVDO_0)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_EVDO_0));
 	if (reply->rat & RIL_RAF_EVDO_A)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_EVDO_A));
 	if (reply->rat & RIL_RAF_HSDPA)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_HSDPA));
 	if (reply->rat & RIL_RAF_HSUPA)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_HSUPA));
 	if (reply->rat & RIL_RAF_HSPA)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_HSPA));
 	if (reply->rat & RIL_RAF_EVDO_B)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_EVDO_B));
 	if (reply->rat & RIL_RAF_EHRPD)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_EHRPD));
 	if (reply->rat & RIL_RAF_LTE)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_LTE));
 	if (reply->rat & RIL_RAF_HSPAP)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_HSPAP));
 	if (reply->rat & RIL_RAF_GSM)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_GSM));
 	if (reply->rat & RIL_RAF_TD_SCDMA)
-		g_ril_append_print_buf(gril, "%s%s,", print_buf,
+		g_ril_append_print_buf(gril, "%s,",
 				ril_radio_tech_to_string(RADIO_TECH_TD_SCDMA));
 
-	g_ril_append_print_buf(gril, "%s],%s,%s}", print_buf,
+	g_ril_append_print_buf(gril, "],%s,%s}",
 				reply->modem_uuid,
 				ril_rc_status_to_string(reply->status));
 
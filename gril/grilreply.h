@@ -40,9 +40,11 @@ struct reply_operator {
 	int tech;
 };
 
+/* The list and the operators are allocated from arena */
 struct reply_avail_ops {
 	guint num_ops;
 	GSList *list;
+	struct arena *arena;
 };
 
 struct reply_reg_state {
@@ -77,6 +79,7 @@ struct reply_sim_app {
 	guint pin2_state;
 };
 
+/* The apps are allocated from arena */
 struct reply_sim_status {
 	guint card_state;
 	guint pin_state;
@@ -85,6 +88,7 @@ struct reply_sim_status {
 	guint ims_index;
 	guint num_apps;
 	struct reply_sim_app *apps[MAX_UICC_APPS];
+	struct arena *arena;
 };
 
 struct reply_clir {
@@ -37,6 +37,7 @@
 #include <ofono/gprs-context.h>
 
 #include "grilrequest.h"
+#include "grilschema.h"
 #include "simutil.h"
 #include "util.h"
 #include "common.h"
@@ -103,6 +104,22 @@
  *
  */
 
+/* Path string of up to six bytes in hex, see set_path() */
+#define SIM_IO_PATH_SIZE 32
+
+/*
+ * SIM_IO parcels hold command, fileid, P1-P3, the MTK session id, the
+ * path and the data, pin2 and AID strings.
+ */
+static void sim_io_parcel_init(struct parcel *rilp, const char *data,
+				const char *aid_str)
+{
+	parcel_init_sized(rilp, 6 * sizeof(int32_t) + SIM_IO_PATH_SIZE +
+				parcel_string_size(data) +
+				parcel_string_size(NULL) +
+				parcel_string_size(aid_str));
+}
+
 static gboolean set_path(GRil *ril, guint app_type,
 				struct parcel *rilp,
 				const int fileid, const guchar *path,
@@ -146,8 +163,7 @@ static gboolean set_path(GRil *ril, guint app_type,
 		parcel_w_string(rilp, hex_path);
 
 		g_ril_append_print_buf(ril,
-					"%spath=%s,",
-					print_buf,
+					"path=%s,",
 					hex_path);
 
 		g_free(hex_path);
@@ -163,8 +179,7 @@ static gboolean set_path(GRil *ril, guint app_type,
 		parcel_w_string(rilp, NULL);
 
 		g_ril_append_print_buf(ril,
-					"%spath=(null),",
-					print_buf);
+					"path=(null),");
 	}
 
 	return TRUE;
@@ -196,7 +211,7 @@ gboolean g_ril_request_deactivate_data_call(GRil *gril,
 	reason_str = g_strdup_printf("%d", req->reason);
 	parcel_w_string(rilp, reason_str);
 
-	g_ril_append_print_buf(gril, "(%s,%s)", cid_str, reason_str);
+	g_ril_start_print_buf(gril, "(%s,%s)", cid_str, reason_str);
 
 	g_free(cid_str);
 	g_free(reason_str);
@@ -219,7 +234,7 @@ void g_ril_request_power(GRil *gril,
 	parcel_w_int32(rilp, POWER_PARAMS);
 	parcel_w_int32(rilp, (int32_t) power);
 
-	g_ril_append_print_buf(gril, "(%d)", power);
+	g_ril_start_print_buf(gril, "(%d)", power);
 }
 
 void g_ril_request_set_net_select_manual(GRil *gril,
@@ -231,7 +246,7 @@ void g_ril_request_set_net_select_manual(GRil *gril,
 	parcel_init(rilp);
 	parcel_w_string(rilp, mccmnc);
 
-	g_ril_append_print_buf(gril, "(%s)", mccmnc);
+	g_ril_start_print_buf(gril, "(%s)", mccmnc);
 }
 
 gboolean g_ril_request_setup_data_call(GRil *gril,
@@ -313,22 +328,31 @@ gboolean g_ril_request_setup_data_call(GRil *gril,
 		goto error;
 	}
 
-	parcel_init(rilp);
+	tech_str = g_strdup_printf("%d", req->tech);
+	auth_str = g_strdup_printf("%d", req->auth_type);
+
+	/* Leaves room for the MTK request_cid too */
+	parcel_init_sized(rilp, sizeof(int32_t) +
+				parcel_string_size(tech_str) +
+				parcel_string_size(profile_str) +
+				parcel_string_size(req->apn) +
+				parcel_string_size(req->username) +
+				parcel_string_size(req->password) +
+				parcel_string_size(auth_str) +
+				parcel_string_size(protocol_str) +
+				parcel_string_size("4294967295"));
 
 	parcel_w_int32(rilp, num_param);
 
-	tech_str = g_strdup_printf("%d", req->tech);
 	parcel_w_string(rilp, tech_str);
 	parcel_w_string(rilp, profile_str);
 	parcel_w_string(rilp, req->apn);
 	parcel_w_string(rilp, req->username);
 	parcel_w_string(rilp, req->password);
-
-	auth_str = g_strdup_printf("%d", req->auth_type);
 	parcel_w_string(rilp, auth_str);
 	parcel_w_string(rilp, protocol_str);
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"(%s,%s,%s,%s,%s,%s,%s",
 				tech_str,
 				profile_str,
@@ -344,10 +368,10 @@ gboolean g_ril_request_setup_data_call(GRil *gril,
 
 		snprintf(cid_str, sizeof(cid_str), "%u", req->req_cid);
 		parcel_w_string(rilp, cid_str);
-		g_ril_append_print_buf(gril, "%s,%s", print_buf, cid_str);
+		g_ril_append_print_buf(gril, ",%s", cid_str);
 	}
 
-	g_ril_append_print_buf(gril, "%s)", print_buf);
+	g_ril_append_print_buf(gril, ")");
 
 	g_free(tech_str);
 	g_free(auth_str);
@@ -366,12 +390,12 @@ gboolean g_ril_request_sim_read_info(GRil *gril,
 {
 	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
 
-	parcel_init(rilp);
+	sim_io_parcel_init(rilp, NULL, req->aid_str);
 
 	parcel_w_int32(rilp, CMD_GET_RESPONSE);
 	parcel_w_int32(rilp, req->fileid);
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"(cmd=0x%.2X,efid=0x%.4X,",
 				CMD_GET_RESPONSE,
 				req->fileid);
@@ -416,12 +440,12 @@ gboolean g_ril_request_sim_read_binary(GRil *gril,
 {
 	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"(cmd=0x%.2X,efid=0x%.4X,",
 				CMD_READ_BINARY,
 				req->fileid);
 
-	parcel_init(rilp);
+	sim_io_parcel_init(rilp, NULL, req->aid_str);
 	parcel_w_int32(rilp, CMD_READ_BINARY);
 	parcel_w_int32(rilp, req->fileid);
 
@@ -452,11 +476,11 @@ gboolean g_ril_request_sim_read_record(GRil *gril,
 {
 	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
 
-	parcel_init(rilp);
+	sim_io_parcel_init(rilp, NULL, req->aid_str);
 	parcel_w_int32(rilp, CMD_READ_RECORD);
 	parcel_w_int32(rilp, req->fileid);
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"(cmd=0x%.2X,efid=0x%.4X,",
 				CMD_READ_RECORD,
 				req->fileid);
@@ -490,11 +514,13 @@ gboolean g_ril_request_sim_write_binary(GRil *gril,
 	char *hex_data;
 	int p1, p2;
 
-	parcel_init(rilp);
+	hex_data = encode_hex(req->data, req->length, 0);
+
+	sim_io_parcel_init(rilp, hex_data, req->aid_str);
 	parcel_w_int32(rilp, CMD_UPDATE_BINARY);
 	parcel_w_int32(rilp, req->fileid);
 
-	g_ril_append_print_buf(gril, "(cmd=0x%02X,efid=0x%04X,",
+	g_ril_start_print_buf(gril, "(cmd=0x%02X,efid=0x%04X,",
 				CMD_UPDATE_BINARY, req->fileid);
 
 	if (set_path(gril, req->app_type, rilp, req->fileid,
@@ -503,7 +529,6 @@ gboolean g_ril_request_sim_write_binary(GRil *gril,
 
 	p1 = req->start >> 8;
 	p2 = req->start & 0xff;
-	hex_data = encode_hex(req->data, req->length, 0);
 
 	parcel_w_int32(rilp, p1);		/* P1 */
 	parcel_w_int32(rilp, p2);		/* P2 */
@@ -517,8 +542,7 @@ gboolean g_ril_request_sim_write_binary(GRil *gril,
 		parcel_w_int32(rilp, 0);
 
 	g_ril_append_print_buf(gril,
-				"%s%d,%d,%d,%s,pin2=(null),aid=%s)",
-				print_buf,
+				"%d,%d,%d,%s,pin2=(null),aid=%s)",
 				p1,
 				p2,
 				req->length,
@@ -530,6 +554,7 @@ gboolean g_ril_request_sim_write_binary(GRil *gril,
 	return TRUE;
 
 error:
+	g_free(hex_data);
 	return FALSE;
 }
 
@@ -557,11 +582,13 @@ gboolean g_ril_request_sim_write_record(GRil *gril,
 	char *hex_data;
 	int p2;
 
-	parcel_init(rilp);
+	hex_data = encode_hex(req->data, req->length, 0);
+
+	sim_io_parcel_init(rilp, hex_data, req->aid_str);
 	parcel_w_int32(rilp, CMD_UPDATE_RECORD);
 	parcel_w_int32(rilp, req->fileid);
 
-	g_ril_append_print_buf(gril, "(cmd=0x%02X,efid=0x%04X,",
+	g_ril_start_print_buf(gril, "(cmd=0x%02X,efid=0x%04X,",
 				CMD_UPDATE_RECORD, req->fileid);
 
 	if (set_path(gril, req->app_type, rilp, req->fileid,
@@ -569,7 +596,6 @@ gboolean g_ril_request_sim_write_record(GRil *gril,
 		goto error;
 
 	p2 = get_sim_record_access_p2(req->mode);
-	hex_data = encode_hex(req->data, req->length, 0);
 
 	parcel_w_int32(rilp, req->record);	/* P1 */
 	parcel_w_int32(rilp, p2);		/* P2 (access mode) */
@@ -583,8 +609,7 @@ gboolean g_ril_request_sim_write_record(GRil *gril,
 		parcel_w_int32(rilp, 0);
 
 	g_ril_append_print_buf(gril,
-				"%s%d,%d,%d,%s,pin2=(null),aid=%s)",
-				print_buf,
+				"%d,%d,%d,%s,pin2=(null),aid=%s)",
 				req->record,
 				p2,
 				req->length,
@@ -596,6 +621,7 @@ gboolean g_ril_request_sim_write_record(GRil *gril,
 	return TRUE;
 
 error:
+	g_free(hex_data);
 	return FALSE;
 }
 
@@ -607,7 +633,7 @@ void g_ril_request_read_imsi(GRil *gril,
 	parcel_w_int32(rilp, GET_IMSI_NUM_PARAMS);
 	parcel_w_string(rilp, aid_str);
 
-	g_ril_append_print_buf(gril, "(%d,%s)", GET_IMSI_NUM_PARAMS, aid_str);
+	g_ril_start_print_buf(gril, "(%d,%s)", GET_IMSI_NUM_PARAMS, aid_str);
 }
 
 void g_ril_request_pin_send(GRil *gril,
@@ -621,7 +647,7 @@ void g_ril_request_pin_send(GRil *gril,
 	parcel_w_string(rilp, passwd);
 	parcel_w_string(rilp, aid_str);
 
-	g_ril_append_print_buf(gril, "(%s,aid=%s)", passwd, aid_str);
+	g_ril_start_print_buf(gril, "(%s,aid=%s)", passwd, aid_str);
 }
 
 gboolean g_ril_request_pin_change_state(GRil *gril,
@@ -632,40 +658,40 @@ gboolean g_ril_request_pin_change_state(GRil *gril,
 
 	/*
 	 * TODO: clean up the use of string literals &
-	 * the multiple g_ril_append_print_buf() calls
+	 * the multiple g_ril_start_print_buf() calls
 	 * by using a table lookup as does the core sim code
 	 */
 	switch (req->passwd_type) {
 	case OFONO_SIM_PASSWORD_SIM_PIN:
-		g_ril_append_print_buf(gril, "(SC,");
+		g_ril_start_print_buf(gril, "(SC");
 		lock_type = "SC";
 		break;
 	case OFONO_SIM_PASSWORD_PHSIM_PIN:
-		g_ril_append_print_buf(gril, "(PS,");
+		g_ril_start_print_buf(gril, "(PS");
 		lock_type = "PS";
 		break;
 	case OFONO_SIM_PASSWORD_PHFSIM_PIN:
-		g_ril_append_print_buf(gril, "(PF,");
+		g_ril_start_print_buf(gril, "(PF");
 		lock_type = "PF";
 		break;
 	case OFONO_SIM_PASSWORD_SIM_PIN2:
-		g_ril_append_print_buf(gril, "(P2,");
+		g_ril_start_print_buf(gril, "(P2");
 		lock_type = "P2";
 		break;
 	case OFONO_SIM_PASSWORD_PHNET_PIN:
-		g_ril_append_print_buf(gril, "(PN,");
+		g_ril_start_print_buf(gril, "(PN");
 		lock_type = "PN";
 		break;
 	case OFONO_SIM_PASSWORD_PHNETSUB_PIN:
-		g_ril_append_print_buf(gril, "(PU,");
+		g_ril_start_print_buf(gril, "(PU");
 		lock_type = "PU";
 		break;
 	case OFONO_SIM_PASSWORD_PHSP_PIN:
-		g_ril_append_print_buf(gril, "(PP,");
+		g_ril_start_print_buf(gril, "(PP");
 		lock_type = "PP";
 		break;
 	case OFONO_SIM_PASSWORD_PHCORP_PIN:
-		g_ril_append_print_buf(gril, "(PC,");
+		g_ril_start_print_buf(gril, "(PC");
 		lock_type = "PC";
 		break;
 	default:
@@ -692,8 +718,7 @@ gboolean g_ril_request_pin_change_state(GRil *gril,
 
 	parcel_w_string(rilp, req->aid_str);
 
-	g_ril_append_print_buf(gril, "(%s,%d,%s,0,aid=%s)",
-				print_buf,
+	g_ril_append_print_buf(gril, ",%d,%s,0,aid=%s)",
 				req->enable,
 				req->passwd,
 				req->aid_str);
@@ -717,7 +742,7 @@ void g_ril_request_pin_send_puk(GRil *gril,
 	parcel_w_string(rilp, passwd);
 	parcel_w_string(rilp, aid_str);
 
-	g_ril_append_print_buf(gril, "(puk=%s,pin=%s,aid=%s)",
+	g_ril_start_print_buf(gril, "(puk=%s,pin=%s,aid=%s)",
 				puk, passwd, aid_str);
 }
 
@@ -734,7 +759,7 @@ void g_ril_request_change_passwd(GRil *gril,
 	parcel_w_string(rilp, new_passwd);
 	parcel_w_string(rilp, aid_str);
 
-	g_ril_append_print_buf(gril, "(old=%s,new=%s,aid=%s)",
+	g_ril_start_print_buf(gril, "(old=%s,new=%s,aid=%s)",
 				old_passwd, new_passwd, aid_str);
 }
 
@@ -745,7 +770,10 @@ void g_ril_request_sms_cmgs(GRil *gril,
 	int smsc_len;
 	char *tpdu;
 
-	parcel_init(rilp);
+	/* The TPDU is sent as a hex string, four UTF-16 bytes per octet */
+	parcel_init_sized(rilp, 2 * sizeof(int32_t) +
+				parcel_string_size(NULL) +
+				4 * (req->tpdu_len + 1));
 	parcel_w_int32(rilp, 2);	/* Number of strings */
 
 	/*
@@ -773,7 +801,7 @@ void g_ril_request_sms_cmgs(GRil *gril,
 	tpdu = encode_hex(req->pdu + smsc_len, req->tpdu_len, 0);
 	parcel_w_string(rilp, tpdu);
 
-	g_ril_append_print_buf(gril, "(%s)", tpdu);
+	g_ril_start_print_buf(gril, "(%s)", tpdu);
 
 	g_free(tpdu);
 }
@@ -786,7 +814,7 @@ void g_ril_request_sms_acknowledge(GRil *gril,
 	parcel_w_int32(rilp, 1); /* Successful receipt */
 	parcel_w_int32(rilp, 0); /* error code */
 
-	g_ril_append_print_buf(gril, "(1,0)");
+	g_ril_start_print_buf(gril, "(1,0)");
 }
 
 void g_ril_request_set_smsc_address(GRil *gril,
@@ -803,7 +831,7 @@ void g_ril_request_set_smsc_address(GRil *gril,
 	parcel_init(rilp);
 	parcel_w_string(rilp, number);
 
-	g_ril_append_print_buf(gril, "(%s)", number);
+	g_ril_start_print_buf(gril, "(%s)", number);
 }
 
 void g_ril_request_dial(GRil *gril,
@@ -822,7 +850,7 @@ void g_ril_request_dial(GRil *gril,
 	parcel_w_int32(rilp, 0);
 	parcel_w_int32(rilp, 0);
 
-	g_ril_append_print_buf(gril, "(%s,%d,0,0)",
+	g_ril_start_print_buf(gril, "(%s,%d,0,0)",
 				phone_number_to_string(ph),
 				clir);
 }
@@ -831,11 +859,10 @@ void g_ril_request_hangup(GRil *gril,
 				unsigned call_id,
 				struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1); /* Always 1 - AT+CHLD=1x */
-	parcel_w_int32(rilp, call_id);
+	int id = call_id;
 
-	g_ril_append_print_buf(gril, "(%u)", call_id);
+	/* Always 1 - AT+CHLD=1x */
+	g_ril_schema_encode(gril, &ril_schema_int1, &id, rilp);
 }
 
 void g_ril_request_dtmf(GRil *gril,
@@ -850,40 +877,28 @@ void g_ril_request_dtmf(GRil *gril,
 	ril_dtmf[1] = '\0';
 	parcel_w_string(rilp, ril_dtmf);
 
-	g_ril_append_print_buf(gril, "(%s)", ril_dtmf);
+	g_ril_start_print_buf(gril, "(%s)", ril_dtmf);
 }
 
 void g_ril_request_separate_conn(GRil *gril,
 					int call_id,
 					struct parcel *rilp)
 {
-	parcel_init(rilp);
-
 	/* Payload is an array that holds just one element */
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, call_id);
-
-	g_ril_append_print_buf(gril, "(%d)", call_id);
+	g_ril_schema_encode(gril, &ril_schema_int1, &call_id, rilp);
 }
 
 void g_ril_request_set_supp_svc_notif(GRil *gril,
 					struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1); /* size of array */
-	parcel_w_int32(rilp, 1); /* notifications enabled */
+	static const int enabled = 1;
 
-	g_ril_append_print_buf(gril, "(1)");
+	g_ril_schema_encode(gril, &ril_schema_int1, &enabled, rilp);
 }
 
 void g_ril_request_set_mute(GRil *gril, int muted, struct parcel *rilp)
 {
-	parcel_init(rilp);
-
-	parcel_w_int32(rilp, 1);
-	parcel_w_int32(rilp, muted);
-
-	g_ril_append_print_buf(gril, "(%d)", muted);
+	g_ril_schema_encode(gril, &ril_schema_int1, &muted, rilp);
 }
 
 void g_ril_request_send_ussd(GRil *gril,
@@ -893,7 +908,7 @@ void g_ril_request_send_ussd(GRil *gril,
 	parcel_init(rilp);
 	parcel_w_string(rilp, ussd);
 
-	g_ril_append_print_buf(gril, "(%s)", ussd);
+	g_ril_start_print_buf(gril, "(%s)", ussd);
 }
 
 void g_ril_request_set_call_waiting(GRil *gril,
@@ -918,7 +933,7 @@ void g_ril_request_set_call_waiting(GRil *gril,
 
 	parcel_w_int32(rilp, serviceclass);	/* Service class */
 
-	g_ril_append_print_buf(gril, "(%d, 0x%x)", enabled, serviceclass);
+	g_ril_start_print_buf(gril, "(%d, 0x%x)", enabled, serviceclass);
 }
 
 void g_ril_request_query_call_waiting(GRil *gril,
@@ -934,30 +949,21 @@ void g_ril_request_query_call_waiting(GRil *gril,
 	 */
 	parcel_w_int32(rilp, 0);
 
-	g_ril_append_print_buf(gril, "(0)");
+	g_ril_start_print_buf(gril, "(0)");
 }
 
 void g_ril_request_set_clir(GRil *gril,
 				int mode,
 				struct parcel *rilp)
 {
-	parcel_init(rilp);
-
-	parcel_w_int32(rilp, 1);	/* Number of params */
-	parcel_w_int32(rilp, mode);
-
-	g_ril_append_print_buf(gril, "(%d)", mode);
+	g_ril_schema_encode(gril, &ril_schema_int1, &mode, rilp);
 }
 
 void g_ril_request_screen_state(GRil *gril,
 				int state,
 				struct parcel *rilp)
 {
-	parcel_init(rilp);
-	parcel_w_int32(rilp, 1);	/* Number of params */
-	parcel_w_int32(rilp, state);
-
-	g_ril_append_print_buf(gril, "(%d)", state);
+	g_ril_schema_encode(gril, &ril_schema_int1, &state, rilp);
 }
 
 void g_ril_request_call_fwd(GRil *gril,	const struct req_call_fwd *req,
@@ -969,14 +975,14 @@ void g_ril_request_call_fwd(GRil *gril,	const struct req_call_fwd *req,
 	parcel_w_int32(rilp, req->type);
 	parcel_w_int32(rilp, req->cls);
 
-	g_ril_append_print_buf(gril, "(type: %d cls: %d ", req->type, req->cls);
+	g_ril_start_print_buf(gril, "(type: %d cls: %d ", req->type, req->cls);
 
 	if (req->number != NULL) {
 		parcel_w_int32(rilp, req->number->type);
 		parcel_w_string(rilp, (char *) req->number->number);
 
-		g_ril_append_print_buf(gril, "%s number type: %d number: "
-					"%s time: %d) ", print_buf,
+		g_ril_append_print_buf(gril, " number type: %d number: "
+					"%s time: %d) ",
 					req->number->type, req->number->number,
 					req->time);
 	} else {
@@ -989,8 +995,8 @@ void g_ril_request_call_fwd(GRil *gril,	const struct req_call_fwd *req,
 
 		parcel_w_int32(rilp, 0x81);		/* TOA unknown */
 		parcel_w_string(rilp, "1234567890");
-		g_ril_append_print_buf(gril, "%s number type: %d number: "
-					"%s time: %d) ", print_buf,
+		g_ril_append_print_buf(gril, " number type: %d number: "
+					"%s time: %d) ",
 					0x81, "1234567890",
 					req->time);
 
@@ -1002,12 +1008,7 @@ void g_ril_request_call_fwd(GRil *gril,	const struct req_call_fwd *req,
 void g_ril_request_set_preferred_network_type(GRil *gril, int net_type,
 						struct parcel *rilp)
 {
-	parcel_init(rilp);
-
-	parcel_w_int32(rilp, 1);	/* Number of params */
-	parcel_w_int32(rilp, net_type);
-
-	g_ril_append_print_buf(gril, "(%d)", net_type);
+	g_ril_schema_encode(gril, &ril_schema_int1, &net_type, rilp);
 }
 
 void g_ril_request_query_facility_lock(GRil *gril, const char *facility,
@@ -1025,7 +1026,7 @@ void g_ril_request_query_facility_lock(GRil *gril, const char *facility,
 	parcel_w_string(rilp, svcs_str);
 	parcel_w_string(rilp, NULL);	/* AID (for FDN, not yet supported) */
 
-	g_ril_append_print_buf(gril, "(%s,%s,%s,(null))",
+	g_ril_start_print_buf(gril, "(%s,%s,%s,(null))",
 				facility, password, svcs_str);
 }
 
@@ -1050,7 +1051,7 @@ void g_ril_request_set_facility_lock(GRil *gril, const char *facility,
 	parcel_w_string(rilp, svcs_str);
 	parcel_w_string(rilp, NULL);	/* AID (for FDN, not yet supported) */
 
-	g_ril_append_print_buf(gril, "(%s,%s,%s,%s,(null))",
+	g_ril_start_print_buf(gril, "(%s,%s,%s,%s,(null))",
 				facility, enable_str, passwd, svcs_str);
 }
 
@@ -1066,7 +1067,7 @@ void g_ril_request_change_barring_password(GRil *gril, const char *facility,
 	parcel_w_string(rilp, old_passwd);
 	parcel_w_string(rilp, new_passwd);
 
-	g_ril_append_print_buf(gril, "(%s,%s,%s)",
+	g_ril_start_print_buf(gril, "(%s,%s,%s)",
 				facility, old_passwd, new_passwd);
 }
 
@@ -1075,13 +1076,13 @@ void g_ril_request_oem_hook_raw(GRil *gril, const void *payload, size_t length,
 {
 	char *hex_dump = NULL;
 
-	parcel_init(rilp);
+	parcel_init_sized(rilp, sizeof(int32_t) + length);
 	parcel_w_raw(rilp, payload, length);
 
 	if (payload != NULL)
 		hex_dump = encode_hex(payload, length, '\0');
 
-	g_ril_append_print_buf(gril, "(%s)", hex_dump ? hex_dump : "(null)");
+	g_ril_start_print_buf(gril, "(%s)", hex_dump ? hex_dump : "(null)");
 	g_free(hex_dump);
 }
 
@@ -1093,17 +1094,15 @@ void g_ril_request_oem_hook_strings(GRil *gril, const char **strs, int num_str,
 	parcel_init(rilp);
 	parcel_w_int32(rilp, num_str);
 
-	g_ril_append_print_buf(gril, "(");
+	g_ril_start_print_buf(gril, "(");
 
 	for (i = 0; i < num_str; ++i) {
 		parcel_w_string(rilp, strs[i]);
 
 		if (i == num_str - 1)
-			g_ril_append_print_buf(gril, "%s%s)",
-							print_buf, strs[i]);
+			g_ril_append_print_buf(gril, "%s)", strs[i]);
 		else
-			g_ril_append_print_buf(gril, "%s%s, ",
-							print_buf, strs[i]);
+			g_ril_append_print_buf(gril, "%s, ", strs[i]);
 	}
 }
 
@@ -1129,25 +1128,25 @@ void g_ril_request_set_initial_attach_apn(GRil *gril, const char *apn,
 	parcel_w_string(rilp, user);
 	parcel_w_string(rilp, passwd);
 
-	g_ril_append_print_buf(gril, "(%s,%s,%s,%s,%s", apn, proto_str,
+	g_ril_start_print_buf(gril, "(%s,%s,%s,%s,%s", apn, proto_str,
 				ril_authtype_to_string(auth_type),
 				user, passwd);
 
 	if (vendor == OFONO_RIL_VENDOR_MTK || vendor == OFONO_RIL_VENDOR_MTK2) {
 		parcel_w_string(rilp, mccmnc);
-		g_ril_append_print_buf(gril, "%s,%s", print_buf, mccmnc);
+		g_ril_append_print_buf(gril, ",%s", mccmnc);
 		if (vendor == OFONO_RIL_VENDOR_MTK2) {
 			int can_handle_ims = 0;
 
 			parcel_w_int32(rilp, can_handle_ims);
 			/* dualApnPlmnList */
 			parcel_w_string(rilp, NULL);
-			g_ril_append_print_buf(gril, "%s,%d,(null)", print_buf,
+			g_ril_append_print_buf(gril, ",%d,(null)",
 								can_handle_ims);
 		}
 	}
 
-	g_ril_append_print_buf(gril, "%s)", print_buf);
+	g_ril_append_print_buf(gril, ")");
 }
 
 void g_ril_request_set_uicc_subscription(GRil *gril, int slot_id,
@@ -1163,7 +1162,7 @@ void g_ril_request_set_uicc_subscription(GRil *gril, int slot_id,
 	parcel_w_int32(rilp, sub_id);
 	parcel_w_int32(rilp, sub_status);
 
-	g_ril_append_print_buf(gril, "(%d, %d, %d, %d(%s))",
+	g_ril_start_print_buf(gril, "(%d, %d, %d, %d(%s))",
 				slot_id,
 				app_index,
 				sub_id,
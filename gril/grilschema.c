@@ -0,0 +1,210 @@
+/*
+ *
+ *  RIL library with GLib integration
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include <ofono/log.h>
+
+#include "arena.h"
+#include "grilschema.h"
+
+#define FIELD_PTR(data, f) ((char *) (data) + (f)->offset)
+#define FIELD_INT(data, f) (*(int *) (void *) FIELD_PTR(data, f))
+#define FIELD_STR(data, f) (*(char **) (void *) FIELD_PTR(data, f))
+
+static const struct ril_field int1_fields[] = {
+	RIL_FIELD_FIXED(1),
+	{ .type = RIL_FIELD_INT32, .name = "value", .offset = 0 },
+};
+
+const struct ril_schema ril_schema_int1 = RIL_SCHEMA("int1", int1_fields);
+
+static gboolean field_present(const struct ril_field *f, int version,
+				enum ofono_ril_vendor vendor)
+{
+	if (f->min_version > 0 && version < f->min_version)
+		return FALSE;
+
+	if (f->vendors != 0 && (f->vendors & RIL_VENDOR_BIT(vendor)) == 0)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void schema_trace(GRil *gril, const struct ril_schema *schema,
+				const void *data, char open, char close)
+{
+	int version = g_ril_get_version(gril);
+	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
+	const struct ril_field *f;
+	const char *sep = "";
+	unsigned int i;
+
+	g_ril_start_print_buf(gril, "%c", open);
+
+	for (i = 0; i < schema->n_fields; i++) {
+		f = &schema->fields[i];
+
+		if (f->type == RIL_FIELD_CONST ||
+				!field_present(f, version, vendor))
+			continue;
+
+		switch (f->type) {
+		case RIL_FIELD_INT32:
+			g_ril_append_print_buf(gril, "%s%d", sep,
+						FIELD_INT(data, f));
+			break;
+		case RIL_FIELD_HEX32:
+			g_ril_append_print_buf(gril, "%s0x%.2X",
+						sep, FIELD_INT(data, f));
+			break;
+		case RIL_FIELD_STRING:
+			g_ril_append_print_buf(gril, "%s%s", sep,
+						FIELD_STR(data, f));
+			break;
+		case RIL_FIELD_STRBUF:
+			g_ril_append_print_buf(gril, "%s%s", sep,
+						FIELD_PTR(data, f));
+			break;
+		case RIL_FIELD_CONST:
+			break;
+		}
+
+		sep = ",";
+	}
+
+	g_ril_append_print_buf(gril, "%c", close);
+}
+
+void g_ril_schema_encode(GRil *gril, const struct ril_schema *schema,
+				const void *data, struct parcel *rilp)
+{
+	int version = g_ril_get_version(gril);
+	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
+	const struct ril_field *f;
+	size_t size = 0;
+	unsigned int i;
+
+	for (i = 0; i < schema->n_fields; i++) {
+		f = &schema->fields[i];
+
+		if (!field_present(f, version, vendor))
+			continue;
+
+		switch (f->type) {
+		case RIL_FIELD_INT32:
+		case RIL_FIELD_HEX32:
+		case RIL_FIELD_CONST:
+			size += sizeof(int32_t);
+			break;
+		case RIL_FIELD_STRING:
+			size += parcel_string_size(FIELD_STR(data, f));
+			break;
+		case RIL_FIELD_STRBUF:
+			size += parcel_string_size(FIELD_PTR(data, f));
+			break;
+		}
+	}
+
+	parcel_init_sized(rilp, size);
+
+	for (i = 0; i < schema->n_fields; i++) {
+		f = &schema->fields[i];
+
+		if (!field_present(f, version, vendor))
+			continue;
+
+		switch (f->type) {
+		case RIL_FIELD_INT32:
+		case RIL_FIELD_HEX32:
+			parcel_w_int32(rilp, FIELD_INT(data, f));
+			break;
+		case RIL_FIELD_CONST:
+			parcel_w_int32(rilp, f->value);
+			break;
+		case RIL_FIELD_STRING:
+			parcel_w_string(rilp, FIELD_STR(data, f));
+			break;
+		case RIL_FIELD_STRBUF:
+			parcel_w_string(rilp, FIELD_PTR(data, f));
+			break;
+		}
+	}
+
+	if (gril && g_ril_get_trace(gril))
+		schema_trace(gril, schema, data, '(', ')');
+}
+
+gboolean g_ril_schema_decode(GRil *gril, const struct ril_schema *schema,
+				struct parcel *rilp, void *data,
+				struct arena *arena)
+{
+	int version = g_ril_get_version(gril);
+	enum ofono_ril_vendor vendor = g_ril_vendor(gril);
+	const struct ril_field *f = NULL;
+	unsigned int i;
+
+	for (i = 0; i < schema->n_fields && !rilp->malformed; i++) {
+		f = &schema->fields[i];
+
+		if (!field_present(f, version, vendor))
+			continue;
+
+		switch (f->type) {
+		case RIL_FIELD_INT32:
+		case RIL_FIELD_HEX32:
+			FIELD_INT(data, f) = parcel_r_int32(rilp);
+			break;
+		case RIL_FIELD_CONST:
+			/* Arrays may carry more elements than we know of */
+			if (parcel_r_int32(rilp) < f->value)
+				rilp->malformed = 1;
+			break;
+		case RIL_FIELD_STRING:
+			if (arena)
+				FIELD_STR(data, f) =
+					parcel_r_string_arena(rilp, arena);
+			else
+				FIELD_STR(data, f) = parcel_r_string(rilp);
+			break;
+		case RIL_FIELD_STRBUF:
+			parcel_r_string_buf(rilp, FIELD_PTR(data, f), f->size);
+			break;
+		}
+	}
+
+	if (rilp->malformed) {
+		ofono_error("%s: malformed parcel at field %s", schema->name,
+				f ? f->name : "(none)");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void g_ril_schema_trace(GRil *gril, const struct ril_schema *schema,
+				const void *data)
+{
+	if (gril && g_ril_get_trace(gril))
+		schema_trace(gril, schema, data, '{', '}');
+}
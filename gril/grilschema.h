@@ -0,0 +1,110 @@
+/*
+ *
+ *  RIL library with GLib integration
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __GRILSCHEMA_H
+#define __GRILSCHEMA_H
+
+#include <stddef.h>
+
+#include "gril.h"
+#include "parcel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Declarative description of flat RIL parcels.  A schema lists the
+ * fields of a parcel in wire order together with where each one lives
+ * in a C structure, so a single encoder, decoder and tracer can handle
+ * every message that fits the model.  Fields can be restricted to
+ * newer RIL versions or to some vendors; absent fields are neither
+ * written nor read, and are left untouched in the structure.
+ */
+
+enum ril_field_type {
+	RIL_FIELD_INT32,	/* int, traced in decimal */
+	RIL_FIELD_HEX32,	/* int, traced in hexadecimal */
+	RIL_FIELD_CONST,	/* fixed value (array length), not traced */
+	RIL_FIELD_STRING,	/* char *, NULL allowed */
+	RIL_FIELD_STRBUF,	/* char array of 'size' bytes */
+};
+
+struct ril_field {
+	enum ril_field_type type;
+	const char *name;
+	size_t offset;
+	size_t size;
+	int value;
+	int min_version;
+	unsigned int vendors;
+};
+
+struct ril_schema {
+	const char *name;
+	const struct ril_field *fields;
+	unsigned int n_fields;
+};
+
+#define RIL_VENDOR_BIT(vendor) (1U << (vendor))
+
+#define RIL_FIELD_INT(st, member) \
+	{ .type = RIL_FIELD_INT32, .name = #member, \
+		.offset = offsetof(st, member) }
+#define RIL_FIELD_HEX(st, member) \
+	{ .type = RIL_FIELD_HEX32, .name = #member, \
+		.offset = offsetof(st, member) }
+#define RIL_FIELD_STR(st, member) \
+	{ .type = RIL_FIELD_STRING, .name = #member, \
+		.offset = offsetof(st, member) }
+#define RIL_FIELD_BUF(st, member) \
+	{ .type = RIL_FIELD_STRBUF, .name = #member, \
+		.offset = offsetof(st, member), \
+		.size = sizeof(((st *) 0)->member) }
+#define RIL_FIELD_FIXED(val) \
+	{ .type = RIL_FIELD_CONST, .name = "count", .value = (val) }
+
+#define RIL_SCHEMA(sname, fieldv) \
+	{ .name = (sname), .fields = (fieldv), \
+		.n_fields = G_N_ELEMENTS(fieldv) }
+
+/* The common one element integer array: { 1, value } */
+extern const struct ril_schema ril_schema_int1;
+
+void g_ril_schema_encode(GRil *gril, const struct ril_schema *schema,
+				const void *data, struct parcel *rilp);
+
+/*
+ * Strings are allocated from arena when it is given, with g_malloc
+ * otherwise.  Returns FALSE if the parcel is malformed, in which case
+ * the strings already decoded are still owned by the caller.
+ */
+gboolean g_ril_schema_decode(GRil *gril, const struct ril_schema *schema,
+				struct parcel *rilp, void *data,
+				struct arena *arena);
+
+/* Appends "{field,...}" for decoded data to the print buffer */
+void g_ril_schema_trace(GRil *gril, const struct ril_schema *schema,
+				const void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GRILSCHEMA_H */
@@ -38,6 +38,8 @@
 
 #include "common.h"
 #include "grilunsol.h"
+#include "grilschema.h"
+#include "arena.h"
 
 /* Minimum size is two int32s version/number of calls */
 #define MIN_DATA_CALL_LIST_SIZE 8
@@ -76,7 +78,7 @@ int g_ril_unsol_parse_connected(GRil *gril, const struct ril_msg *message)
 		version = RIL_VERSION_UNSPECIFIED;
 	}
 
-	g_ril_append_print_buf(gril, "{size: %d, [%d]}", size, version);
+	g_ril_start_print_buf(gril, "{size: %d, [%d]}", size, version);
 	g_ril_print_unsol(gril, message);
 
 	return version;
@@ -96,64 +98,49 @@ static gint data_call_compare(gconstpointer a, gconstpointer b)
 	return 0;
 }
 
-static void free_data_call(gpointer data, gpointer user_data)
-{
-	struct ril_data_call *call = data;
-
-	if (call) {
-		g_free(call->ifname);
-		g_free(call->ip_addr);
-		g_free(call->dns_addrs);
-		g_free(call->gateways);
-		g_free(call);
-	}
-}
-
 void g_ril_unsol_free_data_call_list(struct ril_data_call_list *call_list)
 {
-	if (call_list) {
-		g_slist_foreach(call_list->calls, (GFunc) free_data_call, NULL);
-		g_slist_free(call_list->calls);
-		g_free(call_list);
-	}
+	if (call_list)
+		arena_free(call_list->arena);
 }
 
-static gboolean handle_settings(struct ril_data_call *call, char *type,
+static gboolean handle_settings(struct arena *arena,
+				struct ril_data_call *call, char *type,
 				char *ifname, char *raw_ip_addrs,
 				char *raw_dns, char *raw_gws)
 {
-	gboolean result = FALSE;
 	int protocol;
 	char **dns_addrs = NULL, **gateways = NULL;
-	char **ip_addrs = NULL, **split_ip_addr = NULL;
+	char **ip_addrs = NULL;
+	const char *prefix;
 
 	protocol = ril_protocol_string_to_ofono_protocol(type);
 	if (protocol < 0) {
 		ofono_error("%s: invalid type(protocol) specified: %s",
 				__func__, type);
-		goto done;
+		return FALSE;
 	}
 
 	if (ifname == NULL || strlen(ifname) == 0) {
 		ofono_error("%s: no interface specified: %s",
 				__func__, ifname);
-		goto done;
+		return FALSE;
 	}
 
 	/* Split DNS addresses */
 	if (raw_dns)
-		dns_addrs = g_strsplit(raw_dns, " ", 3);
+		dns_addrs = arena_strsplit(arena, raw_dns, ' ', 3);
 
 	/*
 	 * RILD can return multiple addresses; oFono only supports
 	 * setting a single IPv4 gateway.
 	 */
 	if (raw_gws)
-		gateways = g_strsplit(raw_gws, " ", 3);
+		gateways = arena_strsplit(arena, raw_gws, ' ', 3);
 
 	if (gateways == NULL || g_strv_length(gateways) == 0) {
 		ofono_error("%s: no gateways: %s", __func__, raw_gws);
-		goto done;
+		return FALSE;
 	}
 
 	/* TODO:
@@ -168,11 +155,11 @@ static gboolean handle_settings(struct ril_data_call *call, char *type,
 	 * the first address for the remaining operations.
 	 */
 	if (raw_ip_addrs)
-		ip_addrs = g_strsplit(raw_ip_addrs, " ", 3);
+		ip_addrs = arena_strsplit(arena, raw_ip_addrs, ' ', 3);
 
 	if (ip_addrs == NULL || g_strv_length(ip_addrs) == 0) {
 		ofono_error("%s: no IP address: %s", __func__, raw_ip_addrs);
-		goto done;
+		return FALSE;
 	}
 
 	DBG("num ip addrs is: %d", g_strv_length(ip_addrs));
@@ -185,37 +172,17 @@ static gboolean handle_settings(struct ril_data_call *call, char *type,
 	 * ( Eg. "/30" ).  As this confuses NetworkManager, we
 	 * explicitly strip any prefix after calculating the netmask.
 	 */
-	split_ip_addr = g_strsplit(ip_addrs[0], "/", 2);
-
-	if (split_ip_addr == NULL || g_strv_length(split_ip_addr) == 0) {
-		ofono_error("%s: invalid IP address field returned: %s",
-				__func__, ip_addrs[0]);
-		goto done;
-	}
+	prefix = strchr(ip_addrs[0], '/');
 
 	call->protocol = protocol;
-	call->ifname = g_strdup(ifname);
-	call->ip_addr = g_strdup(split_ip_addr[0]);
-	call->dns_addrs = g_strdupv(dns_addrs);
-	call->gateways = g_strdupv(gateways);
-
-	result = TRUE;
-
-done:
-	if (dns_addrs)
-		g_strfreev(dns_addrs);
-
-	if (gateways)
-		g_strfreev(gateways);
-
-	if (ip_addrs)
-		g_strfreev(ip_addrs);
-
-	if (split_ip_addr)
-		g_strfreev(split_ip_addr);
-
-
-	return result;
+	call->ifname = ifname;
+	call->ip_addr = prefix ? arena_strndup(arena, ip_addrs[0],
+						prefix - ip_addrs[0]) :
+				ip_addrs[0];
+	call->dns_addrs = dns_addrs;
+	call->gateways = gateways;
+
+	return TRUE;
 }
 
 /*
@@ -229,30 +196,31 @@ struct ril_data_call_list *g_ril_unsol_parse_data_call_list(GRil *gril,
 	struct ril_data_call *call;
 	struct parcel rilp;
 	struct ril_data_call_list *reply = NULL;
+	struct arena *arena;
 	unsigned int active, cid, i, num_calls, retry, status;
-	char *type = NULL, *ifname = NULL, *raw_addrs = NULL;
-	char *raw_dns = NULL, *raw_gws = NULL;
+	char *type, *ifname, *raw_addrs, *raw_dns, *raw_gws;
+	gboolean setup = message->req == RIL_REQUEST_SETUP_DATA_CALL;
 
 	DBG("");
 
 	/* Can happen for RIL_REQUEST_DATA_CALL_LIST replies */
 	if (message->buf_len < MIN_DATA_CALL_LIST_SIZE) {
-		if (message->req == RIL_REQUEST_SETUP_DATA_CALL) {
+		if (setup) {
 			ofono_error("%s: message too small: %d",
 					__func__,
 					(int) message->buf_len);
 			goto error;
 		} else {
-			g_ril_append_print_buf(gril, "{");
+			g_ril_start_print_buf(gril, "{");
 			goto done;
 		}
 	}
 
-	reply = g_try_new0(struct ril_data_call_list, 1);
-	if (reply == NULL) {
-		ofono_error("%s: out of memory", __func__);
-		goto error;
-	}
+	/* Room for the strings and their split copies */
+	arena = arena_new(sizeof(*reply) + message->buf_len * 2);
+
+	reply = arena_new0(arena, struct ril_data_call_list);
+	reply->arena = arena;
 
 	g_ril_init_parcel(message, &rilp);
 
@@ -265,7 +233,7 @@ struct ril_data_call_list *g_ril_unsol_parse_data_call_list(GRil *gril,
 	reply->version = parcel_r_int32(&rilp);
 	num_calls = parcel_r_int32(&rilp);
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"{version=%d,num=%d",
 				reply->version,
 				num_calls);
@@ -275,11 +243,11 @@ struct ril_data_call_list *g_ril_unsol_parse_data_call_list(GRil *gril,
 		retry = parcel_r_int32(&rilp);          /* ignore */
 		cid = parcel_r_int32(&rilp);
 		active = parcel_r_int32(&rilp);
-		type = parcel_r_string(&rilp);
-		ifname = parcel_r_string(&rilp);
-		raw_addrs = parcel_r_string(&rilp);
-		raw_dns = parcel_r_string(&rilp);
-		raw_gws = parcel_r_string(&rilp);
+		type = parcel_r_string_arena(&rilp, arena);
+		ifname = parcel_r_string_arena(&rilp, arena);
+		raw_addrs = parcel_r_string_arena(&rilp, arena);
+		raw_dns = parcel_r_string_arena(&rilp, arena);
+		raw_gws = parcel_r_string_arena(&rilp, arena);
 
 		/* malformed check */
 		if (rilp.malformed) {
@@ -288,10 +256,9 @@ struct ril_data_call_list *g_ril_unsol_parse_data_call_list(GRil *gril,
 		}
 
 		g_ril_append_print_buf(gril,
-					"%s [status=%d,retry=%d,cid=%d,"
+					" [status=%d,retry=%d,cid=%d,"
 					"active=%d,type=%s,ifname=%s,"
 					"address=%s,dns=%s,gateways=%s]",
-					print_buf,
 					status,
 					retry,
 					cid,
@@ -302,35 +269,28 @@ struct ril_data_call_list *g_ril_unsol_parse_data_call_list(GRil *gril,
 					raw_dns,
 					raw_gws);
 
-		call = g_try_new0(struct ril_data_call, 1);
-		if (call == NULL) {
-			ofono_error("%s: out of memory", __func__);
-			goto error;
-		}
-
+		call = arena_new0(arena, struct ril_data_call);
 		call->status = status;
 		call->cid = cid;
 		call->active = active;
 
-		if (message->req == RIL_REQUEST_SETUP_DATA_CALL &&
-			status == PDP_FAIL_NONE &&
-			handle_settings(call, type, ifname, raw_addrs,
-					raw_dns, raw_gws) == FALSE)
+		/*
+		 * Lists carry the settings of live calls too, they are what
+		 * changes are detected against.  Only a SETUP_DATA_CALL reply
+		 * is unusable without them, a listed call just keeps none.
+		 */
+		if (status == PDP_FAIL_NONE && (active || setup) &&
+			handle_settings(arena, call, type, ifname, raw_addrs,
+					raw_dns, raw_gws) == FALSE && setup)
 			goto error;
 
-		g_free(type);
-		g_free(ifname);
-		g_free(raw_addrs);
-		g_free(raw_dns);
-		g_free(raw_gws);
-
-		reply->calls =
-			g_slist_insert_sorted(reply->calls, call,
-						data_call_compare);
+		reply->calls = arena_slist_insert_sorted(arena, reply->calls,
+							call,
+							data_call_compare);
 	}
 
 done:
-	g_ril_append_print_buf(gril, "%s}", print_buf);
+	g_ril_append_print_buf(gril, "}");
 
 	if (message->unsolicited)
 		g_ril_print_unsol(gril, message);
@@ -340,11 +300,6 @@ done:
 	return reply;
 
 error:
-	g_free(type);
-	g_free(ifname);
-	g_free(raw_addrs);
-	g_free(raw_dns);
-	g_free(raw_gws);
 	g_ril_unsol_free_data_call_list(reply);
 
 	return NULL;
@@ -368,7 +323,7 @@ char *g_ril_unsol_parse_nitz(GRil *gril, const struct ril_msg *message)
 
 	nitz = parcel_r_string(&rilp);
 
-	g_ril_append_print_buf(gril, "(%s)", nitz);
+	g_ril_start_print_buf(gril, "(%s)", nitz);
 	g_ril_print_unsol(gril, message);
 
 error:
@@ -414,7 +369,7 @@ struct unsol_sms_data *g_ril_unsol_parse_new_sms(GRil *gril,
 		goto error_dec;
 	}
 
-	g_ril_append_print_buf(gril, "{%s}", ril_pdu);
+	g_ril_start_print_buf(gril, "{%s}", ril_pdu);
 	g_ril_print_unsol(gril, message);
 
 	g_free(ril_pdu);
@@ -443,7 +398,7 @@ int g_ril_unsol_parse_radio_state_changed(GRil *gril,
 		radio_state = -1;
 	}
 
-	g_ril_append_print_buf(gril, "(state: %s)",
+	g_ril_start_print_buf(gril, "(state: %s)",
 				ril_radio_state_to_string(radio_state));
 
 	g_ril_print_unsol(gril, message);
@@ -553,7 +508,7 @@ int g_ril_unsol_parse_signal_strength(GRil *gril, const struct ril_msg *message,
 		lte_signal = -1;
 	}
 
-	g_ril_append_print_buf(gril,
+	g_ril_start_print_buf(gril,
 				"{gw: %d, cdma: %d, evdo: %d, lte: %d %d %d}",
 				gw_sigstr, cdma_dbm, evdo_dbm, lte_sigstr,
 				lte_rsrp, lte_rssnr);
@@ -584,35 +539,34 @@ void g_ril_unsol_free_supp_svc_notif(struct unsol_supp_svc_notif *unsol)
 	g_free(unsol);
 }
 
+static const struct ril_field supp_svc_notif_fields[] = {
+	RIL_FIELD_INT(struct unsol_supp_svc_notif, notif_type),
+	RIL_FIELD_INT(struct unsol_supp_svc_notif, code),
+	RIL_FIELD_INT(struct unsol_supp_svc_notif, index),
+	RIL_FIELD_INT(struct unsol_supp_svc_notif, number.type),
+	RIL_FIELD_BUF(struct unsol_supp_svc_notif, number.number),
+};
+
+static const struct ril_schema supp_svc_notif_schema =
+	RIL_SCHEMA("SUPP_SVC_NOTIFICATION", supp_svc_notif_fields);
+
 struct unsol_supp_svc_notif *g_ril_unsol_parse_supp_svc_notif(GRil *gril,
 						struct ril_msg *message)
 {
 	struct parcel rilp;
-	char *tmp_number;
-	int type;
 	struct unsol_supp_svc_notif *unsol =
 		g_new0(struct unsol_supp_svc_notif, 1);
 
 	g_ril_init_parcel(message, &rilp);
+	g_ril_schema_decode(gril, &supp_svc_notif_schema, &rilp, unsol, NULL);
 
-	unsol->notif_type = parcel_r_int32(&rilp);
-	unsol->code = parcel_r_int32(&rilp);
-	unsol->index = parcel_r_int32(&rilp);
-	type = parcel_r_int32(&rilp);
-	tmp_number = parcel_r_string(&rilp);
-
-	if (tmp_number != NULL) {
-		strncpy(unsol->number.number, tmp_number,
-			OFONO_MAX_PHONE_NUMBER_LENGTH);
-		unsol->number.type = type;
-		g_free(tmp_number);
-	}
-
-	g_ril_append_print_buf(gril, "{%d,%d,%d,%d,%s}",
-				unsol->notif_type, unsol->code, unsol->index,
-				type, tmp_number);
+	g_ril_schema_trace(gril, &supp_svc_notif_schema, unsol);
 	g_ril_print_unsol(gril, message);
 
+	/* The type is meaningless without a number */
+	if (unsol->number.number[0] == '\0')
+		unsol->number.type = 0;
+
 	return unsol;
 }
 
@@ -628,7 +582,7 @@ struct unsol_ussd *g_ril_unsol_parse_ussd(GRil *gril, struct ril_msg *message)
 {
 	struct parcel rilp;
 	struct unsol_ussd *ussd;
-	char *typestr = NULL;
+	char typestr[2];
 	int numstr;
 
 	ussd = g_try_malloc0(sizeof(*ussd));
@@ -645,27 +599,24 @@ struct unsol_ussd *g_ril_unsol_parse_ussd(GRil *gril, struct ril_msg *message)
 		goto error;
 	}
 
-	typestr = parcel_r_string(&rilp);
-	if (typestr == NULL || *typestr == '\0') {
+	/* Only the first digit matters */
+	if (parcel_r_string_buf(&rilp, typestr, sizeof(typestr)) <= 0) {
 		ofono_error("%s wrong type", __func__);
 		goto error;
 	}
 
 	ussd->type = *typestr - '0';
 
-	g_free(typestr);
-
 	if (numstr > 1)
 		ussd->message = parcel_r_string(&rilp);
 
-	g_ril_append_print_buf(gril, "{%d,%s}", ussd->type, ussd->message);
+	g_ril_start_print_buf(gril, "{%d,%s}", ussd->type, ussd->message);
 
 	g_ril_print_unsol(gril, message);
 
 	return ussd;
 
 error:
-	g_free(typestr);
 	g_free(ussd);
 
 	return NULL;
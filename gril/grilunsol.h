@@ -42,9 +42,11 @@ struct ril_data_call {
 	gchar **gateways;
 };
 
+/* The list and the calls are allocated from arena */
 struct ril_data_call_list {
 	guint version;
 	GSList *calls;
+	struct arena *arena;
 };
 
 struct unsol_sms_data {
@@ -42,25 +42,54 @@
 #include <limits.h>
 
 #include "parcel.h"
+#include "arena.h"
 
 #define PAD_SIZE(s) (((s)+3)&~3)
 
 typedef uint16_t char16_t;
 
-void parcel_init(struct parcel *p)
+/* Enough for the int and short string arguments of most requests */
+#define PARCEL_DEFAULT_CAPACITY 64
+
+void parcel_init_sized(struct parcel *p, size_t size)
 {
-	p->data = g_malloc0(sizeof(int32_t));
+	/* Writers need one byte more than they write, see parcel_reserve */
+	p->capacity = MAX(size + 1, sizeof(int32_t));
+	p->data = g_malloc0(p->capacity);
 	p->size = 0;
-	p->capacity = sizeof(int32_t);
 	p->offset = 0;
 	p->malformed = 0;
 }
 
+void parcel_init(struct parcel *p)
+{
+	parcel_init_sized(p, PARCEL_DEFAULT_CAPACITY);
+}
+
+/* Grows geometrically, so writing n fields costs O(log n) reallocs */
 void parcel_grow(struct parcel *p, size_t size)
 {
-	char *new = g_realloc(p->data, p->capacity + size);
-	p->data = new;
-	p->capacity += size;
+	size_t capacity = MAX(p->capacity * 2, p->capacity + size);
+
+	p->data = g_realloc(p->data, capacity);
+	p->capacity = capacity;
+}
+
+void parcel_reserve(struct parcel *p, size_t size)
+{
+	if (p->offset + size < p->capacity)
+		return;
+
+	parcel_grow(p, p->offset + size + 1 - p->capacity);
+}
+
+size_t parcel_string_size(const char *str)
+{
+	if (str == NULL)
+		return sizeof(int32_t);
+
+	/* UTF-16 never needs more code units than UTF-8 needs bytes */
+	return sizeof(int32_t) + PAD_SIZE((strlen(str) + 1) * sizeof(char16_t));
 }
 
 void parcel_free(struct parcel *p)
@@ -91,105 +120,201 @@ int32_t parcel_r_int32(struct parcel *p)
 
 int parcel_w_int32(struct parcel *p, int32_t val)
 {
-	for (;;) {
+	parcel_reserve(p, sizeof(int32_t));
 
-		if (p->offset + sizeof(int32_t) < p->capacity) {
-			/* There's enough space */
-			*((int32_t *) (void *) (p->data + p->offset)) = val;
-			p->offset += sizeof(int32_t);
-			p->size += sizeof(int32_t);
+	*((int32_t *) (void *) (p->data + p->offset)) = val;
+	p->offset += sizeof(int32_t);
+	p->size += sizeof(int32_t);
+
+	return 0;
+}
+
+/*
+ * Returns the number of UTF-16 code units needed for a UTF-8 string,
+ * or -1 if it is not valid UTF-8.  Strings sent to rild are nearly
+ * always ASCII, which is checked for first.
+ */
+static long utf8_utf16_len(const char *str, gboolean *ascii)
+{
+	const char *c;
+	long len = 0;
+
+	for (c = str; *c != '\0'; c++)
+		if ((unsigned char) *c & 0x80)
 			break;
+
+	*ascii = *c == '\0';
+	if (*ascii)
+		return c - str;
+
+	if (!g_utf8_validate(str, -1, NULL))
+		return -1;
+
+	for (c = str; *c != '\0'; c = g_utf8_next_char(c))
+		len += g_utf8_get_char(c) > 0xFFFF ? 2 : 1;
+
+	return len;
+}
+
+static void utf8_to_utf16(const char *str, gboolean ascii, char16_t *out)
+{
+	const char *c;
+
+	if (ascii) {
+		for (c = str; *c != '\0'; c++)
+			*out++ = (unsigned char) *c;
+
+		return;
+	}
+
+	for (c = str; *c != '\0'; c = g_utf8_next_char(c)) {
+		gunichar wc = g_utf8_get_char(c);
+
+		if (wc > 0xFFFF) {
+			wc -= 0x10000;
+			*out++ = 0xD800 + (wc >> 10);
+			*out++ = 0xDC00 + (wc & 0x3FF);
 		} else {
-			/* Grow data and retry */
-			parcel_grow(p, sizeof(int32_t));
+			*out++ = wc;
 		}
 	}
-	return 0;
 }
 
 int parcel_w_string(struct parcel *p, const char *str)
 {
-	gunichar2 *gs16;
-	glong gs16_len;
+	gboolean ascii;
+	long len16;
 	size_t len;
-	size_t gs16_size;
+	size_t padded;
 
 	if (str == NULL) {
 		parcel_w_int32(p, -1);
 		return 0;
 	}
 
-	gs16 = g_utf8_to_utf16(str, -1, NULL, &gs16_len, NULL);
-
-	if (parcel_w_int32(p, gs16_len) == -1)
+	len16 = utf8_utf16_len(str, &ascii);
+	if (len16 < 0) {
+		ofono_error("%s: wrong UTF8 coding", __func__);
+		parcel_w_int32(p, -1);
 		return -1;
+	}
 
-	gs16_size = gs16_len * sizeof(char16_t);
-	len = gs16_size + sizeof(char16_t);
-	for (;;) {
-		size_t padded = PAD_SIZE(len);
+	len = (len16 + 1) * sizeof(char16_t);
+	padded = PAD_SIZE(len);
 
-		if (p->offset + len < p->capacity) {
-			/* There's enough space */
-			memcpy(p->data + p->offset, gs16, gs16_size);
-			*((char16_t *) (void *)
-				(p->data + p->offset + gs16_size)) = 0;
-			p->offset += padded;
-			p->size += padded;
-			if (padded != len) {
-
-#if BYTE_ORDER == BIG_ENDIAN
-				static const uint32_t mask[4] = {
-					0x00000000, 0xffffff00,
-					0xffff0000, 0xff000000
-				};
-#endif
-#if BYTE_ORDER == LITTLE_ENDIAN
-				static const uint32_t mask[4] = {
-					0x00000000, 0x00ffffff,
-					0x0000ffff, 0x000000ff
-				};
-#endif
+	/* Transcode straight into the parcel */
+	parcel_reserve(p, sizeof(int32_t) + padded);
+	parcel_w_int32(p, len16);
+
+	utf8_to_utf16(str, ascii, (char16_t *) (void *) (p->data + p->offset));
+	memset(p->data + p->offset + len16 * sizeof(char16_t), 0,
+		padded - len16 * sizeof(char16_t));
 
-				*((uint32_t *) (void *)
-					(p->data + p->offset - 4)) &=
-							mask[padded - len];
-			}
+	p->offset += padded;
+	p->size += padded;
+
+	return 0;
+}
+
+/*
+ * Returns the length in bytes of the UTF-8 encoding of a UTF-16
+ * string, or -1 if it has unpaired surrogates.
+ */
+static long utf16_utf8_len(const char16_t *s, int len16, gboolean *ascii)
+{
+	long len = 0;
+	int i;
+
+	for (i = 0; i < len16; i++)
+		if (s[i] >= 0x80)
 			break;
 
-		} else {
-			/* Grow data and retry */
-			parcel_grow(p, padded);
-		}
+	*ascii = i == len16;
+	if (*ascii)
+		return len16;
+
+	for (i = 0; i < len16; i++) {
+		if (s[i] < 0x80)
+			len += 1;
+		else if (s[i] < 0x800)
+			len += 2;
+		else if (s[i] < 0xD800 || s[i] > 0xDFFF)
+			len += 3;
+		else if (s[i] < 0xDC00 && i + 1 < len16 &&
+				s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF) {
+			len += 4;
+			i++;
+		} else
+			return -1;
 	}
 
-	g_free(gs16);
-	return 0;
+	return len;
 }
 
-char *parcel_r_string(struct parcel *p)
+/*
+ * Writes at most size - 1 bytes of UTF-8, never splitting a character,
+ * and a terminating NUL.  Returns the number of bytes written.
+ */
+static size_t utf16_to_utf8(const char16_t *s, int len16, gboolean ascii,
+				char *out, size_t size)
 {
-	char *ret;
-	int len16 = parcel_r_int32(p);
+	size_t n = 0;
+	int i;
+
+	if (ascii) {
+		for (i = 0; i < len16 && n + 1 < size; i++)
+			out[n++] = s[i];
+
+		out[n] = '\0';
+		return n;
+	}
+
+	for (i = 0; i < len16; i++) {
+		gunichar wc = s[i];
+
+		if (wc >= 0xD800 && wc < 0xDC00)
+			wc = 0x10000 + ((wc - 0xD800) << 10) + (s[++i] - 0xDC00);
+
+		if (n + g_unichar_to_utf8(wc, NULL) >= size)
+			break;
+
+		n += g_unichar_to_utf8(wc, out + n);
+	}
+
+	out[n] = '\0';
+	return n;
+}
+
+/*
+ * Checks the string at the current offset, on success leaves the
+ * offset past the string length and returns the string data.
+ */
+static const char16_t *parcel_r_utf16(struct parcel *p, int *len16,
+					long *len8, gboolean *ascii)
+{
+	const char16_t *s;
 	int strbytes;
 
+	*len16 = parcel_r_int32(p);
+
 	if (p->malformed)
 		return NULL;
 
 	/* This is how a null string is sent */
-	if (len16 < 0)
+	if (*len16 < 0)
 		return NULL;
 
-	strbytes = PAD_SIZE((len16 + 1) * sizeof(char16_t));
+	strbytes = PAD_SIZE((*len16 + 1) * sizeof(char16_t));
 	if (p->offset + strbytes > p->size) {
 		ofono_error("%s: parcel is too small", __func__);
 		p->malformed = 1;
 		return NULL;
 	}
 
-	ret = g_utf16_to_utf8((gunichar2 *) (void *) (p->data + p->offset),
-				len16, NULL, NULL, NULL);
-	if (ret == NULL) {
+	s = (const char16_t *) (void *) (p->data + p->offset);
+
+	*len8 = utf16_utf8_len(s, *len16, ascii);
+	if (*len8 < 0) {
 		ofono_error("%s: wrong UTF16 coding", __func__);
 		p->malformed = 1;
 		return NULL;
@@ -197,9 +322,67 @@ char *parcel_r_string(struct parcel *p)
 
 	p->offset += strbytes;
 
+	return s;
+}
+
+char *parcel_r_string(struct parcel *p)
+{
+	const char16_t *s;
+	gboolean ascii;
+	int len16;
+	long len8;
+	char *ret;
+
+	s = parcel_r_utf16(p, &len16, &len8, &ascii);
+	if (s == NULL)
+		return NULL;
+
+	ret = g_malloc(len8 + 1);
+	utf16_to_utf8(s, len16, ascii, ret, len8 + 1);
+
+	return ret;
+}
+
+char *parcel_r_string_arena(struct parcel *p, struct arena *arena)
+{
+	const char16_t *s;
+	gboolean ascii;
+	int len16;
+	long len8;
+	char *ret;
+
+	s = parcel_r_utf16(p, &len16, &len8, &ascii);
+	if (s == NULL)
+		return NULL;
+
+	ret = arena_alloc0(arena, len8 + 1);
+	utf16_to_utf8(s, len16, ascii, ret, len8 + 1);
+
 	return ret;
 }
 
+/*
+ * Like parcel_r_string(), but borrows the caller's buffer.  Strings
+ * that do not fit are truncated.  Returns the length written, or -1
+ * for a NULL string or a malformed parcel, in which case buf is empty.
+ */
+int parcel_r_string_buf(struct parcel *p, char *buf, size_t size)
+{
+	const char16_t *s;
+	gboolean ascii;
+	int len16;
+	long len8;
+
+	if (size > 0)
+		buf[0] = '\0';
+
+	s = parcel_r_utf16(p, &len16, &len8, &ascii);
+	if (s == NULL || size == 0)
+		return -1;
+
+	return utf16_to_utf8(s, len16, ascii, buf, size);
+}
+
 int parcel_w_raw(struct parcel *p, const void *data, size_t len)
 {
 	if (data == NULL) {
@@ -219,7 +402,7 @@ int parcel_w_raw(struct parcel *p, const void *data, size_t len)
 			break;
 		} else {
 			/* Grow data and retry */
-			parcel_grow(p, len);
+			parcel_reserve(p, len);
 		}
 	}
 	return 0;
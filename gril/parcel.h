@@ -32,18 +32,25 @@ struct parcel {
 	int malformed;
 };
 
+struct arena;
+
 struct parcel_str_array {
 	int num_str;
 	char *str[];
 };
 
 void parcel_init(struct parcel *p);
+void parcel_init_sized(struct parcel *p, size_t size);
 void parcel_grow(struct parcel *p, size_t size);
+void parcel_reserve(struct parcel *p, size_t size);
+size_t parcel_string_size(const char *str);
 void parcel_free(struct parcel *p);
 int32_t parcel_r_int32(struct parcel *p);
 int parcel_w_int32(struct parcel *p, int32_t val);
 int parcel_w_string(struct parcel *p, const char *str);
 char *parcel_r_string(struct parcel *p);
+int parcel_r_string_buf(struct parcel *p, char *buf, size_t size);
+char *parcel_r_string_arena(struct parcel *p, struct arena *arena);
 int parcel_w_raw(struct parcel *p, const void *data, size_t len);
 void *parcel_r_raw(struct parcel *p,  int *len);
 size_t parcel_data_avail(struct parcel *p);
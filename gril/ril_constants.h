@@ -61,6 +61,8 @@
 #define RIL_E_SS_MODIFIED_TO_USSD 24
 #define RIL_E_SS_MODIFIED_TO_SS 25
 #define RIL_E_SUBSCRIPTION_NOT_SUPPORTED 26
+/* Not sent by rild, reported by GRil when a request gets no reply */
+#define RIL_E_TIMEOUT -1
 
 /* Preferred network types */
 #define PREF_NET_TYPE_GSM_WCDMA 0
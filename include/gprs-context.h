@@ -85,6 +85,13 @@ struct ofono_gprs_context_driver {
 void ofono_gprs_context_deactivated(struct ofono_gprs_context *gc,
 					unsigned int id);
 
+/*
+ * Signals the settings of an active context again, for drivers that learn
+ * about address or DNS changes after activation.
+ */
+void ofono_gprs_context_settings_changed(struct ofono_gprs_context *gc,
+						unsigned int id);
+
 int ofono_gprs_context_driver_register(
 				const struct ofono_gprs_context_driver *d);
 void ofono_gprs_context_driver_unregister(
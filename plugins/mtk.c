@@ -65,6 +65,7 @@
 #include "drivers/rilmodem/rilutil.h"
 #include "drivers/rilmodem/rilmodem.h"
 #include "drivers/rilmodem/vendor.h"
+#include "drivers/rilmodem/rildebug.h"
 
 #include "drivers/mtkmodem/mtkmodem.h"
 #include "drivers/mtkmodem/mtk_constants.h"
@@ -83,15 +84,14 @@
 #define SIM_2_ACTIVE 2
 #define NO_SIM_ACTIVE 0
 
-#define SOCKET_NUM_FOR_DBG_0 -1
-#define SOCKET_NUM_FOR_DBG_1 -2
-
 /* this gives 30s for rild to initialize */
 #define RILD_MAX_CONNECT_RETRIES 5
 #define RILD_CONNECT_RETRY_TIME_S 5
 
 #define T_WAIT_DISCONN_MS 1000
 #define T_SIM_SWITCH_FAILSAFE_MS 1000
+#define T_3G_CAPS_RETRY_MS 500
+#define T_DATA_SWITCH_FAILSAFE_MS 5000
 
 #define INVALID_SUSPEND_ID -1
 #define T_FW_SWITCH_S 60
@@ -106,6 +106,9 @@ enum mtk_plmn_type {
 static const char hex_slot_0[] = "Slot 0: ";
 static const char hex_slot_1[] = "Slot 1: ";
 
+static const char sock_slot_0[] = "/dev/socket/rild";
+static const char sock_slot_1[] = "/dev/socket/rild2";
+
 typedef void (*pending_cb_t)(struct cb_data *cbd);
 
 struct mtk_data {
@@ -150,6 +153,7 @@ struct mtk_data {
 	unsigned status_watch;
 	int netreg_status;
 	guint switch_fw_id;
+	struct ril_debug_data *debug;
 };
 
 /*
@@ -165,23 +169,44 @@ static struct mtk_data *mtk_data_1;
 static gboolean disconnect_expected;
 static guint not_disconn_cb_id;
 
-struct socket_data {
-	GRil *ril;
-	const char *path;
-	int radio_state;
-	guint radio_state_ev_id;
+/*
+ * Both slots share a RIL session. rild restarts whenever the radio is
+ * powered on again or the 3G slot changes, and the socket at
+ * sock_slot_0 always serves the slot with 3G capabilities. The session
+ * keeps the GRil of each slot, and the atoms using it, across the
+ * restart, and holds the slots until we know which socket belongs to
+ * which physical slot.
+ */
+static GRilSession *session;
+static gboolean sockets_swapped;
+static gboolean caps_query_pending;
+static guint caps_retry_id;
+
+/*
+ * Moving data from one slot to the other. The target slot attach is accepted
+ * while the source is still attached, but it is not effective until the
+ * source has detached, see mtk_set_attach_state().
+ */
+enum data_switch_state {
+	DATA_SWITCH_IDLE = 0,
+	DATA_SWITCH_STAGED,	/* Target attach accepted, source attached */
+	DATA_SWITCH_DRAINING,	/* Source detach accepted, target re-sent */
+	DATA_SWITCH_ATTACHING,	/* Source detached, target re-sent again */
 };
 
-static struct socket_data *sock_0, *sock_1;
+struct data_switch {
+	enum data_switch_state state;
+	struct mtk_data *target;
+	gint64 start;
+	guint failsafe_id;
+};
+
+static struct data_switch data_switch;
 
-static int create_gril(struct ofono_modem *modem);
 static gboolean mtk_connected(gpointer user_data);
 static void mtk_set_online(struct ofono_modem *modem, ofono_bool_t online,
 				ofono_modem_online_cb_t callback, void *data);
-static void query_3g_caps(struct socket_data *sock);
-static void socket_disconnected(gpointer user_data);
-static void start_slot(struct mtk_data *md, struct socket_data *sock,
-			const char *hex_prefix);
+static void query_3g_caps(void);
 static void exec_pending_online(struct mtk_data *md);
 
 static void mtk_debug(const char *str, void *user_data)
@@ -199,14 +224,6 @@ static struct mtk_data *mtk_data_complement(struct mtk_data *md)
 		return mtk_data_0;
 }
 
-static struct socket_data *socket_complement(struct socket_data *sock)
-{
-	if (sock == sock_0)
-		return sock_1;
-	else
-		return sock_0;
-}
-
 /*
  * mtk_set_attach_state and mtk_detach_received are called by mtkmodem's gprs
  * driver. They are needed to solve an issue with data attachment: in case
@@ -220,16 +237,13 @@ static struct socket_data *socket_complement(struct socket_data *sock)
  * in the modem that does not need to know about them, so we have to pass them
  * to the mtk plugin (which has knowledge of both modems) that will take proper
  * action in the other modem.
+ *
+ * To shorten the switch, the attach is also re-sent as soon as rild accepts
+ * the detach of slot 0, so it is queued in the modem while slot 0 drains. The
+ * steps are timed and can be read with RilDebug.GetDataSwitchTimes.
  */
 
-void mtk_set_attach_state(struct ofono_modem *modem, ofono_bool_t attached)
-{
-	struct mtk_data *md = ofono_modem_get_data(modem);
-
-	md->gprs_attach = attached;
-}
-
-static void detach_received_cb(struct ril_msg *message, gpointer user_data)
+static void reattach_cb(struct ril_msg *message, gpointer user_data)
 {
 	struct mtk_data *md = user_data;
 
@@ -240,54 +254,149 @@ static void detach_received_cb(struct ril_msg *message, gpointer user_data)
 				ril_error_to_string(message->error));
 }
 
-void mtk_detach_received(struct ofono_modem *modem)
+static void reattach(struct mtk_data *md)
 {
-	struct mtk_data *md = ofono_modem_get_data(modem);
-	struct mtk_data *md_c = mtk_data_complement(md);
+	struct parcel rilp;
 
-	if (md_c != NULL && md_c->gprs_attach) {
-		struct parcel rilp;
+	g_mtk_request_set_gprs_connect_type(md->ril, md->gprs_attach, &rilp);
+
+	if (g_ril_send(md->ril, MTK_RIL_REQUEST_SET_GPRS_CONNECT_TYPE,
+			&rilp, reattach_cb, md, NULL) == 0)
+		ofono_error("%s: send failed", __func__);
+}
+
+static void data_switch_step(const char *step)
+{
+	gint64 elapsed = g_get_monotonic_time() - data_switch.start;
+
+	DBG("slot %d: %s after %" G_GINT64_FORMAT " us",
+		data_switch.target->slot, step, elapsed);
 
-		g_mtk_request_set_gprs_connect_type(md_c->ril,
-						md_c->gprs_attach, &rilp);
+	ril_debug_data_switch_step(data_switch.target->debug, step, elapsed);
+}
+
+static void data_switch_finish(const char *step)
+{
+	data_switch_step(step);
 
-		if (g_ril_send(md_c->ril,
-				MTK_RIL_REQUEST_SET_GPRS_CONNECT_TYPE,
-				&rilp, detach_received_cb, md_c, NULL) == 0)
-			ofono_error("%s: send failed", __func__);
+	ofono_info("Data switch to slot %d: %s after %" G_GINT64_FORMAT " ms",
+			data_switch.target->slot, step,
+			(g_get_monotonic_time() - data_switch.start) / 1000);
+
+	if (data_switch.failsafe_id != 0) {
+		g_source_remove(data_switch.failsafe_id);
+		data_switch.failsafe_id = 0;
 	}
+
+	data_switch.state = DATA_SWITCH_IDLE;
+	data_switch.target = NULL;
 }
 
-static void radio_state_changed(struct ril_msg *message, gpointer user_data)
+static gboolean data_switch_failsafe(gpointer user_data)
 {
-	struct socket_data *sock = user_data;
-	int radio_state = g_ril_unsol_parse_radio_state_changed(sock->ril,
-								message);
+	struct mtk_data *md = data_switch.target;
 
-	if (radio_state != sock->radio_state) {
-		struct socket_data *sock_c = socket_complement(sock);
+	data_switch.failsafe_id = 0;
 
-		ofono_info("%s, %s, state: %s", __func__, sock->path,
-				ril_radio_state_to_string(radio_state));
+	if (md->gprs_attach)
+		reattach(md);
 
-		/*
-		 * If there is just one slot, just start it. Otherwise, we ask
-		 * who owns the 3G capabilities in case both slots have already
-		 * radio state different from UNAVAILABLE.
-		 */
-		if (mtk_data_1 == NULL) {
-			mtk_data_0->has_3g = TRUE;
-			start_slot(mtk_data_0, sock, hex_slot_0);
-		} else if (sock->radio_state == RADIO_STATE_UNAVAILABLE &&
-				sock_c != NULL && sock_c->radio_state !=
-						RADIO_STATE_UNAVAILABLE) {
-			query_3g_caps(sock);
+	data_switch_finish("Failsafe");
+
+	return FALSE;
+}
+
+static void data_switch_start(struct mtk_data *target,
+				enum data_switch_state state)
+{
+	if (data_switch.failsafe_id != 0)
+		g_source_remove(data_switch.failsafe_id);
+
+	data_switch.state = state;
+	data_switch.target = target;
+	data_switch.start = g_get_monotonic_time();
+	data_switch.failsafe_id = g_timeout_add(T_DATA_SWITCH_FAILSAFE_MS,
+						data_switch_failsafe, NULL);
+
+	ril_debug_data_switch_reset(target->debug);
+}
+
+static void data_switch_cancel(void)
+{
+	if (data_switch.failsafe_id != 0) {
+		g_source_remove(data_switch.failsafe_id);
+		data_switch.failsafe_id = 0;
+	}
+
+	data_switch.state = DATA_SWITCH_IDLE;
+	data_switch.target = NULL;
+}
+
+void mtk_set_attach_state(struct ofono_modem *modem, ofono_bool_t attached)
+{
+	struct mtk_data *md = ofono_modem_get_data(modem);
+	struct mtk_data *md_c = mtk_data_complement(md);
+	ofono_bool_t was_attached = md->gprs_attach;
+
+	md->gprs_attach = attached;
+
+	if (md_c == NULL || was_attached == attached)
+		return;
+
+	if (attached) {
+		/* Stage the target while the other slot holds data */
+		if (md_c->gprs_attach) {
+			data_switch_start(md, DATA_SWITCH_STAGED);
+			data_switch_step("TargetStaged");
+		}
+
+		return;
+	}
+
+	if (data_switch.target == md) {
+		data_switch_finish("Cancelled");
+		return;
+	}
+
+	if (data_switch.target != md_c || !md_c->gprs_attach)
+		return;
+
+	/* Do not wait for GPRS_DETACH to retry the target attach */
+	data_switch.state = DATA_SWITCH_DRAINING;
+	data_switch_step("SourceDetachRequested");
+
+	reattach(md_c);
+}
+
+void mtk_detach_received(struct ofono_modem *modem)
+{
+	struct mtk_data *md = ofono_modem_get_data(modem);
+	struct mtk_data *md_c = mtk_data_complement(md);
+
+	if (md_c != NULL && md_c->gprs_attach) {
+		if (data_switch.target == md_c) {
+			data_switch.state = DATA_SWITCH_ATTACHING;
+			data_switch_step("SourceDetached");
 		}
 
-		sock->radio_state = radio_state;
+		reattach(md_c);
 	}
 }
 
+static void ps_state_changed(struct ril_msg *message, gpointer user_data)
+{
+	struct ofono_modem *modem = user_data;
+	struct mtk_data *md = ofono_modem_get_data(modem);
+
+	if (data_switch.target != md)
+		return;
+
+	/* Before the source drains this is not the switch taking effect */
+	if (data_switch.state == DATA_SWITCH_DRAINING ||
+			data_switch.state == DATA_SWITCH_ATTACHING)
+		data_switch_finish("TargetStateChanged");
+}
+
 static void exec_online_callback(struct mtk_data *md)
 {
 	if (md->online_cb != NULL) {
@@ -795,8 +904,27 @@ static void mtk_remove(struct ofono_modem *modem)
 	if (!md)
 		return;
 
+	if (md == mtk_data_0)
+		mtk_data_0 = NULL;
+	else if (md == mtk_data_1)
+		mtk_data_1 = NULL;
+
+	if (data_switch.target == md)
+		data_switch_cancel();
+
+	ril_debug_remove(md->debug);
 	g_ril_unref(md->ril);
 
+	if (mtk_data_0 == NULL && mtk_data_1 == NULL) {
+		if (caps_retry_id != 0) {
+			g_source_remove(caps_retry_id);
+			caps_retry_id = 0;
+		}
+
+		g_ril_session_unref(session);
+		session = NULL;
+	}
+
 	g_free(md);
 }
 
@@ -834,6 +962,9 @@ static void sim_state_watch(enum ofono_sim_state new_state, void *data)
 			{ md->ril, modem, OFONO_GPRS_CONTEXT_TYPE_INTERNET };
 		struct ril_gprs_context_data mms_ctx =
 			{ md->ril, modem, OFONO_GPRS_CONTEXT_TYPE_MMS };
+		struct ril_gprs_context_data any_ctx =
+			{ md->ril, modem, OFONO_GPRS_CONTEXT_TYPE_ANY };
+		unsigned int i;
 
 		DBG("SIM ready, creating more atoms");
 
@@ -881,6 +1012,14 @@ static void sim_state_watch(enum ofono_sim_state new_state, void *data)
 			ofono_gprs_add_context(md->gprs, gc);
 		}
 
+		for (i = 2; i < g_ril_get_max_data_calls(md->ril); i++) {
+			gc = ofono_gprs_context_create(modem,
+						OFONO_RIL_VENDOR_MTK,
+						RILMODEM, &any_ctx);
+			if (gc)
+				ofono_gprs_add_context(md->gprs, gc);
+		}
+
 		md->message_waiting = ofono_message_waiting_create(modem);
 		if (md->message_waiting)
 			ofono_message_waiting_register(md->message_waiting);
@@ -1127,6 +1266,8 @@ static gboolean no_disconnect_case(gpointer user_data)
 	return FALSE;
 }
 
+static void poweron_disconnect(struct cb_data *cbd);
+
 static void poweron_cb(struct ril_msg *message, gpointer user_data)
 {
 	struct cb_data *cbd = user_data;
@@ -1175,6 +1316,10 @@ static void poweron_cb(struct ril_msg *message, gpointer user_data)
 		} else {
 			mtk_send_sim_mode(mtk_sim_mode_cb, cbd);
 		}
+	} else if (message->error == RIL_E_RADIO_NOT_AVAILABLE &&
+			mtk_data_0->pending_cb == poweron_disconnect) {
+		/* rild restarted under us, carry on once reconnected */
+		DBG("socket dropped before RADIO_POWERON reply");
 	} else {
 		ofono_error("%s RADIO_POWERON error %s", __func__,
 				ril_error_to_string(message->error));
@@ -1363,6 +1508,10 @@ static void create_atoms_on_connection(struct ofono_modem *modem)
 	struct mtk_data *md = ofono_modem_get_data(modem);
 	struct ril_voicecall_driver_data vc_data = { md->ril, modem };
 
+	/* Atoms survive rild restarts, they use the session's GRil */
+	if (__ofono_modem_find_atom(modem, OFONO_ATOM_TYPE_DEVINFO))
+		return;
+
 	md->devinfo = ofono_devinfo_create(modem, OFONO_RIL_VENDOR_MTK,
 						RILMODEM, md->ril);
 
@@ -1373,61 +1522,47 @@ static void create_atoms_on_connection(struct ofono_modem *modem)
 							RILMODEM, md->ril);
 }
 
-static void remove_atoms_on_disconnection(struct ofono_modem *modem)
+static void start_slot(struct mtk_data *md)
 {
-	struct mtk_data *md = ofono_modem_get_data(modem);
+	ofono_info("Physical slot %d in socket %s", md->slot,
+			md->has_3g ? sock_slot_0 : sock_slot_1);
 
-	if (__ofono_modem_find_atom(modem, OFONO_ATOM_TYPES_CALL_VOLUME))
-		ofono_call_volume_remove(md->callvolume);
-	md->callvolume = NULL;
-	if (__ofono_modem_find_atom(modem, OFONO_ATOM_TYPE_VOICECALL))
-		ofono_voicecall_remove(md->voicecall);
-	md->voicecall = NULL;
-	if (__ofono_modem_find_atom(modem, OFONO_ATOM_TYPE_DEVINFO))
-		ofono_devinfo_remove(md->devinfo);
-	md->devinfo = NULL;
+	g_ril_session_release(session, md->slot);
+
+	/* Requests sent from here on wait for the release */
+	mtk_connected(md->modem);
 }
 
-static void start_slot(struct mtk_data *md, struct socket_data *sock,
-			const char *hex_prefix)
+static gboolean query_3g_caps_retry(gpointer user_data)
 {
-	ofono_info("Physical slot %d in socket %s", md->slot, sock->path);
-
-	md->ril = sock->ril;
-	md->radio_state = sock->radio_state;
-
-	g_ril_set_slot(md->ril, md->slot);
-
-	if (getenv("OFONO_RIL_TRACE"))
-		g_ril_set_trace(md->ril, TRUE);
-
-	if (getenv("OFONO_RIL_HEX_TRACE"))
-		g_ril_set_debugf(md->ril, mtk_debug, (char *) hex_prefix);
+	caps_retry_id = 0;
 
-	g_ril_set_disconnect_function(md->ril, socket_disconnected,
-					md->modem);
-
-	g_ril_unregister(sock->ril, sock->radio_state_ev_id);
-
-	g_ril_register(md->ril, RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
-			mtk_radio_state_changed, md->modem);
+	query_3g_caps();
 
-	mtk_connected(md->modem);
+	return FALSE;
 }
 
 static void query_3g_caps_cb(struct ril_msg *message, gpointer user_data)
 {
-	struct socket_data *sock = user_data;
-	struct socket_data *sock_for_md_0, *sock_for_md_1;
+	gboolean swapped;
 	int slot_3g;
 
+	caps_query_pending = FALSE;
+
 	if (message->error != RIL_E_SUCCESS) {
 		ofono_error("%s: error %s", __func__,
 				ril_error_to_string(message->error));
+
+		/* Probably rild is still starting, or went away again */
+		if (caps_retry_id == 0)
+			caps_retry_id = g_timeout_add(T_3G_CAPS_RETRY_MS,
+							query_3g_caps_retry,
+							NULL);
 		return;
 	}
 
-	slot_3g = g_mtk_reply_parse_get_3g_capability(sock->ril, message);
+	slot_3g = g_mtk_reply_parse_get_3g_capability(mtk_data_0->ril,
+							message);
 
 	/*
 	 * The socket at sock_slot_0 always connects to the slot with 3G
@@ -1437,35 +1572,70 @@ static void query_3g_caps_cb(struct ril_msg *message, gpointer user_data)
 	 * to different physical slots depending on the current configuration.
 	 * We want to keep the relationship between the physical slots and
 	 * the modem names in DBus (so /ril_0 and /ril_1 always refer to the
-	 * same physical slots), so here we assign the sockets needed by
-	 * mtk_data_0 and mtk_data_1 structures to make sure that happens.
+	 * same physical slots), so here we swap the sockets of the session
+	 * slots when they are not connected the way the 3G slot requires.
 	 */
-	if (slot_3g == MULTISIM_SLOT_0) {
-		sock_for_md_0 = sock_0;
-		sock_for_md_1 = sock_1;
-		mtk_data_0->has_3g = TRUE;
-		mtk_data_1->has_3g = FALSE;
-	} else {
-		sock_for_md_0 = sock_1;
-		sock_for_md_1 = sock_0;
-		mtk_data_0->has_3g = FALSE;
-		mtk_data_1->has_3g = TRUE;
+	swapped = slot_3g != MULTISIM_SLOT_0;
+
+	if (swapped != sockets_swapped) {
+		if (!g_ril_session_swap_slots(session, MULTISIM_SLOT_0,
+							MULTISIM_SLOT_1)) {
+			ofono_error("%s: cannot swap sockets", __func__);
+			return;
+		}
+
+		sockets_swapped = swapped;
 	}
 
-	start_slot(mtk_data_0, sock_for_md_0, hex_slot_0);
-	start_slot(mtk_data_1, sock_for_md_1, hex_slot_1);
+	mtk_data_0->has_3g = !swapped;
+	mtk_data_1->has_3g = swapped;
 
-	g_free(sock_0);
-	sock_0 = NULL;
-	g_free(sock_1);
-	sock_1 = NULL;
+	start_slot(mtk_data_0);
+	start_slot(mtk_data_1);
 }
 
-static void query_3g_caps(struct socket_data *sock)
+static void query_3g_caps(void)
 {
-	if (g_ril_send(sock->ril, MTK_RIL_REQUEST_GET_3G_CAPABILITY, NULL,
-			query_3g_caps_cb, sock, NULL) <= 0)
+	if (caps_query_pending)
+		return;
+
+	/* Held slots only write session requests */
+	if (g_ril_send_with_priority(mtk_data_0->ril,
+					MTK_RIL_REQUEST_GET_3G_CAPABILITY, NULL,
+					query_3g_caps_cb, NULL, NULL,
+					G_RIL_PRIORITY_SESSION) <= 0) {
 		ofono_error("%s Error querying 3G capabilities", __func__);
+		return;
+	}
+
+	caps_query_pending = TRUE;
+}
+
+/* Called on the first connection of a slot, and after rild restarts */
+static void slot_connected(int slot, gpointer user_data)
+{
+	DBG("slot %d", slot);
+
+	if (mtk_data_0 == NULL || !g_ril_is_connected(mtk_data_0->ril))
+		return;
+
+	/* Case of modems with just one slot */
+	if (mtk_data_1 == NULL) {
+		mtk_data_0->has_3g = TRUE;
+		start_slot(mtk_data_0);
+		return;
+	}
+
+	/* We ask who owns the 3G capabilities once both sockets are up */
+	if (!g_ril_is_connected(mtk_data_1->ril))
+		return;
+
+	if (caps_retry_id != 0) {
+		g_source_remove(caps_retry_id);
+		caps_retry_id = 0;
+	}
+
+	query_3g_caps();
 }
 
 static gboolean mtk_connected(gpointer user_data)
@@ -1489,22 +1659,6 @@ static gboolean mtk_connected(gpointer user_data)
 	return FALSE;
 }
 
-static gboolean reconnect_rild(gpointer user_data)
-{
-	struct ofono_modem *modem = (struct ofono_modem *) user_data;
-	struct mtk_data *md = ofono_modem_get_data(modem);
-
-	ofono_info("[slot %d] trying to reconnect", md->slot);
-
-	if (create_gril(modem) < 0)
-		return TRUE;
-
-	/* Reconnected: do not call this again */
-	return FALSE;
-}
-
-#define WAIT_FOR_RILD_TO_RESTART_MS 8000	/* Milliseconds */
-
 static void socket_disconnected(gpointer user_data)
 {
 	struct ofono_modem *modem = user_data;
@@ -1512,12 +1666,6 @@ static void socket_disconnected(gpointer user_data)
 
 	DBG("slot %d", md->slot);
 
-	/* Atoms use old gril object, remove and recreate later */
-	remove_atoms_on_disconnection(modem);
-
-	g_ril_unref(md->ril);
-	md->ril = NULL;
-
 	md->sensed_plmn_type = MTK_PLMN_TYPE_UNKNOWN;
 	md->suspend_id = INVALID_SUSPEND_ID;
 	if (md->trm_pending) {
@@ -1532,40 +1680,45 @@ static void socket_disconnected(gpointer user_data)
 		not_disconn_cb_id = 0;
 	}
 
-	/* The disconnection happens because rild is re-starting, wait for it */
-	g_timeout_add(WAIT_FOR_RILD_TO_RESTART_MS, reconnect_rild, modem);
-}
+	if (caps_retry_id != 0) {
+		g_source_remove(caps_retry_id);
+		caps_retry_id = 0;
+	}
 
-static const char sock_slot_0[] = "/dev/socket/rild";
-static const char sock_slot_1[] = "/dev/socket/rild2";
+	/*
+	 * The disconnection happens because rild is re-starting. The session
+	 * reconnects as soon as it is back and calls slot_connected, the
+	 * atoms keep their GRil meanwhile.
+	 */
+}
 
 static int create_gril(struct ofono_modem *modem)
 {
 	struct mtk_data *md = ofono_modem_get_data(modem);
-	struct socket_data *sock;
-	int sock_num;
+	const char *path;
 
 	DBG("slot %d", md->slot);
 
 	if (md->ril != NULL)
 		return 0;
 
-	sock = g_try_malloc0(sizeof(*sock));
-	if (sock == NULL) {
-		ofono_error("%s: Cannot allocate socket_data", __func__);
-		return -ENOMEM;
-	}
+	if (session == NULL) {
+		session = g_ril_session_new(TRUE);
+		if (session == NULL)
+			return -ENOMEM;
 
-	if (md->slot == MULTISIM_SLOT_0) {
-		sock_num = SOCKET_NUM_FOR_DBG_0;
-		sock->path = sock_slot_0;
-	} else {
-		sock_num = SOCKET_NUM_FOR_DBG_1;
-		sock->path = sock_slot_1;
+		g_ril_session_set_connect_function(session, slot_connected,
+							NULL);
 	}
 
+	if (md->slot == MULTISIM_SLOT_0)
+		path = sockets_swapped ? sock_slot_1 : sock_slot_0;
+	else
+		path = sockets_swapped ? sock_slot_0 : sock_slot_1;
+
 	/* Opens the socket to RIL */
-	sock->ril = g_ril_new(sock->path, OFONO_RIL_VENDOR_MTK);
+	md->ril = g_ril_session_add_slot(session, md->slot, path,
+						OFONO_RIL_VENDOR_MTK);
 
 	/*
 	 * NOTE: Since AT modems open a tty, and then call
@@ -1576,39 +1729,48 @@ static int create_gril(struct ofono_modem *modem)
 	 * abstraction... ( probaby not a bad idea ).
 	 */
 
-	if (sock->ril == NULL) {
-		ofono_error("g_ril_new() failed to connect to %s!", sock->path);
-		g_free(sock);
+	if (md->ril == NULL) {
+		ofono_error("g_ril_new() failed to connect to %s!", path);
 		return -EIO;
-	} else if (md->slot == MULTISIM_SLOT_0) {
-		sock_0 = sock;
-	} else {
-		sock_1 = sock;
 	}
 
-	sock->radio_state = RADIO_STATE_UNAVAILABLE;
-	sock->radio_state_ev_id =
-		g_ril_register(sock->ril,
-				RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
-				radio_state_changed, sock);
-
-	g_ril_register(sock->ril, MTK_RIL_UNSOL_RESPONSE_PLMN_CHANGED,
-			plmn_changed, modem);
-	g_ril_register(sock->ril, MTK_RIL_UNSOL_RESPONSE_REGISTRATION_SUSPENDED,
-			reg_suspended, modem);
-
-	/* sock_num is negative to avoid confusion with physical slots */
-	g_ril_set_slot(sock->ril, sock_num);
-
-	g_ril_set_vendor_print_msg_id_funcs(sock->ril,
+	g_ril_set_vendor_print_msg_id_funcs(md->ril,
 						mtk_request_id_to_string,
 						mtk_unsol_request_to_string);
 
 	if (getenv("OFONO_RIL_TRACE"))
-		g_ril_set_trace(sock->ril, TRUE);
+		g_ril_set_trace(md->ril, TRUE);
+
+	/* The ring is shared by both slots */
+	if (getenv("OFONO_RIL_TRACE_RING"))
+		g_ril_set_trace_ring(md->ril,
+					atoi(getenv("OFONO_RIL_TRACE_RING")));
 
 	if (getenv("OFONO_RIL_HEX_TRACE"))
-		g_ril_set_debugf(sock->ril, mtk_debug, (char *) sock->path);
+		g_ril_set_debugf(md->ril, mtk_debug,
+					(char *) (md->slot == MULTISIM_SLOT_0 ?
+						hex_slot_0 : hex_slot_1));
+
+	if (ofono_modem_get_integer(modem, "MaxDataCalls") > 0)
+		g_ril_set_max_data_calls(md->ril,
+				ofono_modem_get_integer(modem, "MaxDataCalls"));
+
+	g_ril_set_disconnect_function(md->ril, socket_disconnected, modem);
+
+	if (getenv("OFONO_RIL_DEBUG_STATS"))
+		md->debug = ril_debug_create(modem, md->ril);
+
+	/* Events are held back until the slot is started */
+	g_ril_register(md->ril, RIL_UNSOL_RESPONSE_RADIO_STATE_CHANGED,
+			mtk_radio_state_changed, modem);
+	g_ril_register(md->ril, MTK_RIL_UNSOL_RESPONSE_PLMN_CHANGED,
+			plmn_changed, modem);
+	g_ril_register(md->ril, MTK_RIL_UNSOL_RESPONSE_REGISTRATION_SUSPENDED,
+			reg_suspended, modem);
+	g_ril_register(md->ril, MTK_RIL_UNSOL_RESPONSE_PS_NETWORK_STATE_CHANGED,
+			ps_state_changed, modem);
+
+	slot_connected(md->slot, NULL);
 
 	return 0;
 }
@@ -66,6 +66,7 @@
 #include "drivers/rilmodem/rilmodem.h"
 #include "drivers/rilmodem/rilutil.h"
 #include "drivers/rilmodem/vendor.h"
+#include "drivers/rilmodem/rildebug.h"
 #include "drivers/qcommsimmodem/qcom_msim_modem.h"
 
 #define MULTISIM_SLOT_0 0
@@ -73,6 +74,13 @@
 
 #define MAX_SIM_STATUS_RETRIES 15
 
+enum ril_startup_phase {
+	RIL_STARTUP_PRE_SIM,
+	RIL_STARTUP_POST_SIM,
+	RIL_STARTUP_POST_ONLINE,
+	RIL_STARTUP_PHASES
+};
+
 /* this gives 30s for rild to initialize */
 #define RILD_MAX_CONNECT_RETRIES 5
 #define RILD_CONNECT_RETRY_TIME_S 5
@@ -90,6 +98,35 @@ struct ril_data {
 	GRilMsgIdToStrFunc unsol_request_to_string;
 	ril_get_driver_type_func get_driver_type;
 	struct cb_data *set_online_cbd;
+	struct ril_debug_data *debug;
+	gint64 enabled_at;
+	gint64 phase_started[RIL_STARTUP_PHASES];
+	GSList *startup;	/* struct startup_atom */
+};
+
+/*
+ * Atoms are brought up from the tables below, one phase at a time.  The
+ * time from enabling the modem to the creation and to the registration of
+ * each atom is recorded, and exported through the RilDebug interface.
+ *
+ * The drivers register from an idle callback, as the core only binds the
+ * driver once probe returns.  All the atoms of a phase are created before
+ * that, so their registrations and initial queries already go out in the
+ * same main loop iteration.
+ */
+struct startup_step {
+	enum ofono_atom_type type;
+	const char *name;
+	void (*create)(struct ofono_modem *modem);
+};
+
+struct startup_atom {
+	struct ofono_modem *modem;
+	const struct startup_step *step;
+	int phase;
+	unsigned int watch;
+	gint64 created;
+	gint64 registered;	/* 0 until registered */
 };
 
 /*
@@ -99,6 +136,19 @@ struct ril_data {
 static struct ril_data *ril_data_0;
 static struct ril_data *ril_data_1;
 
+/*
+ * The slots of multi-SIM modems share a RIL session: one timeout wheel,
+ * one trace ring and a reconnection to the slot's socket when rild
+ * restarts, with the GRil, and the atoms using it, kept meanwhile.
+ */
+static GRilSession *session;
+
+static gboolean ril_uses_session(struct ril_data *rd)
+{
+	return rd->vendor == OFONO_RIL_VENDOR_MTK2 ||
+			rd->vendor == OFONO_RIL_VENDOR_QCOM_MSIM;
+}
+
 /* Get complementary GRil */
 GRil *ril_get_gril_complement(struct ofono_modem *modem)
 {
@@ -305,28 +355,57 @@ void ril_remove(struct ofono_modem *modem)
 	if (!rd)
 		return;
 
+	/* Left when never powered up, the core dropped the watches already */
+	g_slist_free_full(rd->startup, g_free);
+
+	if (ril_data_0 == rd)
+		ril_data_0 = NULL;
+	else if (ril_data_1 == rd)
+		ril_data_1 = NULL;
+
+	ril_debug_remove(rd->debug);
 	g_ril_unref(rd->ril);
 
+	if (ril_data_0 == NULL && ril_data_1 == NULL) {
+		g_ril_session_unref(session);
+		session = NULL;
+	}
+
 	g_free(rd);
 }
 
-void ril_pre_sim(struct ofono_modem *modem)
+static void create_devinfo(struct ofono_modem *modem)
 {
 	struct ril_data *rd = ofono_modem_get_data(modem);
-	struct ril_voicecall_driver_data vc_data = { rd->ril, modem };
-	struct ril_sim_data sim_data;
-
-	DBG("");
 
 	ofono_devinfo_create(modem, rd->vendor,
 				get_driver_type(rd, OFONO_ATOM_TYPE_DEVINFO),
 				rd->ril);
+}
+
+static void create_voicecall(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+	struct ril_voicecall_driver_data vc_data = { rd->ril, modem };
+
 	ofono_voicecall_create(modem, rd->vendor,
 				get_driver_type(rd, OFONO_ATOM_TYPE_VOICECALL),
 				&vc_data);
+}
+
+static void create_call_volume(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+
 	ofono_call_volume_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPES_CALL_VOLUME),
 			rd->ril);
+}
+
+static void create_sim(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+	struct ril_sim_data sim_data;
 
 	sim_data.gril = rd->ril;
 	sim_data.modem = modem;
@@ -336,46 +415,88 @@ void ril_pre_sim(struct ofono_modem *modem)
 			get_driver_type(rd, OFONO_ATOM_TYPE_SIM), &sim_data);
 }
 
-void ril_post_sim(struct ofono_modem *modem)
+static void create_sms(struct ofono_modem *modem)
 {
 	struct ril_data *rd = ofono_modem_get_data(modem);
-	struct ofono_message_waiting *mw;
 
 	ofono_sms_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_SMS), rd->ril);
+}
+
+static void create_message_waiting(struct ofono_modem *modem)
+{
+	struct ofono_message_waiting *mw;
 
 	mw = ofono_message_waiting_create(modem);
 	if (mw)
 		ofono_message_waiting_register(mw);
+}
+
+static void create_phonebook(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
 
 	ofono_phonebook_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_PHONEBOOK), modem);
 }
 
-void ril_post_online(struct ofono_modem *modem)
+static void create_netreg(struct ofono_modem *modem)
 {
 	struct ril_data *rd = ofono_modem_get_data(modem);
-	struct ofono_gprs *gprs;
-	struct ofono_gprs_context *gc;
-	struct ril_gprs_driver_data gprs_data = { rd->ril, modem };
-	struct ril_gprs_context_data
-		inet_ctx = { rd->ril, modem, OFONO_GPRS_CONTEXT_TYPE_INTERNET };
-	struct ril_gprs_context_data
-		mms_ctx = { rd->ril, modem, OFONO_GPRS_CONTEXT_TYPE_MMS };
 
 	ofono_netreg_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_NETREG), rd->ril);
+}
+
+static void create_ussd(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+
 	ofono_ussd_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_USSD), rd->ril);
+}
+
+static void create_call_settings(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+
 	ofono_call_settings_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_CALL_SETTINGS),
 			rd->ril);
+}
+
+static void create_call_barring(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+
 	ofono_call_barring_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_CALL_BARRING),
 			rd->ril);
+}
+
+static void create_call_forwarding(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+
 	ofono_call_forwarding_create(modem, rd->vendor,
 			get_driver_type(rd, OFONO_ATOM_TYPE_CALL_FORWARDING),
 			rd->ril);
+}
+
+static void create_gprs(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+	struct ofono_gprs *gprs;
+	struct ofono_gprs_context *gc;
+	struct ril_gprs_driver_data gprs_data = { rd->ril, modem };
+	struct ril_gprs_context_data
+		inet_ctx = { rd->ril, modem, OFONO_GPRS_CONTEXT_TYPE_INTERNET };
+	struct ril_gprs_context_data
+		mms_ctx = { rd->ril, modem, OFONO_GPRS_CONTEXT_TYPE_MMS };
+	struct ril_gprs_context_data
+		any_ctx = { rd->ril, modem, OFONO_GPRS_CONTEXT_TYPE_ANY };
+	unsigned int i;
+
 	gprs = ofono_gprs_create(modem, rd->vendor,
 				get_driver_type(rd, OFONO_ATOM_TYPE_GPRS),
 				&gprs_data);
@@ -398,6 +519,186 @@ void ril_post_online(struct ofono_modem *modem)
 					OFONO_GPRS_CONTEXT_TYPE_MMS);
 		ofono_gprs_add_context(gprs, gc);
 	}
+
+	/* Any further data calls serve IMS, private APNs or tethering */
+	for (i = 2; i < g_ril_get_max_data_calls(rd->ril); i++) {
+		gc = ofono_gprs_context_create(modem, rd->vendor,
+			get_driver_type(rd, OFONO_ATOM_TYPE_GPRS_CONTEXT),
+			&any_ctx);
+
+		if (gc)
+			ofono_gprs_add_context(gprs, gc);
+	}
+}
+
+static const struct startup_step pre_sim_steps[] = {
+	{ OFONO_ATOM_TYPE_DEVINFO, "devinfo", create_devinfo },
+	{ OFONO_ATOM_TYPE_VOICECALL, "voicecall", create_voicecall },
+	{ OFONO_ATOM_TYPES_CALL_VOLUME, "call-volume", create_call_volume },
+	{ OFONO_ATOM_TYPE_SIM, "sim", create_sim },
+	{ }
+};
+
+static const struct startup_step post_sim_steps[] = {
+	{ OFONO_ATOM_TYPE_SMS, "sms", create_sms },
+	{ OFONO_ATOM_TYPE_MESSAGE_WAITING, "message-waiting",
+		create_message_waiting },
+	{ OFONO_ATOM_TYPE_PHONEBOOK, "phonebook", create_phonebook },
+	{ }
+};
+
+static const struct startup_step post_online_steps[] = {
+	{ OFONO_ATOM_TYPE_NETREG, "netreg", create_netreg },
+	{ OFONO_ATOM_TYPE_GPRS, "gprs", create_gprs },
+	{ OFONO_ATOM_TYPE_USSD, "ussd", create_ussd },
+	{ OFONO_ATOM_TYPE_CALL_SETTINGS, "call-settings",
+		create_call_settings },
+	{ OFONO_ATOM_TYPE_CALL_BARRING, "call-barring", create_call_barring },
+	{ OFONO_ATOM_TYPE_CALL_FORWARDING, "call-forwarding",
+		create_call_forwarding },
+	{ }
+};
+
+static const struct startup_step *startup_phases[RIL_STARTUP_PHASES] = {
+	[RIL_STARTUP_PRE_SIM] = pre_sim_steps,
+	[RIL_STARTUP_POST_SIM] = post_sim_steps,
+	[RIL_STARTUP_POST_ONLINE] = post_online_steps,
+};
+
+static const char *startup_phase_names[RIL_STARTUP_PHASES] = {
+	[RIL_STARTUP_PRE_SIM] = "pre-sim",
+	[RIL_STARTUP_POST_SIM] = "post-sim",
+	[RIL_STARTUP_POST_ONLINE] = "post-online",
+};
+
+static void startup_phase_done(struct ril_data *rd, int phase)
+{
+	GSList *l;
+
+	for (l = rd->startup; l; l = l->next) {
+		struct startup_atom *sa = l->data;
+
+		if (sa->phase == phase && sa->registered == 0)
+			return;
+	}
+
+	ofono_info("Device %d: %s atoms up in %" G_GINT64_FORMAT " ms",
+			g_ril_get_slot(rd->ril), startup_phase_names[phase],
+			(g_get_monotonic_time() - rd->phase_started[phase]) /
+				1000);
+}
+
+static void startup_atom_watch(struct ofono_atom *atom,
+				enum ofono_atom_watch_condition cond,
+				void *data)
+{
+	struct startup_atom *sa = data;
+	struct ril_data *rd = ofono_modem_get_data(sa->modem);
+
+	if (cond != OFONO_ATOM_WATCH_CONDITION_REGISTERED)
+		return;
+
+	/* gprs contexts and the like register several atoms of a type */
+	if (sa->created == 0 || sa->registered != 0)
+		return;
+
+	sa->registered = g_get_monotonic_time();
+
+	DBG("%s registered %" G_GINT64_FORMAT " us after creation",
+		sa->step->name, sa->registered - sa->created);
+
+	ril_debug_atom_started(rd->debug, sa->step->name,
+				sa->created - rd->enabled_at,
+				sa->registered - rd->enabled_at);
+
+	startup_phase_done(rd, sa->phase);
+}
+
+static void startup_run(struct ofono_modem *modem,
+				enum ril_startup_phase phase)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+	GSList *l;
+
+	rd->phase_started[phase] = g_get_monotonic_time();
+
+	/* Clear the whole phase first, registration can happen right away */
+	for (l = rd->startup; l; l = l->next) {
+		struct startup_atom *sa = l->data;
+
+		if (sa->phase != phase)
+			continue;
+
+		sa->created = 0;
+		sa->registered = 0;
+	}
+
+	for (l = rd->startup; l; l = l->next) {
+		struct startup_atom *sa = l->data;
+
+		if (sa->phase != phase)
+			continue;
+
+		DBG("%s", sa->step->name);
+
+		sa->created = g_get_monotonic_time();
+		sa->step->create(modem);
+	}
+}
+
+static void startup_init(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+	const struct startup_step *step;
+	int phase;
+
+	for (phase = 0; phase < RIL_STARTUP_PHASES; phase++) {
+		for (step = startup_phases[phase]; step->name; step++) {
+			struct startup_atom *sa = g_new0(struct startup_atom, 1);
+
+			sa->modem = modem;
+			sa->step = step;
+			sa->phase = phase;
+			rd->startup = g_slist_append(rd->startup, sa);
+
+			sa->watch = __ofono_modem_add_atom_watch(modem,
+							step->type,
+							startup_atom_watch,
+							sa, NULL);
+		}
+	}
+}
+
+static void startup_cleanup(struct ofono_modem *modem)
+{
+	struct ril_data *rd = ofono_modem_get_data(modem);
+	GSList *l;
+
+	for (l = rd->startup; l; l = l->next) {
+		struct startup_atom *sa = l->data;
+
+		__ofono_modem_remove_atom_watch(modem, sa->watch);
+	}
+
+	g_slist_free_full(rd->startup, g_free);
+	rd->startup = NULL;
+}
+
+void ril_pre_sim(struct ofono_modem *modem)
+{
+	DBG("");
+
+	startup_run(modem, RIL_STARTUP_PRE_SIM);
+}
+
+void ril_post_sim(struct ofono_modem *modem)
+{
+	startup_run(modem, RIL_STARTUP_POST_SIM);
+}
+
+void ril_post_online(struct ofono_modem *modem)
+{
+	startup_run(modem, RIL_STARTUP_POST_ONLINE);
 }
 
 static void ril_set_online_cb(struct ril_msg *message, gpointer user_data)
@@ -489,7 +790,25 @@ static int create_gril(struct ofono_modem *modem)
 	const gchar *socket = ofono_modem_get_string(modem, "Socket");
 
 	ofono_info("Using %s as socket for slot %d.", socket, slot_id);
-	rd->ril = g_ril_new(socket, rd->vendor);
+
+	if (ril_uses_session(rd)) {
+		/* The session reconnects the slot by itself */
+		if (rd->ril != NULL)
+			return 0;
+
+		if (session == NULL) {
+			session = g_ril_session_new(FALSE);
+			if (session == NULL)
+				return -ENOMEM;
+		}
+
+		rd->ril = g_ril_session_add_slot(session, slot_id, socket,
+							rd->vendor);
+	} else {
+		/* Every enable connects anew, the old connection goes */
+		g_ril_unref(rd->ril);
+		rd->ril = g_ril_new(socket, rd->vendor);
+	}
 
 	/*
 	 * NOTE: Since AT modems open a tty, and then call
@@ -517,9 +836,35 @@ static int create_gril(struct ofono_modem *modem)
 	if (getenv("OFONO_RIL_TRACE"))
 		g_ril_set_trace(rd->ril, TRUE);
 
+	if (getenv("OFONO_RIL_TRACE_RING"))
+		g_ril_set_trace_ring(rd->ril,
+					atoi(getenv("OFONO_RIL_TRACE_RING")));
+
 	if (getenv("OFONO_RIL_HEX_TRACE"))
 		g_ril_set_debugf(rd->ril, ril_debug, rd);
 
+	/* Window in ms to coalesce latest-value-wins indications over */
+	if (getenv("OFONO_RIL_COALESCE")) {
+		guint window = atoi(getenv("OFONO_RIL_COALESCE"));
+
+		g_ril_set_coalesce(rd->ril, RIL_UNSOL_SIGNAL_STRENGTH, window);
+		g_ril_set_coalesce(rd->ril, RIL_UNSOL_CELL_INFO_LIST, window);
+		g_ril_set_coalesce(rd->ril,
+				RIL_UNSOL_RESPONSE_VOICE_NETWORK_STATE_CHANGED,
+				window);
+	}
+
+	if (ofono_modem_get_integer(modem, "MaxDataCalls") > 0)
+		g_ril_set_max_data_calls(rd->ril,
+				ofono_modem_get_integer(modem, "MaxDataCalls"));
+
+	if (getenv("OFONO_RIL_DEBUG_STATS")) {
+		if (rd->debug == NULL)
+			rd->debug = ril_debug_create(modem, rd->ril);
+		else
+			ril_debug_set_ril(rd->debug, rd->ril);
+	}
+
 	g_ril_register(rd->ril, RIL_UNSOL_RIL_CONNECTED,
 			ril_connected, modem);
 
@@ -549,10 +894,16 @@ static gboolean connect_rild(gpointer user_data)
 
 int ril_enable(struct ofono_modem *modem)
 {
+	struct ril_data *rd = ofono_modem_get_data(modem);
 	int ret;
 
 	DBG("");
 
+	rd->enabled_at = g_get_monotonic_time();
+
+	if (rd->startup == NULL)
+		startup_init(modem);
+
 	ret = create_gril(modem);
 	if (ret < 0)
 		g_timeout_add_seconds(RILD_CONNECT_RETRY_TIME_S,
@@ -567,6 +918,9 @@ int ril_disable(struct ofono_modem *modem)
 
 	DBG("%p", modem);
 
+	/* Atom watches do not outlive the modem being powered */
+	startup_cleanup(modem);
+
 	ril_send_power(rd, FALSE, NULL, NULL);
 
 	return 0;
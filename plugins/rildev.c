@@ -56,6 +56,8 @@ static GSList *g_socket_list;
 static int create_rilmodem(const char *ril_type, int slot, const char *socket)
 {
 	struct ofono_modem *modem;
+	const char *max_data_calls;
+	const char *pb_read_window;
 	char dev_name[64];
 	int retval;
 
@@ -78,6 +80,18 @@ static int create_rilmodem(const char *ril_type, int slot, const char *socket)
 
 	ofono_modem_set_string(modem, "Socket", socket);
 
+	/* Data calls to allow concurrently, the plugin default otherwise */
+	max_data_calls = getenv("OFONO_RIL_MAX_DATA_CALLS");
+	if (max_data_calls != NULL)
+		ofono_modem_set_integer(modem, "MaxDataCalls",
+						atoi(max_data_calls));
+
+	/* SIM phonebook records to read concurrently when exporting */
+	pb_read_window = getenv("OFONO_RIL_PB_READ_WINDOW");
+	if (pb_read_window != NULL)
+		ofono_modem_set_integer(modem, "PhonebookReadWindow",
+						atoi(pb_read_window));
+
 	/* This causes driver->probe() to be called... */
 	retval = ofono_modem_register(modem);
 	if (retval != 0) {
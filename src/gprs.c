@@ -2795,6 +2795,31 @@ void ofono_gprs_context_deactivated(struct ofono_gprs_context *gc,
 	}
 }
 
+void ofono_gprs_context_settings_changed(struct ofono_gprs_context *gc,
+						unsigned int cid)
+{
+	struct context_settings *settings = gc->settings;
+	GSList *l;
+	struct pri_context *ctx;
+
+	if (gc->gprs == NULL || settings->interface == NULL)
+		return;
+
+	for (l = gc->gprs->contexts; l; l = l->next) {
+		ctx = l->data;
+
+		if (ctx->context.cid != cid)
+			continue;
+
+		if (ctx->active == FALSE || ctx->context_driver != gc)
+			break;
+
+		pri_context_signal_settings(ctx, settings->ipv4 != NULL,
+						settings->ipv6 != NULL);
+		break;
+	}
+}
+
 int ofono_gprs_context_driver_register(
 				const struct ofono_gprs_context_driver *d)
 {
@@ -0,0 +1,182 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "gatutil.h"
+
+/* Long enough for a few words and a tail on every word size */
+#define SCAN_MAX_LEN (3 * sizeof(gulong) + 3)
+
+/* Bytes either side of the targets, some with the high bit set */
+static const char filler[] = "ab\x80\xff\x7f\x01 z";
+
+static gsize scan_bytewise(const char *buf, gsize len,
+				char c1, char c2, char c3)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] == c1 || buf[i] == c2 || buf[i] == c3)
+			break;
+
+	return i;
+}
+
+static void fill(char *buf, gsize len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = filler[i % (sizeof(filler) - 1)];
+}
+
+static void check_scan(const char *buf, gsize len, char c1, char c2, char c3)
+{
+	g_assert_cmpuint(g_at_util_scan(buf, len, c1, c2, c3), ==,
+				scan_bytewise(buf, len, c1, c2, c3));
+}
+
+static void test_scan_no_match(void)
+{
+	char buf[SCAN_MAX_LEN];
+	gsize len;
+
+	fill(buf, sizeof(buf));
+
+	for (len = 0; len <= sizeof(buf); len++) {
+		g_assert_cmpuint(g_at_util_scan(buf, len, '\r', '\r', '\r'),
+					==, len);
+		g_assert_cmpuint(g_at_util_scan(buf, len, '\r', '\n', '\n'),
+					==, len);
+		g_assert_cmpuint(g_at_util_scan(buf, len, '\r', '\n', '"'),
+					==, len);
+	}
+}
+
+static void test_scan_last_byte(void)
+{
+	char buf[SCAN_MAX_LEN];
+	gsize len;
+
+	for (len = 1; len <= sizeof(buf); len++) {
+		fill(buf, len);
+		buf[len - 1] = '"';
+
+		g_assert_cmpuint(g_at_util_scan(buf, len, '"', '"', '"'),
+					==, len - 1);
+		g_assert_cmpuint(g_at_util_scan(buf, len, '\r', '"', '"'),
+					==, len - 1);
+		g_assert_cmpuint(g_at_util_scan(buf, len, '\r', '\n', '"'),
+					==, len - 1);
+
+		/* The byte past the end is never looked at */
+		g_assert_cmpuint(g_at_util_scan(buf, len - 1, '\r', '\n', '"'),
+					==, len - 1);
+	}
+}
+
+static void scan_targets(char c1, char c2, char c3)
+{
+	const char targets[] = { c1, c2, c3 };
+	char buf[SCAN_MAX_LEN];
+	gsize len;
+	gsize pos;
+	gsize t;
+
+	/* Below, at and above the word size, with the match anywhere */
+	for (len = 1; len <= sizeof(buf); len++) {
+		for (pos = 0; pos < len; pos++) {
+			for (t = 0; t < G_N_ELEMENTS(targets); t++) {
+				fill(buf, len);
+				buf[pos] = targets[t];
+
+				g_assert_cmpuint(g_at_util_scan(buf, len,
+								c1, c2, c3),
+							==, pos);
+			}
+
+			/* A later target must not win over an earlier one */
+			if (pos + 1 < len) {
+				buf[pos + 1] = c1;
+				check_scan(buf, len, c1, c2, c3);
+			}
+		}
+	}
+}
+
+static void test_scan_one_target(void)
+{
+	scan_targets('\r', '\r', '\r');
+	scan_targets('\xc0', '\xc0', '\xc0');
+}
+
+static void test_scan_two_targets(void)
+{
+	scan_targets('\r', '\n', '\n');
+	scan_targets('\0', '\xfe', '\xfe');
+}
+
+static void test_scan_three_targets(void)
+{
+	scan_targets('\r', '\n', '"');
+	scan_targets('\x81', '\0', '~');
+}
+
+static void test_scan_unaligned(void)
+{
+	char buf[SCAN_MAX_LEN + sizeof(gulong)];
+	gsize offset;
+	gsize pos;
+
+	for (offset = 0; offset < sizeof(gulong); offset++) {
+		for (pos = 0; pos < SCAN_MAX_LEN; pos++) {
+			fill(buf, sizeof(buf));
+			buf[offset + pos] = '\n';
+
+			check_scan(buf + offset, SCAN_MAX_LEN, '\r', '\n', '"');
+			g_assert_cmpuint(g_at_util_scan(buf + offset,
+							SCAN_MAX_LEN,
+							'\r', '\n', '"'),
+						==, pos);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/testgatutil/scan no match", test_scan_no_match);
+	g_test_add_func("/testgatutil/scan last byte", test_scan_last_byte);
+	g_test_add_func("/testgatutil/scan one target", test_scan_one_target);
+	g_test_add_func("/testgatutil/scan two targets",
+					test_scan_two_targets);
+	g_test_add_func("/testgatutil/scan three targets",
+					test_scan_three_targets);
+	g_test_add_func("/testgatutil/scan unaligned", test_scan_unaligned);
+
+	return g_test_run();
+}
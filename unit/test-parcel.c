@@ -0,0 +1,337 @@
+/*
+ *
+ *  oFono - Open Source Telephony
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <ofono/modem.h>
+#include <ofono/gprs-context.h>
+#include <ofono/types.h>
+
+#include "grilrequest.h"
+#include "grilschema.h"
+
+/*
+ * This test is built with g_realloc defined to test_realloc, so that
+ * the reallocations done while building parcels can be counted.
+ */
+#undef g_realloc
+gpointer g_realloc(gpointer mem, gsize n_bytes);
+
+static unsigned int realloc_count;
+
+gpointer test_realloc(gpointer mem, gsize n_bytes)
+{
+	realloc_count++;
+
+	return g_realloc(mem, n_bytes);
+}
+
+#define BENCH_ITERATIONS 100000
+
+static const unsigned char sim_path[] = { 0x3F, 0x00, 0x7F, 0x20 };
+
+static const struct req_sim_read_binary req_sim_read_binary = {
+	.app_type = RIL_APPTYPE_SIM,
+	.aid_str = "a0000000871002ff33ff01890000010b",
+	.fileid = 0x6F07,
+	.path = sim_path,
+	.path_len = sizeof(sim_path),
+	.start = 0,
+	.length = 9,
+};
+
+static const struct req_sim_read_record req_sim_read_record = {
+	.app_type = RIL_APPTYPE_SIM,
+	.aid_str = "a0000000871002ff33ff01890000010b",
+	.fileid = 0x6F3A,
+	.path = sim_path,
+	.path_len = sizeof(sim_path),
+	.record = 5,
+	.length = 28,
+};
+
+static const struct req_setup_data_call req_setup_data_call = {
+	.tech = RADIO_TECH_UMTS + 2,
+	.data_profile = RIL_DATA_PROFILE_DEFAULT,
+	.apn = "internet.operator.example.com",
+	.username = "username",
+	.password = "password",
+	.auth_type = RIL_AUTH_BOTH,
+	.protocol = OFONO_GPRS_PROTO_IPV4V6,
+};
+
+static void test_parcel_grow(void)
+{
+	struct parcel rilp;
+	unsigned int i;
+
+	parcel_init(&rilp);
+	realloc_count = 0;
+
+	for (i = 0; i < 4096; i++)
+		parcel_w_int32(&rilp, i);
+
+	/* Growth is geometric: 16 KiB from 64 bytes takes 8 doublings */
+	g_assert(rilp.size == 4096 * sizeof(int32_t));
+	g_assert(realloc_count <= 9);
+
+	for (i = 0; i < 4096; i++)
+		g_assert(((int32_t *) (void *) rilp.data)[i] == (int32_t) i);
+
+	parcel_free(&rilp);
+}
+
+static void test_parcel_reserve(void)
+{
+	struct parcel rilp;
+	unsigned int i;
+
+	parcel_init_sized(&rilp, 0);
+	parcel_reserve(&rilp, 100 * sizeof(int32_t));
+	realloc_count = 0;
+
+	for (i = 0; i < 100; i++)
+		parcel_w_int32(&rilp, i);
+
+	g_assert(realloc_count == 0);
+
+	parcel_free(&rilp);
+}
+
+static void test_parcel_string_size(void)
+{
+	static const char *strs[] = { NULL, "", "a", "ab", "abc", "3F007F20",
+					"internet.operator.example.com" };
+	struct parcel rilp;
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(strs); i++) {
+		parcel_init_sized(&rilp, 0);
+		parcel_w_string(&rilp, strs[i]);
+
+		g_assert(rilp.size == parcel_string_size(strs[i]));
+
+		parcel_free(&rilp);
+	}
+}
+
+static void test_parcel_string_utf16(void)
+{
+	static const char *strs[] = { "", "internet", "h\xc3\xa9llo",
+					"\xe6\x97\xa5\xe6\x9c\xac",
+					"a\xf0\x9f\x98\x80" "b" };
+	static const int len16[] = { 0, 8, 5, 2, 4 };
+	struct parcel rilp;
+	char buf[5];
+	unsigned int i;
+	char *str;
+
+	for (i = 0; i < G_N_ELEMENTS(strs); i++) {
+		parcel_init(&rilp);
+		parcel_w_string(&rilp, strs[i]);
+		parcel_w_int32(&rilp, 0x5a5a5a5a);
+
+		g_assert(((int32_t *) (void *) rilp.data)[0] == len16[i]);
+
+		rilp.offset = 0;
+		str = parcel_r_string(&rilp);
+		g_assert(g_strcmp0(str, strs[i]) == 0);
+		g_assert(parcel_r_int32(&rilp) == 0x5a5a5a5a);
+		g_free(str);
+
+		/* Truncated on a character boundary */
+		rilp.offset = 0;
+		g_assert(parcel_r_string_buf(&rilp, buf, sizeof(buf)) ==
+				(int) strlen(buf));
+		g_assert(strncmp(buf, strs[i], strlen(buf)) == 0);
+		g_assert(g_utf8_validate(buf, -1, NULL));
+		g_assert(parcel_r_int32(&rilp) == 0x5a5a5a5a);
+
+		parcel_free(&rilp);
+	}
+
+	parcel_init(&rilp);
+	parcel_w_string(&rilp, NULL);
+	rilp.offset = 0;
+	g_assert(parcel_r_string_buf(&rilp, buf, sizeof(buf)) == -1);
+	g_assert(buf[0] == '\0');
+	parcel_free(&rilp);
+}
+
+struct schema_test {
+	int count;
+	int flags;
+	char *name;
+	char label[6];
+	int newer;
+	int mtk;
+};
+
+static const struct ril_field schema_test_fields[] = {
+	RIL_FIELD_FIXED(2),
+	RIL_FIELD_INT(struct schema_test, count),
+	RIL_FIELD_HEX(struct schema_test, flags),
+	RIL_FIELD_STR(struct schema_test, name),
+	RIL_FIELD_BUF(struct schema_test, label),
+	{ .type = RIL_FIELD_INT32, .name = "newer", .min_version = 12,
+		.offset = offsetof(struct schema_test, newer) },
+	{ .type = RIL_FIELD_INT32, .name = "mtk",
+		.vendors = RIL_VENDOR_BIT(OFONO_RIL_VENDOR_MTK),
+		.offset = offsetof(struct schema_test, mtk) },
+};
+
+static const struct ril_schema schema_test =
+	RIL_SCHEMA("schema test", schema_test_fields);
+
+static void test_parcel_schema(void)
+{
+	struct schema_test in = {
+		.count = -3, .flags = 0x90, .name = "h\xc3\xa9llo",
+		.label = "abcde", .newer = 7, .mtk = 8,
+	};
+	struct schema_test out;
+	struct parcel rilp;
+	int value = 42;
+
+	/* Fields of newer versions and other vendors are left out */
+	realloc_count = 0;
+	g_ril_schema_encode(NULL, &schema_test, &in, &rilp);
+	g_assert(realloc_count == 0);
+	g_assert(rilp.size == 3 * sizeof(int32_t) +
+			parcel_string_size(in.name) +
+			parcel_string_size(in.label));
+
+	memset(&out, 0, sizeof(out));
+	rilp.offset = 0;
+	g_assert(g_ril_schema_decode(NULL, &schema_test, &rilp, &out, NULL));
+	g_assert(out.count == in.count);
+	g_assert(out.flags == in.flags);
+	g_assert(g_strcmp0(out.name, in.name) == 0);
+	g_assert(g_strcmp0(out.label, in.label) == 0);
+	g_assert(out.newer == 0 && out.mtk == 0);
+	g_free(out.name);
+
+	/* Truncated parcels are reported */
+	memset(&out, 0, sizeof(out));
+	rilp.offset = 0;
+	rilp.size -= sizeof(int32_t);
+	g_assert(!g_ril_schema_decode(NULL, &schema_test, &rilp, &out, NULL));
+	g_free(out.name);
+	parcel_free(&rilp);
+
+	g_ril_schema_encode(NULL, &ril_schema_int1, &value, &rilp);
+	g_assert(rilp.size == 2 * sizeof(int32_t));
+	g_assert(((int32_t *) (void *) rilp.data)[0] == 1);
+	g_assert(((int32_t *) (void *) rilp.data)[1] == value);
+	parcel_free(&rilp);
+}
+
+static void build_sim_read_binary(struct parcel *rilp)
+{
+	g_ril_request_sim_read_binary(NULL, &req_sim_read_binary, rilp);
+}
+
+static void build_sim_read_record(struct parcel *rilp)
+{
+	g_ril_request_sim_read_record(NULL, &req_sim_read_record, rilp);
+}
+
+static void build_setup_data_call(struct parcel *rilp)
+{
+	struct ofono_error error;
+
+	g_ril_request_setup_data_call(NULL, &req_setup_data_call, rilp, &error);
+}
+
+struct bench_data {
+	const char *name;
+	void (*build)(struct parcel *rilp);
+};
+
+static const struct bench_data bench_sim_read_binary = {
+	.name = "SIM_IO read binary",
+	.build = build_sim_read_binary,
+};
+
+static const struct bench_data bench_sim_read_record = {
+	.name = "SIM_IO read record",
+	.build = build_sim_read_record,
+};
+
+static const struct bench_data bench_setup_data_call = {
+	.name = "SETUP_DATA_CALL",
+	.build = build_setup_data_call,
+};
+
+static void test_request_allocs(gconstpointer data)
+{
+	const struct bench_data *bench = data;
+	struct parcel rilp;
+	double reallocs;
+	unsigned int i;
+
+	realloc_count = 0;
+	g_test_timer_start();
+
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		bench->build(&rilp);
+		parcel_free(&rilp);
+	}
+
+	reallocs = (double) realloc_count / BENCH_ITERATIONS;
+
+	if (g_test_perf()) {
+		g_test_minimized_result(g_test_timer_elapsed() * 1e9 /
+						BENCH_ITERATIONS,
+					"%s: ns per request", bench->name);
+		g_test_minimized_result(1 + reallocs,
+					"%s: allocations per request",
+					bench->name);
+	}
+
+	/* Builders size their parcels up front */
+	g_assert(reallocs == 0);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/testparcel/grow", test_parcel_grow);
+	g_test_add_func("/testparcel/reserve", test_parcel_reserve);
+	g_test_add_func("/testparcel/string size", test_parcel_string_size);
+	g_test_add_func("/testparcel/string utf16", test_parcel_string_utf16);
+	g_test_add_func("/testparcel/schema", test_parcel_schema);
+
+	g_test_add_data_func("/testparcel/allocs: SIM_IO read binary",
+				&bench_sim_read_binary, test_request_allocs);
+	g_test_add_data_func("/testparcel/allocs: SIM_IO read record",
+				&bench_sim_read_record, test_request_allocs);
+	g_test_add_data_func("/testparcel/allocs: SETUP_DATA_CALL",
+				&bench_setup_data_call, test_request_allocs);
+
+	return g_test_run();
+}
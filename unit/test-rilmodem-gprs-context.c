@@ -38,6 +38,7 @@
 #include <ofono/types.h>
 #include <ofono/gprs-context.h>
 #include <gril.h>
+#include <grilunsol.h>
 
 #include "drivers/rilmodem/rilutil.h"
 #include "drivers/mtkmodem/mtkutil.h"
@@ -137,6 +138,60 @@ void *ofono_gprs_get_data(struct ofono_gprs *gprs)
 	return &gprs->gprs_data;
 }
 
+/*
+ * There is no gprs atom dispatching the data call list here, so the watched
+ * context is handed its call from every RIL_UNSOL_DATA_CALL_LIST_CHANGED,
+ * or NULL when the list lacks it.
+ */
+static struct ofono_gprs_context *watched_gc;
+static int watched_cid;
+static guint call_list_id;
+
+static void data_call_list_changed(struct ril_msg *message,
+					gpointer user_data)
+{
+	struct ofono_gprs_context *gc = user_data;
+	struct ril_data_call_list *call_list;
+	struct ril_data_call *call = NULL;
+	GSList *l;
+
+	call_list = g_ril_unsol_parse_data_call_list(gc->ril, message);
+	g_assert(call_list != NULL);
+
+	for (l = call_list->calls; l; l = l->next) {
+		struct ril_data_call *c = l->data;
+
+		if (c->cid == watched_cid) {
+			call = c;
+			break;
+		}
+	}
+
+	ril_gprs_context_call_changed(gc, call);
+
+	g_ril_unsol_free_data_call_list(call_list);
+}
+
+void ril_gprs_watch_data_call(struct ofono_gprs *gprs, int cid,
+				struct ofono_gprs_context *gc)
+{
+	watched_gc = gc;
+	watched_cid = cid;
+	call_list_id = g_ril_register(gc->ril,
+					RIL_UNSOL_DATA_CALL_LIST_CHANGED,
+					data_call_list_changed, gc);
+}
+
+void ril_gprs_unwatch_data_call(struct ofono_gprs *gprs, int cid)
+{
+	if (watched_gc == NULL)
+		return;
+
+	g_ril_unregister(watched_gc->ril, call_list_id);
+	watched_gc = NULL;
+	call_list_id = 0;
+}
+
 OFONO_EVENT_CALL_ARG_2(ofono_gprs_context_deactivated,
 				struct ofono_gprs_context *, unsigned int)
 OFONO_EVENT_CALL_ARG_2(ofono_gprs_context_set_interface,
@@ -152,6 +207,11 @@ OFONO_EVENT_CALL_ARG_2(ofono_gprs_context_set_ipv4_dns_servers,
 				struct ofono_gprs_context *, const char **)
 OFONO_EVENT_CALL_CB_ARG_2(ofono_gprs_context_cb,
 			const struct ofono_error *, struct ofono_gprs_context *)
+OFONO_EVENT_CALL_ARG_2(ofono_gprs_context_settings_changed,
+				struct ofono_gprs_context *, unsigned int)
+
+/* Only a live call whose settings differ from the snapshot is signalled */
+static unsigned int settings_changed;
 
 /*
  * As all our architectures are little-endian except for
@@ -602,6 +662,199 @@ static const struct rilmodem_test_data test_3 = {
 	.num_steps = G_N_ELEMENTS(steps_test_3)
 };
 
+/*
+ * UNSOL_DATA_CALL_LIST_CHANGED, v10, the call set up in step 4, unchanged:
+ * {version=10,num=1 [status=0,retry=-1,cid=6,active=2,type=IP,ifname=rmnet5,
+ * address=10.57.49.18,dns=80.58.61.250 80.58.61.254,gateways=10.57.49.1]}
+ */
+static const char parcel_unsol_data_call_list_changed_4_11[] = {
+	0x00, 0x00, 0x00, 0xb4, 0x01, 0x00, 0x00, 0x00, 0xf2, 0x03, 0x00, 0x00,
+	0x0a, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0x06, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x49, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x72, 0x00, 0x6d, 0x00, 0x6e, 0x00, 0x65, 0x00,
+	0x74, 0x00, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x35, 0x00, 0x37, 0x00, 0x2e, 0x00,
+	0x34, 0x00, 0x39, 0x00, 0x2e, 0x00, 0x31, 0x00, 0x38, 0x00, 0x00, 0x00,
+	0x19, 0x00, 0x00, 0x00, 0x38, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x35, 0x00,
+	0x38, 0x00, 0x2e, 0x00, 0x36, 0x00, 0x31, 0x00, 0x2e, 0x00, 0x32, 0x00,
+	0x35, 0x00, 0x30, 0x00, 0x20, 0x00, 0x38, 0x00, 0x30, 0x00, 0x2e, 0x00,
+	0x35, 0x00, 0x38, 0x00, 0x2e, 0x00, 0x36, 0x00, 0x31, 0x00, 0x2e, 0x00,
+	0x32, 0x00, 0x35, 0x00, 0x34, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x35, 0x00, 0x37, 0x00, 0x2e, 0x00,
+	0x34, 0x00, 0x39, 0x00, 0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff
+};
+
+/*
+ * UNSOL_DATA_CALL_LIST_CHANGED, v10, the same call with new DNS servers:
+ * {version=10,num=1 [status=0,retry=-1,cid=6,active=2,type=IP,ifname=rmnet5,
+ * address=10.57.49.18,dns=8.8.8.8 8.8.4.4,gateways=10.57.49.1]}
+ */
+static const char parcel_unsol_data_call_list_changed_4_12[] = {
+	0x00, 0x00, 0x00, 0xa0, 0x01, 0x00, 0x00, 0x00, 0xf2, 0x03, 0x00, 0x00,
+	0x0a, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0x06, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x49, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x72, 0x00, 0x6d, 0x00, 0x6e, 0x00, 0x65, 0x00,
+	0x74, 0x00, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x35, 0x00, 0x37, 0x00, 0x2e, 0x00,
+	0x34, 0x00, 0x39, 0x00, 0x2e, 0x00, 0x31, 0x00, 0x38, 0x00, 0x00, 0x00,
+	0x0f, 0x00, 0x00, 0x00, 0x38, 0x00, 0x2e, 0x00, 0x38, 0x00, 0x2e, 0x00,
+	0x38, 0x00, 0x2e, 0x00, 0x38, 0x00, 0x20, 0x00, 0x38, 0x00, 0x2e, 0x00,
+	0x38, 0x00, 0x2e, 0x00, 0x34, 0x00, 0x2e, 0x00, 0x34, 0x00, 0x00, 0x00,
+	0x0a, 0x00, 0x00, 0x00, 0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x35, 0x00,
+	0x37, 0x00, 0x2e, 0x00, 0x34, 0x00, 0x39, 0x00, 0x2e, 0x00, 0x31, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff
+};
+
+static void check_gprs_context_set_ipv4_dns_servers_4_13(
+						struct ofono_gprs_context *gc,
+						const char **dns)
+{
+	g_assert_cmpstr(*dns, ==, "8.8.8.8");
+	++dns;
+	g_assert_cmpstr(*dns, ==, "8.8.4.4");
+	++dns;
+	g_assert(*dns == NULL);
+}
+
+static void check_gprs_context_settings_changed_4_14(
+						struct ofono_gprs_context *gc,
+						unsigned int cid)
+{
+	g_assert(cid == 0);
+
+	settings_changed++;
+}
+
+static void call_deactivate_primary_4_15(gpointer data)
+{
+	/* The unchanged list of step 11 must not have been signalled */
+	g_assert(settings_changed == 1);
+
+	call_deactivate_primary_1_11(data);
+}
+
+/*
+ * --- TEST 4 ---
+ * Step 1-10: Same as test 1
+ * Step 11: Send UNSOL_DATA_CALL_LIST_CHANGED, settings unchanged
+ * Step 12: Send UNSOL_DATA_CALL_LIST_CHANGED, DNS servers changed
+ * Step 13: Driver calls to ofono_gprs_context_set_ipv4_dns_servers
+ * Step 14: Driver calls to ofono_gprs_context_settings_changed
+ * Step 15: Check there was one change, call driver->deactivate_primary
+ * Step 16-18: Same as test 1 step 12-14
+ */
+static const struct rilmodem_test_step steps_test_4[] = {
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ofono_gprs_context_set_data,
+		.check_func = (void (*)(void)) check_gprs_context_set_data_1_1
+	},
+	{
+		.type = TST_ACTION_CALL,
+		.call_action = call_activate_primary_1_2
+	},
+	{
+		.type = TST_EVENT_RECEIVE,
+		.parcel_data = parcel_req_setup_data_call_1_3,
+		.parcel_size = sizeof(parcel_req_setup_data_call_1_3)
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_rsp_setup_data_call_1_4,
+		.parcel_size = sizeof(parcel_rsp_setup_data_call_1_4)
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ofono_gprs_context_set_interface,
+		.check_func =
+			(void (*)(void)) check_gprs_context_set_interface_1_5
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func =
+			(void (*)(void)) ofono_gprs_context_set_ipv4_netmask,
+		.check_func =
+			(void (*)(void)) check_gprs_context_set_ipv4_netmask_1_6
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func =
+			(void (*)(void)) ofono_gprs_context_set_ipv4_address,
+		.check_func =
+			(void (*)(void)) check_gprs_context_set_ipv4_address_1_7
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func =
+			(void (*)(void)) ofono_gprs_context_set_ipv4_gateway,
+		.check_func =
+			(void (*)(void)) check_gprs_context_set_ipv4_gateway_1_8
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void))
+					ofono_gprs_context_set_ipv4_dns_servers,
+		.check_func = (void (*)(void))
+				check_gprs_context_set_ipv4_dns_servers_1_9
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ofono_gprs_context_cb,
+		.check_func = (void (*)(void)) check_activate_primary_1_10
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_unsol_data_call_list_changed_4_11,
+		.parcel_size = sizeof(parcel_unsol_data_call_list_changed_4_11)
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_unsol_data_call_list_changed_4_12,
+		.parcel_size = sizeof(parcel_unsol_data_call_list_changed_4_12)
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void))
+					ofono_gprs_context_set_ipv4_dns_servers,
+		.check_func = (void (*)(void))
+				check_gprs_context_set_ipv4_dns_servers_4_13
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func =
+			(void (*)(void)) ofono_gprs_context_settings_changed,
+		.check_func = (void (*)(void))
+				check_gprs_context_settings_changed_4_14
+	},
+	{
+		.type = TST_ACTION_CALL,
+		.call_action = call_deactivate_primary_4_15
+	},
+	{
+		.type = TST_EVENT_RECEIVE,
+		.parcel_data = parcel_req_deactivate_data_call_1_12,
+		.parcel_size = sizeof(parcel_req_deactivate_data_call_1_12)
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_rsp_deactivate_data_call_1_13,
+		.parcel_size = sizeof(parcel_rsp_deactivate_data_call_1_13)
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ofono_gprs_context_cb,
+		.check_func = (void (*)(void)) check_deactivate_primary_1_14
+	},
+};
+
+static const struct rilmodem_test_data test_4 = {
+	.steps = steps_test_4,
+	.num_steps = G_N_ELEMENTS(steps_test_4)
+};
+
 static void server_connect_cb(gpointer data)
 {
 	struct ofono_gprs_context *gc = data;
@@ -630,6 +883,8 @@ static void test_function(gconstpointer data)
 
 	ril_gprs_context_init();
 
+	settings_changed = 0;
+
 	gc = g_malloc0(sizeof(*gc));
 
 	gc->engined = rilmodem_test_engine_create(&server_connect_cb,
@@ -670,6 +925,8 @@ int main(int argc, char **argv)
 							&test_2, test_function);
 	g_test_add_data_func("/test-rilmodem-gprs-context/3",
 							&test_3, test_function);
+	g_test_add_data_func("/test-rilmodem-gprs-context/4",
+							&test_4, test_function);
 #endif
 	return g_test_run();
 }
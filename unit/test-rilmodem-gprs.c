@@ -37,7 +37,9 @@
 #include <ofono/types.h>
 #include <ofono/gprs.h>
 #include <gril.h>
+#include <grilunsol.h>
 #include <drivers/rilmodem/rilutil.h>
+#include <drivers/rilmodem/gprs.h>
 
 #include "common.h"
 #include "ril_constants.h"
@@ -84,6 +86,14 @@ GRil *ril_get_gril_complement(struct ofono_modem *modem)
 	return NULL;
 }
 
+/* gprs-context.c is not linked in, contexts only stand for themselves */
+struct ofono_gprs_context {
+	struct engine_data *engined;
+};
+
+static struct ofono_gprs_context context_a;
+static struct ofono_gprs_context context_b;
+
 OFONO_EVENT_CALL_ARG_1(ofono_gprs_register, struct ofono_gprs *)
 OFONO_EVENT_CALL_ARG_1(ofono_gprs_detached_notify, struct ofono_gprs *)
 OFONO_EVENT_CALL_ARG_2(ofono_gprs_status_notify, struct ofono_gprs *, int)
@@ -94,6 +104,9 @@ OFONO_EVENT_CALL_CB_ARG_2(ofono_gprs_cb, const struct ofono_error *,
 							struct ofono_gprs *)
 OFONO_EVENT_CALL_CB_ARG_3(ofono_gprs_status_cb, const struct ofono_error *,
 						int, struct ofono_gprs *)
+OFONO_EVENT_CALL_ARG_2(ril_gprs_context_call_changed,
+						struct ofono_gprs_context *,
+						const struct ril_data_call *)
 
 /*
  * As all our architectures are little-endian except for
@@ -586,6 +599,192 @@ struct rilmodem_test_data test_5 = {
 	.num_steps = G_N_ELEMENTS(steps_test_5)
 };
 
+static void call_watch_data_calls_6_7(gpointer data)
+{
+	struct ofono_gprs *gprs = data;
+
+	context_a.engined = gprs->engined;
+	context_b.engined = gprs->engined;
+
+	ril_gprs_watch_data_call(gprs, 1, &context_a);
+	ril_gprs_watch_data_call(gprs, 2, &context_b);
+
+	rilmodem_test_engine_next_step(gprs->engined);
+}
+
+/*
+ * UNSOL_DATA_CALL_LIST_CHANGED, v6,
+ * {version=6,num=2 [status=0,retry=-1,cid=1,active=1,type=IP,ifname=rmnet0,
+ * address=10.0.0.2,dns=10.0.0.1,gateways=10.0.0.1]
+ * [status=0,retry=-1,cid=3,active=1,type=IP,ifname=rmnet2,
+ * address=10.0.0.4,dns=10.0.0.1,gateways=10.0.0.1]}
+ */
+static const char parcel_unsol_data_call_list_changed_6_8[] = {
+	0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0xf2, 0x03, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x49, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x72, 0x00, 0x6d, 0x00, 0x6e, 0x00, 0x65, 0x00,
+	0x74, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x49, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x72, 0x00, 0x6d, 0x00, 0x6e, 0x00, 0x65, 0x00,
+	0x74, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static void check_call_changed_6_9(struct ofono_gprs_context *gc,
+					const struct ril_data_call *call)
+{
+	g_assert(gc == &context_a);
+	g_assert(call != NULL);
+	g_assert(call->cid == 1);
+	g_assert_cmpstr(call->ip_addr, ==, "10.0.0.2");
+}
+
+static void check_call_changed_6_10(struct ofono_gprs_context *gc,
+					const struct ril_data_call *call)
+{
+	g_assert(gc == &context_b);
+	g_assert(call == NULL);
+}
+
+/*
+ * UNSOL_DATA_CALL_LIST_CHANGED, v6,
+ * {version=6,num=1 [status=0,retry=-1,cid=2,active=1,type=IP,ifname=rmnet1,
+ * address=10.0.0.3,dns=10.0.0.1,gateways=10.0.0.1]}
+ */
+static const char parcel_unsol_data_call_list_changed_6_12[] = {
+	0x00, 0x00, 0x00, 0x88, 0x01, 0x00, 0x00, 0x00, 0xf2, 0x03, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x02, 0x00, 0x00, 0x00, 0x49, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x06, 0x00, 0x00, 0x00, 0x72, 0x00, 0x6d, 0x00, 0x6e, 0x00, 0x65, 0x00,
+	0x74, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x33, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00,
+	0x31, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00, 0x2e, 0x00, 0x30, 0x00,
+	0x2e, 0x00, 0x31, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static void check_call_changed_6_13(struct ofono_gprs_context *gc,
+					const struct ril_data_call *call)
+{
+	g_assert(gc == &context_b);
+	g_assert(call != NULL);
+	g_assert(call->cid == 2);
+	g_assert_cmpstr(call->ip_addr, ==, "10.0.0.3");
+}
+
+static void check_call_changed_6_14(struct ofono_gprs_context *gc,
+					const struct ril_data_call *call)
+{
+	g_assert(gc == &context_a);
+	g_assert(call == NULL);
+}
+
+/*
+ * --- TEST 6 ---
+ * Steps 1-6: Same as in test 2
+ * Step 7: Harness watches cid 1 for context A and cid 2 for context B
+ * Step 8: Harness sends UNSOL_DATA_CALL_LIST_CHANGED with cids 1 and 3
+ * Step 9: Driver hands the call with cid 1 to context A
+ * Step 10: Driver tells context B its call is gone
+ * Step 11: Harness sends the same list again, which is skipped
+ * Step 12: Harness sends UNSOL_DATA_CALL_LIST_CHANGED with cid 2
+ * Step 13: Driver hands the call with cid 2 to context B
+ * Step 14: Driver tells context A its call is gone
+ */
+static const struct rilmodem_test_step steps_test_6[] = {
+	{
+		.type = TST_EVENT_RECEIVE,
+		.parcel_data = parcel_req_data_call_list_2_1,
+		.parcel_size = sizeof(parcel_req_data_call_list_2_1)
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_rsp_data_call_list_2_2,
+		.parcel_size = sizeof(parcel_rsp_data_call_list_2_2)
+	},
+	{
+		.type = TST_EVENT_RECEIVE,
+		.parcel_data = parcel_req_data_registration_state_2_3,
+		.parcel_size = sizeof(parcel_req_data_registration_state_2_3)
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_rsp_data_registration_state_2_4,
+		.parcel_size = sizeof(parcel_rsp_data_registration_state_2_4)
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ofono_gprs_register,
+		.check_func = NULL
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ofono_gprs_set_cid_range,
+		.check_func = (void (*)(void)) set_cid_range_check_2_6
+	},
+	{
+		.type = TST_ACTION_CALL,
+		.call_action = call_watch_data_calls_6_7,
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_unsol_data_call_list_changed_6_8,
+		.parcel_size = sizeof(parcel_unsol_data_call_list_changed_6_8)
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ril_gprs_context_call_changed,
+		.check_func = (void (*)(void)) check_call_changed_6_9
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ril_gprs_context_call_changed,
+		.check_func = (void (*)(void)) check_call_changed_6_10
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_unsol_data_call_list_changed_6_8,
+		.parcel_size = sizeof(parcel_unsol_data_call_list_changed_6_8)
+	},
+	{
+		.type = TST_ACTION_SEND,
+		.parcel_data = parcel_unsol_data_call_list_changed_6_12,
+		.parcel_size = sizeof(parcel_unsol_data_call_list_changed_6_12)
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ril_gprs_context_call_changed,
+		.check_func = (void (*)(void)) check_call_changed_6_13
+	},
+	{
+		.type = TST_EVENT_CALL,
+		.call_func = (void (*)(void)) ril_gprs_context_call_changed,
+		.check_func = (void (*)(void)) check_call_changed_6_14
+	},
+};
+
+struct rilmodem_test_data test_6 = {
+	.steps = steps_test_6,
+	.num_steps = G_N_ELEMENTS(steps_test_6)
+};
+
 static void server_connect_cb(gpointer data)
 {
 	struct ofono_gprs *gprs = data;
@@ -659,6 +858,7 @@ int main(int argc, char **argv)
 	g_test_add_data_func("/test-rilmodem-gprs/3", &test_3, test_function);
 	g_test_add_data_func("/test-rilmodem-gprs/4", &test_4, test_function);
 	g_test_add_data_func("/test-rilmodem-gprs/5", &test_5, test_function);
+	g_test_add_data_func("/test-rilmodem-gprs/6", &test_6, test_function);
 #endif
 	return g_test_run();
 }